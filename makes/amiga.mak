@@ -21,7 +21,7 @@ OBJFILES		= hp2xx.o std_main.o hpgl.o chardraw.o picbuf.o  \
  			  bresnham.o to_vec.o to_pcx.o to_pcl.o  \
  			  to_eps.o  to_amiga.o to_pbm.o to_ilbm.o \
  			  to_img.o to_rgip.o getopt.o getopt1.o \
-			  to_fig.o clip.o fillpoly.o pendef.o lindef.o \
+			  to_fig.o clip.o fillpoly.o pendef.o lindef.o tmpindex.o rle.o \
 			  murphy.o
 
 
@@ -119,4 +119,10 @@ pendef.o		: pendef.c
 lindef.o		: lindef.c
 			$(COMPILER) $(CFLAGS) lindef.c
 
+tmpindex.o		: tmpindex.c tmpindex.h hp2xx.h
+			$(COMPILER) $(CFLAGS) tmpindex.c
+
+rle.o			: rle.c rle.h hp2xx.h
+			$(COMPILER) $(CFLAGS) rle.c
+
 
@@ -72,7 +72,9 @@ EXE_dependencies =  \
  clip.obj \
  fillpoly.obj \
  pendef.obj \
- lindef.obj
+ lindef.obj \
+ tmpindex.obj \
+ rle.obj
 # to_pac.obj \
 # to_pic.obj
 
@@ -103,6 +105,8 @@ clip.obj+
 fillpoly.obj+
 pendef.obj+
 lindef.obj+
+tmpindex.obj+
+rle.obj+
 std_main.obj
 hp2xx
 		# no map file
@@ -162,6 +166,10 @@ pendef.obj: hp2xx.cfg pendef.c
 
 lindef.obj: hp2xx.cfg lindef.c
 
+tmpindex.obj: hp2xx.cfg tmpindex.c
+
+rle.obj: hp2xx.cfg rle.c
+
 #		*Compiler Configuration File*
 hp2xx.cfg: borland.mak
   copy &&|
@@ -1 +1 @@
-gcc -O to_vec.c to_eps.c picbuf.c chardraw.c bresnham.c murphy.c getopt.c getopt1.c to_os2.c to_pcx.c to_pcl.c to_img.c to_pbm.c hpgl.c std_main.c hp2xx.c to_fig.c clip.c fillpoly.c pendef.c lindef.c -o hp2xx.exe -DHAS_OS2_EMX -Wall
+gcc -O to_vec.c to_eps.c picbuf.c chardraw.c bresnham.c murphy.c getopt.c getopt1.c to_os2.c to_pcx.c to_pcl.c to_img.c to_pbm.c hpgl.c std_main.c hp2xx.c to_fig.c clip.c fillpoly.c pendef.c lindef.c tmpindex.c rle.c -o hp2xx.exe -DHAS_OS2_EMX -Wall
@@ -197,9 +197,11 @@ EX_OBJ	=
 EX_DEFS	=
 #
 # PNG support (requires -lpng and -lz on the ALL_LIBS line)
-#EX_SRC	= png.c to_png.c
-#EX_OBJ	= png.o to_png.o 
+#EX_SRC	= png.c to_png.c to_tiles.c
+#EX_OBJ	= png.o to_png.o to_tiles.o 
 #EX_DEFS= -DPNG
+# ... with parallel compression (-j), add -lpthread to ALL_LIBS:
+#EX_DEFS= -DPNG -DTHREADS
 #
 # TIFF support (requires -ltiff and possibly -lz on the ALL_LIBS line)
 #EX_SRC	= to_tif.c
@@ -235,12 +237,12 @@ SRCS	= hp2xx.c hpgl.c picbuf.c bresnham.c chardraw.c getopt.c getopt1.c \
 	  $(ALL_INCS)\
 	  to_vec.c to_pcx.c to_pcl.c to_eps.c to_img.c to_pbm.c to_rgip.c \
 	  std_main.c to_fig.c clip.c fillpoly.c pendef.c lindef.c murphy.c \
-	  $(PREVIEWER).c $(EX_SRC)
+	  tmpindex.c rle.c $(PREVIEWER).c $(EX_SRC)
 
 OBJS	= hp2xx.o hpgl.o picbuf.o bresnham.o chardraw.o getopt.o getopt1.o \
 	  to_vec.o to_pcx.o to_pcl.o to_eps.o to_img.o to_pbm.o to_rgip.o \
 	  std_main.o to_fig.o clip.o fillpoly.o pendef.o lindef.o murphy.o \
-	  $(PREVIEWER).o $(EX_OBJ)
+	  tmpindex.o rle.o $(PREVIEWER).o $(EX_OBJ)
 
 PROGRAM	= hp2xx
 
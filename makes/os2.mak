@@ -191,8 +191,8 @@ EX_DEFS =
 #EX_DEFS += -DEPSON
 #
 # Include PNG support:
-EX_SRC  += png.c to_png.c
-EX_OBJ  += png.o to_png.o
+EX_SRC  += png.c to_png.c to_tiles.c
+EX_OBJ  += png.o to_png.o to_tiles.o
 EX_DEFS += -DPNG
 ALL_LIBS += -lpng
 LFLAGS += -L/usr/local/lib
@@ -223,13 +223,13 @@ SRCS	= clip.c fillpoly.c\
 	  hp2xx.c hpgl.c picbuf.c bresnham.c chardraw.c getopt.c getopt1.c \
 	  $(ALL_INCS)\
 	  to_vec.c to_pcx.c to_pcl.c to_eps.c to_img.c to_pbm.c  \
-	  to_rgip.c to_fig.c std_main.c $(PREVIEWER).c pendef.c lindef.c \
+	  to_rgip.c to_fig.c std_main.c $(PREVIEWER).c pendef.c lindef.c tmpindex.c rle.c \
 	  murphy.c $(EX_SRC)
 
 OBJS	= clip.o fillpoly.o\
 	  hp2xx.o hpgl.o picbuf.o bresnham.o chardraw.o getopt.o getopt1.o \
 	  to_vec.o to_pcx.o to_pcl.o  to_eps.o to_img.o to_pbm.o \
-	  to_rgip.o to_fig.o std_main.o $(PREVIEWER).o pendef.o lindef.o \
+	  to_rgip.o to_fig.o std_main.o $(PREVIEWER).o pendef.o lindef.o tmpindex.o rle.o \
 	  murphy.o $(EX_OBJ)
 
 PROGRAM	= hp2xx
@@ -141,10 +141,18 @@ SOURCE=.\picbuf.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\rle.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\std_main.c
 # End Source File
 # Begin Source File
 
+SOURCE=.\tmpindex.c
+# End Source File
+# Begin Source File
+
 SOURCE=.\to_emf.c
 # End Source File
 # Begin Source File
@@ -50,7 +50,9 @@ CLEAN :
 	-@erase "$(INTDIR)\no_prev.obj"
 	-@erase "$(INTDIR)\pendef.obj"
 	-@erase "$(INTDIR)\picbuf.obj"
+	-@erase "$(INTDIR)\rle.obj"
 	-@erase "$(INTDIR)\std_main.obj"
+	-@erase "$(INTDIR)\tmpindex.obj"
 	-@erase "$(INTDIR)\to_emf.obj"
 	-@erase "$(INTDIR)\to_eps.obj"
 	-@erase "$(INTDIR)\to_escp2.obj"
@@ -124,7 +126,9 @@ LINK32_OBJS= \
 	"$(INTDIR)\no_prev.obj" \
 	"$(INTDIR)\pendef.obj" \
 	"$(INTDIR)\picbuf.obj" \
+	"$(INTDIR)\rle.obj" \
 	"$(INTDIR)\std_main.obj" \
+	"$(INTDIR)\tmpindex.obj" \
 	"$(INTDIR)\to_emf.obj" \
 	"$(INTDIR)\to_eps.obj" \
 	"$(INTDIR)\to_escp2.obj" \
@@ -169,7 +173,9 @@ CLEAN :
 	-@erase "$(INTDIR)\no_prev.obj"
 	-@erase "$(INTDIR)\pendef.obj"
 	-@erase "$(INTDIR)\picbuf.obj"
+	-@erase "$(INTDIR)\rle.obj"
 	-@erase "$(INTDIR)\std_main.obj"
+	-@erase "$(INTDIR)\tmpindex.obj"
 	-@erase "$(INTDIR)\to_emf.obj"
 	-@erase "$(INTDIR)\to_eps.obj"
 	-@erase "$(INTDIR)\to_escp2.obj"
@@ -246,7 +252,9 @@ LINK32_OBJS= \
 	"$(INTDIR)\no_prev.obj" \
 	"$(INTDIR)\pendef.obj" \
 	"$(INTDIR)\picbuf.obj" \
+	"$(INTDIR)\rle.obj" \
 	"$(INTDIR)\std_main.obj" \
+	"$(INTDIR)\tmpindex.obj" \
 	"$(INTDIR)\to_emf.obj" \
 	"$(INTDIR)\to_eps.obj" \
 	"$(INTDIR)\to_escp2.obj" \
@@ -342,11 +350,21 @@ SOURCE=.\picbuf.c
 "$(INTDIR)\picbuf.obj" : $(SOURCE) "$(INTDIR)"
 
 
+SOURCE=.\rle.c
+
+"$(INTDIR)\rle.obj" : $(SOURCE) "$(INTDIR)"
+
+
 SOURCE=.\std_main.c
 
 "$(INTDIR)\std_main.obj" : $(SOURCE) "$(INTDIR)"
 
 
+SOURCE=.\tmpindex.c
+
+"$(INTDIR)\tmpindex.obj" : $(SOURCE) "$(INTDIR)"
+
+
 SOURCE=.\to_emf.c
 
 "$(INTDIR)\to_emf.obj" : $(SOURCE) "$(INTDIR)"
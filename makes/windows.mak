@@ -195,8 +195,8 @@ EX_OBJ	=
 EX_DEFS	=
 #
 # PNG support (requires -lpng and -lz on the ALL_LIBS line)
-EX_SRC	= png.c to_png.c
-EX_OBJ	= png.$O to_png.$O 
+EX_SRC	= png.c to_png.c to_tiles.c
+EX_OBJ	= png.$O to_png.$O to_tiles.$O 
 EX_DEFS= -DPNG
 #
 # TIFF support (requires -ltiff and possibly -lz on the ALL_LIBS line)
@@ -222,12 +222,12 @@ ALL_CFLAGS	= -c $(CFLAGS)
 SRCS	= hp2xx.c hpgl.c picbuf.c bresnham.c chardraw.c getopt.c getopt1.c \
 	  $(ALL_INCS)\
 	  to_vec.c to_pcx.c to_pcl.c to_eps.c to_img.c to_pbm.c to_rgip.c \
-	  std_main.c to_fig.c clip.c fillpoly.c pendef.c lindef.c \
+	  std_main.c to_fig.c clip.c fillpoly.c pendef.c lindef.c tmpindex.c rle.c \
 	  $(PREVIEWER).c $(EX_SRC)
 
 OBJS	= hp2xx.$O hpgl.$O picbuf.$O bresnham.$O chardraw.$O getopt.$O getopt1.$O \
 	  to_vec.$O to_pcx.$O to_pcl.$O to_eps.$O to_img.$O to_pbm.$O to_rgip.$O \
-	  std_main.$O to_fig.$O clip.$O fillpoly.$O pendef.$O lindef.$O \
+	  std_main.$O to_fig.$O clip.$O fillpoly.$O pendef.$O lindef.$O tmpindex.$O rle.$O \
 	  $(PREVIEWER).$O $(EX_OBJ)
 
 PROGRAM	= hp2xx$(EXE)
@@ -26,6 +26,7 @@ copies.
  ** 1991/01/04  V 1.00  HWW  Due to pseudocode in D.F. Rogers (1986) McGraw Hill
  ** 1991/10/15  V 1.01  HWW  ANSI_C
  ** 2002/04/28	V 1.02  AJB  Move static vars into struct
+ ** 2026/10/19	V 1.03       bresenham_skip()
  **/
 
 #define	TEST	0
@@ -126,6 +127,45 @@ int bresenham_next(void)
 	return ((bres.count) ? 0 : BRESENHAM_EOL);
 }
 
+/**
+ ** Advance by n points at once, exactly as n calls of bresenham_next()
+ ** would, e.g. to the first point of a line inside a window. After the
+ ** first n-1 steps, the error term was err + (n-1)*dy, and every step
+ ** along the minor axis took dx off it while it was not negative.
+ **/
+void bresenham_skip(int n)
+{
+	double e;
+	long m;
+
+	if (n > bres.count)
+		n = bres.count;
+	if (n <= 0)
+		return;
+	e = bres.err + (double) (n - 1) * bres.dy;
+	if (e < 0.0)
+		m = 0;
+	else {
+		m = (long) (e / bres.dx);	/* floor(e/dx) + 1, exactly */
+		while ((double) m * bres.dx > e)
+			m--;
+		while ((double) (m + 1) * bres.dx <= e)
+			m++;
+		m++;
+	}
+	if (bres.swapdir) {
+		bres.p_act.x += bres.s1 * (int) m;
+		bres.p_act.y += bres.s2 * n;
+	} else {
+		bres.p_act.y += bres.s2 * (int) m;
+		bres.p_act.x += bres.s1 * n;
+	}
+	bres.err = (int) (bres.err + (double) n * bres.dy -
+			  (double) m * bres.dx);
+	bres.count -= n;
+}
+
+
 	/* Test module */
 #if TEST
 #ifdef __TURBOC__ && __MSDOS__
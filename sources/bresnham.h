@@ -28,6 +28,7 @@ copies.
  **
  ** 1991/01/04  V 1.00  HWW Originating
  ** 1992/01/12  V 1.01  HWW ANSI prototypes required now
+ ** 2026/10/19  V 1.02      bresenham_skip()
  **/
 
 
@@ -42,5 +43,6 @@ typedef struct {
 
 DevPt *bresenham_init(DevPt *, DevPt *);
 int bresenham_next(void);
+void bresenham_skip(int);
 
 #endif				/* BRESNHAM_H */
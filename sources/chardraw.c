@@ -36,6 +36,9 @@ copies.
  ** 93/04/13 HWW  V 2.04a plot_user_char() added (code by A. Treindl)
  ** 94/01/02 HWW  V 2.05a Symbol plotting: improved centering (L. Lowe)
  ** 94/02/14 HWW  V 2.05b Adapted to changes in hp2xx.h
+ ** 26/10/19       V 2.06  Glyph cache: decoded strokes kept per font & char
+ ** 26/10/19       V 2.07  TrueType outline cache, curves flattened by size
+ ** 26/10/19       V 2.08  Labels as TEXT records where the mode writes text
  **/
 
 #include <stdio.h>
@@ -69,14 +72,32 @@ int tt_stroke_moveto(FT_Vector *, void *);
 int tt_stroke_lineto(FT_Vector *, void *);
 int tt_bezier1(FT_Vector *, FT_Vector *, void *);
 int tt_bezier2(FT_Vector *, FT_Vector *, FT_Vector *, void *);
-HPGL_Pt polygon[MAXPOLY], oldp;
-int numpoints;
+HPGL_Pt oldp;
+static PolyBuf polygon = { NULL, -1, 0 };
 int ttfont = 0;
 
 FT_Library library;
 FT_Face face;
 FT_Vector tt_refpoint;
 
+#define	TT_FLAT_TOL	0.25	/* Max. flattening error [plotter units] */
+#define	TT_MAX_STEPS	50	/* Max. number of chords per curve      */
+
+/**
+ ** Outline cache: Glyph edges in font units, flattened for a size
+ ** class of the text matrix, are kept per character code and class.
+ **/
+
+typedef struct TTGlyph {
+	int size;		/* Size class, see get_tt_glyph()       */
+	int n;			/* Number of edge points (pairs)        */
+	HPGL_Pt *pt;
+	struct TTGlyph *next;	/* Same char., other size class         */
+} TTGlyph;
+
+static TTGlyph *tt_glyphs[256];
+static double tt_tol;		/* Flattening tolerance [font units]    */
+
 static const FT_Outline_Funcs my_tt_functions = {
 	(FT_Outline_MoveTo_Func) tt_stroke_moveto,
 	(FT_Outline_LineTo_Func) tt_stroke_lineto,
@@ -100,12 +121,45 @@ extern HPGL_Pt HP_pos, P1, P2;
 
 extern int iwflag;
 extern short scale_flag;
+extern short native_text;
 extern int mode_vert;
 extern HPGL_Pt C1, C2;
 extern HPGL_Pt S1, Q;
 TEXTPAR TEXTP, *tp = &TEXTP;
 
 
+#define	GLYPH_SETS	8	/* Max. number of fonts in glyph cache  */
+#define	GLYPH_BS	1	/* Char. backspaces before drawing      */
+#define	GLYPH_BAD	2	/* Char. illegal, replaced by a blank   */
+
+#define	ILLEGAL_CHAR_MSG "Illegal char in string: %d = %c replaced by blank!\n"
+
+/**
+ ** Glyph cache: The strokes of each character, decoded from the
+ ** charset tables into character cell units, are kept per font.
+ ** A label then just maps them through the text matrix.
+ **/
+
+typedef struct {
+	int n;			/* Number of stroke points, -1: not decoded */
+	int flags;		/* GLYPH_BS, GLYPH_BAD                  */
+	HPGL_Pt *pt;		/* Stroke points, char. cell units      */
+	char *draw;		/* Pen down before point                */
+} Glyph;
+
+typedef struct {
+	int font;
+	Glyph glyph[256];	/* Indexed by character code byte       */
+} GlyphSet;
+
+static GlyphSet *glyph_sets[GLYPH_SETS];
+static int n_glyph_sets = 0, next_glyph_set = 0;
+
+static HPGL_Pt *glyph_buf = NULL;	/* Transformed strokes of a char. */
+static char *glyph_pen = NULL;
+static int glyph_buf_size = 0;
+
+
 
 static void code_to_ucoord(char c, HPGL_Pt * pp)
 /**
@@ -130,23 +184,17 @@ static void code_to_ucoord(char c, HPGL_Pt * pp)
 
 
 
-static void ASCII_to_char(int c)
+static char *char_strokes(int c, int *p_flags)
 /**
- ** Main user interface: Convert ASCII code c into a sequence
- ** of move/draw vectors which draw a corresponding character
+ ** Look up the stroke codes of ASCII code c in the charset table of
+ ** the current font. Flags tell about backspacing (GLYPH_BS) and
+ ** characters replaced by a blank (GLYPH_BAD).
  **/
 {
-	HPGL_Pt p;
 	char *ptr;
-	int outside = 0;
 	static int warnfont = 0;
-	int SafeLineType = CurrentLineType;
-	LineEnds SafeLineEnd = CurrentLineEnd;
-
-	CurrentLineType = LT_solid;
-	PlotCmd_to_tmpfile(DEF_LA);
-	Line_Attr_to_tmpfile(LineAttrEnd, LAE_round);
 
+	*p_flags = 0;
 	switch (tp->font) {
 	case 0:		/* charset 0, limited to 7 bit ASCII - 8bit addressing maps to charset 7        */
 
@@ -162,14 +210,12 @@ static void ASCII_to_char(int c)
 	case 1:		/* charset 1, 9825      */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		if (c == 95 || c == 96 || c == 126) {	/* backspacing for special characters  */
-			tp->refpoint.x -= tp->chardiff.x;
-			tp->refpoint.y -= tp->chardiff.y;
+			*p_flags |= GLYPH_BS;
 		}
 		ptr = &charset1[c][0];
 		break;
@@ -177,14 +223,12 @@ static void ASCII_to_char(int c)
 	case 2:		/* charset 2, French/German     */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		if (c == 39 || c == 94 || c == 95 || c == 96 || c == 123 || c == 124 || c == 125) {	/* backspacing for special characters  */
-			tp->refpoint.x -= tp->chardiff.x;
-			tp->refpoint.y -= tp->chardiff.y;
+			*p_flags |= GLYPH_BS;
 		}
 		ptr = &charset2[c][0];
 		break;
@@ -192,14 +236,12 @@ static void ASCII_to_char(int c)
 	case 3:		/* charset 3, Scandinavian      */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		if (c == 95 || c >= 123) {	/* backspacing for special characters  */
-			tp->refpoint.x -= tp->chardiff.x;
-			tp->refpoint.y -= tp->chardiff.y;
+			*p_flags |= GLYPH_BS;
 		}
 		ptr = &charset3[c][0];
 		break;
@@ -207,14 +249,12 @@ static void ASCII_to_char(int c)
 	case 4:		/* charset 4, Spanish/Latin American    */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		if (c == 39 || c == 94 || c == 95 || c >= 123) {	/* backspacing for special characters  */
-			tp->refpoint.x -= tp->chardiff.x;
-			tp->refpoint.y -= tp->chardiff.y;
+			*p_flags |= GLYPH_BS;
 		}
 		ptr = &charset4[c][0];
 		break;
@@ -222,14 +262,12 @@ static void ASCII_to_char(int c)
 	case 5:		/* charset 5, Special Symbols   */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		if (c == 101) {	/* backspacing for special characters  */
-			tp->refpoint.x -= tp->chardiff.x;
-			tp->refpoint.y -= tp->chardiff.y;
+			*p_flags |= GLYPH_BS;
 		}
 		ptr = &charset5[c][0];
 		break;
@@ -237,9 +275,8 @@ static void ASCII_to_char(int c)
 	case 6:		/* charset 6, JIS ASCII */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		ptr = &charset6[c][0];
@@ -248,9 +285,8 @@ static void ASCII_to_char(int c)
 	case 7:		/* charset 7, 'HP Roman 8', limited to 7 bit ASCII      */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		ptr = &charset7[c][0];
@@ -259,9 +295,8 @@ static void ASCII_to_char(int c)
 	case 9:		/* charset 9, 'ISO Reference Version' */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		switch (c) {
@@ -281,9 +316,8 @@ static void ASCII_to_char(int c)
 	case 30:		/* charset 30, 'ISO 646 Swedish' */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		switch (c) {
@@ -326,9 +360,8 @@ static void ASCII_to_char(int c)
 	case 31:		/* charset 31, 'ISO 646 Swedish for Names' */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		switch (c) {
@@ -384,9 +417,8 @@ static void ASCII_to_char(int c)
 	case 32:		/* charset 30, 'ISO 646 Norway, Version 1' */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		switch (c) {
@@ -425,9 +457,8 @@ static void ASCII_to_char(int c)
 	case 33:		/* charset 33, 'ISO 646 German' */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		switch (c) {
@@ -471,9 +502,8 @@ static void ASCII_to_char(int c)
 	case 34:		/* charset 34, 'ISO 646 French' */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		switch (c) {
@@ -521,9 +551,8 @@ static void ASCII_to_char(int c)
 	case 35:		/* charset 35, 'ISO 646 United Kingdom' */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		switch (c) {
@@ -542,9 +571,8 @@ static void ASCII_to_char(int c)
 	case 36:		/* charset 36, 'ISO 646 Italian' */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		switch (c) {
@@ -597,9 +625,8 @@ static void ASCII_to_char(int c)
 	case 37:		/* charset 37, 'ISO 646 Spanish' */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		switch (c) {
@@ -645,9 +672,8 @@ static void ASCII_to_char(int c)
 	case 38:		/* charset 38, 'ISO 646 Portuguese' */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		switch (c) {
@@ -692,9 +718,8 @@ static void ASCII_to_char(int c)
 	case 39:		/* charset 39, 'ISO 646 Norway Version 2' */
 
 		if (c & 0x80) {
-			Eprintf
-			    ("Illegal char in string: %d = %c replaced by blank!\n",
-			     c, c);
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+			*p_flags |= GLYPH_BAD;
 			c = ' ';
 		}
 		switch (c) {
@@ -762,35 +787,269 @@ static void ASCII_to_char(int c)
 		break;
 	}
 
-	for (; *ptr; ptr++) {	/* Draw this char */
-		code_to_ucoord(*ptr & 0x7f, &p);
-		 /*MK*/ if (iwflag) {
-			if (scale_flag) {
-				if (P1.x + p.x > C2.x || P1.y + p.y > C2.y) {
-					outside = 1;
-				}
-				if (P1.x + p.x < C1.x || P1.y + p.y < C1.y) {
-					outside = 1;
-				}
-			} else {
-				if (P1.x + (p.x - S1.x) * Q.x > C2.x
-				    || P1.y + (p.y - S1.y) * Q.y > C2.y) {
-					outside = 1;
-				}
-				if (P1.x + (p.x - S1.x) * Q.x < C1.x
-				    || P1.y + (p.y - S1.y) * Q.y < C1.y) {
-					outside = 1;
-				}
+	return ptr;
+}
+
+
+
+static GlyphSet *new_glyph_set(void)
+/**
+ ** Set up an empty glyph set for the current font. When all sets are
+ ** in use, the oldest one is recycled.
+ **/
+{
+	GlyphSet *gs;
+	int i;
+
+	if (n_glyph_sets < GLYPH_SETS) {
+		gs = (GlyphSet *) malloc(sizeof(GlyphSet));
+		if (gs == NULL) {
+			Eprintf("\nNo memory for glyph cache\n");
+			exit(ERROR);
+		}
+		glyph_sets[n_glyph_sets++] = gs;
+	} else {
+		gs = glyph_sets[next_glyph_set];
+		next_glyph_set = (next_glyph_set + 1) % GLYPH_SETS;
+		for (i = 0; i < 256; i++)
+			if (gs->glyph[i].n > 0) {
+				free(gs->glyph[i].pt);
+				free(gs->glyph[i].draw);
+			}
+	}
+	gs->font = tp->font;
+	for (i = 0; i < 256; i++)
+		gs->glyph[i].n = -1;
+	return gs;
+}
+
+
+
+static const Glyph *get_glyph(int c)
+/**
+ ** Strokes of ASCII code c in the current font, decoded into
+ ** character cell units on first use
+ **/
+{
+	static GlyphSet *gs = NULL;
+	Glyph *g;
+	HPGL_Pt *pt;
+	char *ptr;
+	int i, n;
+
+	if (gs == NULL || gs->font != tp->font) {
+		for (i = 0, gs = NULL; i < n_glyph_sets; i++)
+			if (glyph_sets[i]->font == tp->font) {
+				gs = glyph_sets[i];
+				break;
 			}
+		if (gs == NULL)
+			gs = new_glyph_set();
+	}
+
+	g = &gs->glyph[c & 0xff];
+	if (g->n >= 0) {
+		if (g->flags & GLYPH_BAD)
+			Eprintf(ILLEGAL_CHAR_MSG, c, c);
+		return g;
+	}
+
+	ptr = char_strokes(c, &g->flags);
+	n = (int) strlen(ptr);
+	g->n = n;
+	if (n == 0)
+		return g;
+	pt = (HPGL_Pt *) malloc(n * sizeof(HPGL_Pt));
+	g->draw = (char *) malloc((size_t) n);
+	if (pt == NULL || g->draw == NULL) {
+		Eprintf("\nNo memory for glyph cache\n");
+		exit(ERROR);
+	}
+	g->pt = pt;
+	for (i = 0; i < n; i++, ptr++) {	/* See code_to_ucoord() */
+		pt[i].x = (float) (((*ptr & 0x7f) >> 4) - 1);
+		pt[i].y = (float) ((*ptr & 0x0f) - 4);
+		g->draw[i] = (*ptr & 0x80) != 0;	/* High bit is draw flag */
+	}
+
+	if (n > glyph_buf_size) {
+		free(glyph_buf);
+		free(glyph_pen);
+		glyph_buf = (HPGL_Pt *) malloc(n * sizeof(HPGL_Pt));
+		glyph_pen = (char *) malloc((size_t) n);
+		if (glyph_buf == NULL || glyph_pen == NULL) {
+			Eprintf("\nNo memory for glyph cache\n");
+			exit(ERROR);
 		}
+		glyph_buf_size = n;
+	}
+	return g;
+}
+
+
+
+static int label_clipped(const HPGL_Pt * p)
+/**
+ ** TRUE if label point p lies outside the IW window
+ **/
+{
+	if (scale_flag)
+		return (P1.x + p->x > C2.x || P1.y + p->y > C2.y ||
+			P1.x + p->x < C1.x || P1.y + p->y < C1.y);
+	return (P1.x + (p->x - S1.x) * Q.x > C2.x
+		|| P1.y + (p->y - S1.y) * Q.y > C2.y
+		|| P1.x + (p->x - S1.x) * Q.x < C1.x
+		|| P1.y + (p->y - S1.y) * Q.y < C1.y);
+}
+
 
-		if ((*ptr & 0x80) && !outside)	/* High bit is draw flag */
-			Pen_action_to_tmpfile(DRAW_TO, &p, FALSE);
-		else
-			Pen_action_to_tmpfile(MOVE_TO, &p, FALSE);
 
-		outside = 0;
+int stick_glyph(int font, int c, const HPGL_Pt ** p_pt, const char **p_draw)
+/**
+ ** Strokes of char. c in stick font no. font, for modes defining it as a
+ ** font of their own. Returns the number of points.
+ **/
+{
+	const Glyph *g;
+	int saved_font = tp->font;
+
+	tp->font = font;
+	g = get_glyph(c);
+	tp->font = saved_font;
+	*p_pt = g->pt;
+	*p_draw = g->draw;
+	return g->n;
+}
+
+
+
+static int ascii_glyph(int c)
+/**
+ ** TRUE if the current font draws char. c from the ASCII set (font 0)
+ **/
+{
+	int flags;
+
+	return char_strokes(c, &flags) == charset0[c] && flags == 0;
+}
+
+
+
+static int text_to_tmpfile(const char *txt)
+/**
+ ** Record the longest run of plain ASCII characters at txt as one
+ ** TEXT, if the output mode takes labels as text. Returns the number
+ ** of characters done, 0 if they need to be drawn as vectors.
+ **/
+{
+	HPGL_Text t;
+	HPGL_Pt ink[2], p;
+	const Glyph *g;
+	double det, x, y;
+	int i, j, n;
+
+	if (!native_text || iwflag || mode_vert)
+		return 0;
+#ifdef STROKED_FONTS
+	if (ttfont)
+		return 0;
+#endif
+	/* Char. advance along the cell's x axis, in cell units */
+	det = tp->Txx * tp->Txx + tp->Tyx * tp->Tyx;
+	if (det < 1.e-12 || fabs(tp->chardiff.x * tp->Tyx -
+				 tp->chardiff.y * tp->Txx) > 1.e-6 * det)
+		return 0;
+	t.adv = (float) ((tp->Txx * tp->chardiff.x +
+			  tp->Tyx * tp->chardiff.y) / det);
+	t.org.x = tp->refpoint.x + tp->offset.x;
+	t.org.y = tp->refpoint.y + tp->offset.y;
+
+	/* Extent of all points drawn, as ASCII_to_char() would draw them */
+	ink[0].x = ink[0].y = 1.e10;
+	ink[1].x = ink[1].y = -1.e10;
+	for (i = n = 0; txt[i] > ' ' || (txt[i] == ' ' && i > 0); i++) {
+		if (txt[i] > '~')
+			break;
+		if (!ascii_glyph((int) txt[i]))
+			break;
+		g = get_glyph((int) txt[i]);
+		for (j = -1; j < g->n; j++) {
+			if (j < 0) {
+				if (g->n == 0 || !g->draw[0])
+					continue;
+				x = y = 0.0;	/* Drawn from the origin */
+			} else if (!g->draw[j] && (j + 1 == g->n
+						   || !g->draw[j + 1]))
+				continue;	/* Just a move */
+			else {
+				x = g->pt[j].x;
+				y = g->pt[j].y;
+			}
+			x += i * t.adv;
+			p.x = (float) (tp->Txx * x + tp->Txy * y + t.org.x);
+			p.y = (float) (tp->Tyx * x + tp->Tyy * y + t.org.y);
+			ink[0].x = MIN(ink[0].x, p.x);
+			ink[0].y = MIN(ink[0].y, p.y);
+			ink[1].x = MAX(ink[1].x, p.x);
+			ink[1].y = MAX(ink[1].y, p.y);
+		}
+		if (txt[i] != ' ')
+			n = i + 1;	/* Trailing blanks are just moves */
+	}
+	if (n == 0 || ink[0].x > ink[1].x)
+		return 0;
+
+	t.m[0] = (float) tp->Txx;
+	t.m[1] = (float) tp->Tyx;
+	t.m[2] = (float) tp->Txy;
+	t.m[3] = (float) tp->Tyy;
+	t.font = 0;
+	t.n = n;
+	if (Text_to_tmpfile(&t, txt, ink))
+		return 0;
+	return n;
+}
+
+
+
+static void ASCII_to_char(int c)
+/**
+ ** Main user interface: Convert ASCII code c into a sequence
+ ** of move/draw vectors which draw a corresponding character
+ **/
+{
+	const Glyph *g;
+	double x, y, rx, ry, ox, oy;
+	int i;
+	int SafeLineType = CurrentLineType;
+	LineEnds SafeLineEnd = CurrentLineEnd;
+
+	CurrentLineType = LT_solid;
+	PlotCmd_to_tmpfile(DEF_LA);
+	Line_Attr_to_tmpfile(LineAttrEnd, LAE_round);
+
+	g = get_glyph(c);
+	if (g->flags & GLYPH_BS) {	/* backspacing for special characters */
+		tp->refpoint.x -= tp->chardiff.x;
+		tp->refpoint.y -= tp->chardiff.y;
+	}
+
+	/* Draw this char: the text matrix applied to all its strokes */
+	rx = tp->refpoint.x;
+	ry = tp->refpoint.y;
+	ox = tp->offset.x;
+	oy = tp->offset.y;
+	for (i = 0; i < g->n; i++) {
+		x = g->pt[i].x;
+		y = g->pt[i].y;
+		glyph_buf[i].x = tp->Txx * x + tp->Txy * y + rx + ox;
+		glyph_buf[i].y = tp->Tyx * x + tp->Tyy * y + ry + oy;
 	}
+	for (i = 0; i < g->n; i++)
+		glyph_pen[i] = g->draw[i] && !(iwflag
+					       && label_clipped(&glyph_buf[i]));
+	if (g->n > 0)
+		Polyline_to_tmpfile(glyph_buf, glyph_pen, g->n);
 
 	/* Update cursor: to next character origin!   */
 
@@ -1024,6 +1283,7 @@ void plot_string(char *txt, LB_Mode mode, short current_pen)
 {
 	char *txt0;
 	double savedwidth = 0.;
+	int n;
 
 	txt0 = txt;
 	tp->refpoint = HP_pos;
@@ -1086,6 +1346,14 @@ void plot_string(char *txt, LB_Mode mode, short current_pen)
 			tp->font = tp->stdfont;
 			break;
 		default:
+			if ((n = text_to_tmpfile(txt)) > 0) {
+				tp->refpoint.x += n * tp->chardiff.x;
+				tp->refpoint.y += n * tp->chardiff.y;
+				Pen_action_to_tmpfile(MOVE_TO, &tp->refpoint,
+						      FALSE);
+				txt += n;
+				continue;
+			}
 #ifdef STROKED_FONTS
 			if (ttfont)
 				ASCII_to_font((int) *txt);
@@ -1323,13 +1591,93 @@ int init_font(int thefont)
 }
 
 
+static int tt_steps(double d)
+/**
+ ** Number of chords for a curve whose second derivative is at most 8 d,
+ ** such that no chord strays more than tt_tol from it
+ **/
+{
+	int n;
+
+	n = (int) ceil(sqrt(d / tt_tol));
+	return (n < 1) ? 1 : (n > TT_MAX_STEPS) ? TT_MAX_STEPS : n;
+}
+
+
+
+static void tt_edge_to(double x, double y)
+{
+	HPGL_Pt p;
+
+	p.x = x;
+	p.y = y;
+	PolyBuf_add(&polygon, oldp);
+	PolyBuf_add(&polygon, p);
+	oldp = p;
+}
+
+
+
+static const TTGlyph *get_tt_glyph(int c)
+/**
+ ** Outline of character code c as edges in font units, flattened
+ ** for the size class of the current text matrix. Decoded by
+ ** FreeType on first use only.
+ **/
+{
+	TTGlyph *g;
+	int size, dummy;
+
+	/* Size class: up to 2^size plotter units per font unit */
+	(void) frexp(MAX(MAX(fabs(tp->Txx), fabs(tp->Txy)),
+			 MAX(fabs(tp->Tyx), fabs(tp->Tyy))) / 200., &size);
+
+	for (g = tt_glyphs[c]; g != NULL; g = g->next)
+		if (g->size == size)
+			return g;
+
+	if ((g = (TTGlyph *) malloc(sizeof(TTGlyph))) == NULL) {
+		Eprintf("\nNo memory for glyph cache\n");
+		exit(ERROR);
+	}
+	g->size = size;
+	g->n = 0;
+	g->pt = NULL;
+	g->next = tt_glyphs[c];
+	tt_glyphs[c] = g;
+
+	if (FT_Load_Char(face, (FT_ULong) c, FT_LOAD_NO_SCALE)) {
+		fprintf(stderr, " ! FT_Load_Char %c\n", c);
+		return g;
+	}
+
+	tt_tol = ldexp(TT_FLAT_TOL, -size);
+	tt_refpoint.x = 0;
+	tt_refpoint.y = 0;
+	polygon.last = -1;
+	if (FT_Outline_Decompose(&face->glyph->outline, &my_tt_functions,
+				 &dummy))
+		fprintf(stderr, " ! FT_Outline_Decompose\n");
+
+	if ((g->n = polygon.last + 1) > 0) {
+		if ((g->pt = (HPGL_Pt *) malloc(g->n * sizeof(HPGL_Pt))) ==
+		    NULL) {
+			Eprintf("\nNo memory for glyph cache\n");
+			exit(ERROR);
+		}
+		memcpy(g->pt, polygon.pt, g->n * sizeof(HPGL_Pt));
+	}
+	return g;
+}
+
+
+
 void ASCII_to_font(int c)
 {
-	int error;
-	int dummy;
-	HPGL_Pt boxmin, boxmax;
-	FT_GlyphSlot slot = face->glyph;
-	FT_Outline *theoutline = &slot->outline;
+	const TTGlyph *g;
+	HPGL_Pt p, boxmin, boxmax;
+	double x, y;
+	int i;
 	int SafeLineType = CurrentLineType;
 	LineEnds SafeLineEnd = CurrentLineEnd;
 
@@ -1376,39 +1724,27 @@ void ASCII_to_font(int c)
 		default:
 			break;
 		}
-	error = FT_Load_Char(face, (FT_ULong) c, FT_LOAD_NO_SCALE);
-	if (error) {
-		fprintf(stderr, " ! FT_Load_Char %c\n", c);
-		return;
-	}
-#if 0
-	fprintf(stderr, "metrics : width %d, height %d advance %d\n",
-		(int) (slot->metrics.width / 64.),
-		(int) (slot->metrics.height / 64.),
-		(int) (slot->metrics.horiAdvance / 64.));
-	fprintf(stderr, "FT_Outline_Decompose...\n");
-#endif
 
-	numpoints = -1;
-
-	error = FT_Outline_Decompose(theoutline, &my_tt_functions, &dummy);
-	if (error)
-		fprintf(stderr, " ! FT_Outline_Decompose\n");
-#if 0
-	fprintf(stderr, "refpoint %f %f + chardiff %f %f\n",
-		tp->refpoint.x, tp->refpoint.y, tp->chardiff.x,
-		tp->chardiff.y);
-	fprintf(stderr, "numpoints %d\n", numpoints);
-#endif
-	boxmin.x = tp->refpoint.x - 5;
-	boxmin.y = tp->refpoint.y - 150;
-	boxmax.x = boxmin.x + tp->chardiff.x + 5;
-	boxmax.y = boxmin.y + tp->chardiff.y + 5;
-	fill(polygon, numpoints, boxmin, boxmax, 0, 2, 1, 0);
+	g = get_tt_glyph(c);
+	if (g->n > 0) {
+		polygon.last = -1;
+		for (i = 0; i < g->n; i++) {
+			x = g->pt[i].x;
+			y = g->pt[i].y;
+			p.x = (tp->Txx * x + tp->Txy * y) / 200. +
+			    tp->refpoint.x + tp->offset.x;
+			p.y = (tp->Tyx * x + tp->Tyy * y) / 200. +
+			    tp->refpoint.y + tp->offset.y;
+			PolyBuf_add(&polygon, p);
+		}
+		boxmin.x = tp->refpoint.x - 5;
+		boxmin.y = tp->refpoint.y - 150;
+		boxmax.x = boxmin.x + tp->chardiff.x + 5;
+		boxmax.y = boxmin.y + tp->chardiff.y + 5;
+		fill(polygon.pt, polygon.last, boxmin, boxmax, 0, 2, 1, 0);
+	}
 	tp->refpoint.x += tp->chardiff.x;
 	tp->refpoint.y += tp->chardiff.y;
-	tt_refpoint.x = 0;
-	tt_refpoint.y = 0;
 	/* Restore Line Ends */
 	CurrentLineType = SafeLineType;
 	PlotCmd_to_tmpfile(DEF_LA);
@@ -1416,199 +1752,76 @@ void ASCII_to_font(int c)
 }
 
 
+/**
+ ** FreeType outline callbacks: They collect the edges of a glyph
+ ** in font units
+ **/
+
 int tt_stroke_moveto(FT_Vector * to, void *dummy)
 {
-	HPGL_Pt p;
-#if 0
-	fprintf(stderr, "TT move to %ld %ld (oder ists %d %d ?\?)\n", to->x,
-		to->y, (int) (to->x / 64.), (int) (to->y / 64.));
-#endif
-	p.x = tp->Txx * to->x + tp->Txy * to->y;
-	p.y = tp->Tyx * to->x + tp->Tyy * to->y;
-	p.x = p.x / 200. + tp->refpoint.x + tp->offset.x;
-	p.y = p.y / 200. + tp->refpoint.y + tp->offset.y;
-
-	Pen_action_to_tmpfile(MOVE_TO, &p, FALSE);
-
-	/* Update cursor: to next character origin!   */
+	oldp.x = to->x;
+	oldp.y = to->y;
 	tt_refpoint.x = to->x;
 	tt_refpoint.y = to->y;
-	oldp = p;
-
 	return 0;
 }
 
 int tt_stroke_lineto(FT_Vector * to, void *dummy)
 {
-	HPGL_Pt p;
-	int outside = 0;
-#if 0
-	fprintf(stderr, "TT line to %ld %ld\n", to->x, to->y);
-#endif
-
-	p.x = tp->Txx * to->x + tp->Txy * to->y;
-	p.y = tp->Tyx * to->x + tp->Tyy * to->y;
-	p.x = p.x / 200. + tp->refpoint.x + tp->offset.x;
-	p.y = p.y / 200. + tp->refpoint.y + tp->offset.y;
-#if 0
-	if (iwflag) {
-		if (scale_flag) {
-			if (P1.x + p.x > C2.x || P1.y + p.y > C2.y) {
-				outside = 1;
-			}
-			if (P1.x + p.x < C1.x || P1.y + p.y < C1.y) {
-				outside = 1;
-			}
-		} else {
-			if (P1.x + (p.x - S1.x) * Q.x > C2.x
-			    || P1.y + (p.y - S1.y) * Q.y > C2.y) {
-				outside = 1;
-			}
-			if (P1.x + (p.x - S1.x) * Q.x < C1.x
-			    || P1.y + (p.y - S1.y) * Q.y < C1.y) {
-				outside = 1;
-			}
-		}
-	}
-#endif
-	if (!outside) {
-		/*      Pen_action_to_tmpfile (DRAW_TO, &p, FALSE); */
-		polygon[++numpoints] = oldp;
-		polygon[++numpoints] = p;
-	} else
-		Pen_action_to_tmpfile(MOVE_TO, &p, FALSE);
-
-	outside = 0;
-
-	/* Update cursor: to next character origin!   */
+	tt_edge_to(to->x, to->y);
 	tt_refpoint.x = to->x;
 	tt_refpoint.y = to->y;
-	oldp = p;
 	return 0;
 }
 
 int tt_bezier1(FT_Vector * p1, FT_Vector * p3, void *dummy)
 {
-	HPGL_Pt p, pp;
-	int i, outside;
-	float t;
-	FT_Vector p2;
-
-	p2.x = p1->x;
-	p2.y = p1->y;
+	double t, dx, dy;
+	int i, n;
 
 /*    
-p(t) = t^3*P3 + 3*t^2*(1-t)*P2 + 3*t*(1-t)^2* P1 + (1-t)^3 * P0
+p(t) = t^2*P3 + 2*t*(1-t)*P1 + (1-t)^2 * P0
 */
-#if 0
-	fprintf(stderr, "TT refpoint %ld %ld\n", tt_refpoint.x,
-		tt_refpoint.y);
-#endif
-	outside = 0;
-
-	for (i = 0; i < 51; i++) {
-		t = (float) i / 50.0;
-		p.x =
-		    t * t * t * p3->x + 3 * t * t * (1. - t) * p2.x
-		    + 3 * t * (1. - t) * (1. - t) * p1->x
-		    + (1. - t) * (1. - t) * (1. - t) * tt_refpoint.x;
-		p.y =
-		    t * t * t * p3->y + 3 * t * t * (1. - t) * p2.y
-		    + 3 * t * (1. - t) * (1. - t) * p1->y
-		    + (1. - t) * (1. - t) * (1. - t) * tt_refpoint.y;
-
-		pp.x = tp->Txx * p.x + tp->Txy * p.y;
-		pp.y = tp->Tyx * p.x + tp->Tyy * p.y;
-		pp.x = pp.x / 200. + tp->refpoint.x + tp->offset.x;
-		pp.y = pp.y / 200. + tp->refpoint.y + tp->offset.y;
-/*fprintf(stderr,"bezier point %f %f\n",pp.x,pp.y);*/
-#if 0
-		if (iwflag) {
-			if (P1.x + (pp.x - S1.x) * Q.x > C2.x
-			    || P1.y + (pp.y - S1.y) * Q.y > C2.y) {
-/*fprintf(stderr,"IW set:point %f %f >P2\n",pp.x,pp.y); */
-				outside = 1;
-			}
-			if (P1.x + (pp.x - S1.x) * Q.x < C1.x
-			    || P1.y + (pp.y - S1.y) * Q.y < C1.y) {
-/*fprintf(stderr,"IW set:point  %f %f <P1\n",pp.x,pp.y); */
-				outside = 1;
-			}
-		}
-#endif
-		if (!outside) {
-/*	     Pen_action_to_tmpfile (DRAW_TO, &pp, FALSE);  */
-			polygon[++numpoints] = oldp;
-			polygon[++numpoints] = pp;
-		} else
-			Pen_action_to_tmpfile(MOVE_TO, &pp, FALSE);
-
-		outside = 0;
-		oldp = pp;
+	dx = tt_refpoint.x - 2. * p1->x + p3->x;
+	dy = tt_refpoint.y - 2. * p1->y + p3->y;
+	n = tt_steps(HYPOT(dx, dy) / 4.);
+
+	for (i = 1; i <= n; i++) {
+		t = (double) i / n;
+		tt_edge_to(t * t * p3->x + 2 * t * (1. - t) * p1->x
+			   + (1. - t) * (1. - t) * tt_refpoint.x,
+			   t * t * p3->y + 2 * t * (1. - t) * p1->y
+			   + (1. - t) * (1. - t) * tt_refpoint.y);
 	}
 
-	/* Update cursor: to next character origin!   */
 	tt_refpoint.x = p3->x;
 	tt_refpoint.y = p3->y;
-
 	return 0;
 }
 
 int tt_bezier2(FT_Vector * p1, FT_Vector * p2, FT_Vector * p3, void *dummy)
 {
-	HPGL_Pt p, pp;
-	int i, outside;
-	float t;
+	double t, d1, d2;
+	int i, n;
 
 /*    
 p(t) = t^3*P3 + 3*t^2*(1-t)*P2 + 3*t*(1-t)^2* P1 + (1-t)^3 * P0
 */
-
-	outside = 0;
-
-	for (i = 0; i < 51; i++) {
-		t = (float) i / 50.;
-		p.x =
-		    t * t * t * p3->x + 3 * t * t * (1. - t) * p2->x
-		    + 3 * t * (1. - t) * (1. - t) * p1->x
-		    + (1. - t) * (1. - t) * (1. - t) * tt_refpoint.x;
-		p.y =
-		    t * t * t * p3->y + 3 * t * t * (1. - t) * p2->y
-		    + 3 * t * (1. - t) * (1. - t) * p1->y
-		    + (1. - t) * (1. - t) * (1. - t) * tt_refpoint.y;
-
-		pp.x = tp->Txx * p.x + tp->Txy * p.y;
-		pp.y = tp->Tyx * p.x + tp->Tyy * p.y;
-		pp.x = pp.x / 200. + tp->refpoint.x + tp->offset.x;
-		pp.y = pp.y / 200. + tp->refpoint.y + tp->offset.y;
-/*fprintf(stderr,"bezier point %f %f\n",pp.x,pp.y);*/
-#if 0
-		if (iwflag) {
-			if (P1.x + (pp.x - S1.x) * Q.x > C2.x
-			    || P1.y + (pp.y - S1.y) * Q.y > C2.y) {
-/*fprintf(stderr,"IW set:point %f %f >P2\n",pp.x,pp.y); */
-				outside = 1;
-			}
-			if (P1.x + (pp.x - S1.x) * Q.x < C1.x
-			    || P1.y + (pp.y - S1.y) * Q.y < C1.y) {
-/*fprintf(stderr,"IW set:point  %f %f <P1\n",pp.x,pp.y); */
-				outside = 1;
-			}
-		}
-#endif
-		if (!outside) {
-/*	     Pen_action_to_tmpfile (DRAW_TO, &pp, FALSE);  */
-			polygon[++numpoints] = oldp;
-			polygon[++numpoints] = pp;
-		} else
-			Pen_action_to_tmpfile(MOVE_TO, &pp, FALSE);
-
-		outside = 0;
-		oldp = pp;
-
+	d1 = HYPOT(tt_refpoint.x - 2. * p1->x + p2->x,
+		   tt_refpoint.y - 2. * p1->y + p2->y);
+	d2 = HYPOT(p1->x - 2. * p2->x + p3->x, p1->y - 2. * p2->y + p3->y);
+	n = tt_steps(0.75 * MAX(d1, d2));
+
+	for (i = 1; i <= n; i++) {
+		t = (double) i / n;
+		tt_edge_to(t * t * t * p3->x + 3 * t * t * (1. - t) * p2->x
+			   + 3 * t * (1. - t) * (1. - t) * p1->x
+			   + (1. - t) * (1. - t) * (1. - t) * tt_refpoint.x,
+			   t * t * t * p3->y + 3 * t * t * (1. - t) * p2->y
+			   + 3 * t * (1. - t) * (1. - t) * p1->y
+			   + (1. - t) * (1. - t) * (1. - t) * tt_refpoint.y);
 	}
 
-	/* Update cursor: to next character origin!   */
 	tt_refpoint.x = p3->x;
 	tt_refpoint.y = p3->y;
 	return 0;
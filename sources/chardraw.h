@@ -26,6 +26,7 @@ copies.
  ** 92/02/19  V 1.01  HWW  Derived from sprite.h (V 2.01)
  ** 92/05/28  V 1.02  HWW  plot_symbol_char() added
  ** 99/02/01  V 1.03  MK   charsets 5 and 7 added
+ ** 26/10/19  V 1.04       stick_glyph() added
  **
  ** Structure definition as used by pplib for character drawing
  **/
@@ -137,6 +138,7 @@ extern "C" {
 /* void	ASCII_to_char	(int);*/
 	void plot_string(char *, LB_Mode, short);
 	void plot_symbol_char(char);
+	int stick_glyph(int, int, const HPGL_Pt **, const char **);
 
 #ifdef	__cplusplus
 }
@@ -9,20 +9,162 @@
 #include "lindef.h"
 #include "pendef.h"
 
+typedef struct {
+	double x, y;
+} HPGL_Pt2;
+
+/**
+ ** Active edge table for hatching: Each hatch line of a family is a
+ ** level line  c = u + (v - o) * k  (u, v: y, x for lines along x,
+ ** x, y for the FILL_VERT family). Edges are sorted once by their
+ ** lowest c, so each hatch line only visits the edges spanning it.
+ **/
+typedef struct {
+	double lo, hi;		/* Range of c covered by the edge  */
+	int j;			/* Index of first point of edge    */
+} HatchEdge;
+
+static HatchEdge *hatch_edge = NULL;
+static int *hatch_active = NULL;
+static HPGL_Pt2 *segment = NULL;
+static int hatch_size = 0;
+static int n_edges, n_active, next_edge;
+
+
+static int cmp_HatchEdge(const void *a, const void *b)
+{
+	double d = ((const HatchEdge *) a)->lo - ((const HatchEdge *) b)->lo;
+
+	return (d < 0.0) ? -1 : (d > 0.0);
+}
+
+
+static int cmp_seg_x(const void *a, const void *b)
+{
+	double d = ((const HPGL_Pt2 *) a)->x - ((const HPGL_Pt2 *) b)->x;
+
+	return (d < 0.0) ? -1 : (d > 0.0);
+}
+
+
+static int cmp_seg_y(const void *a, const void *b)
+{
+	double d = ((const HPGL_Pt2 *) a)->y - ((const HPGL_Pt2 *) b)->y;
+
+	return (d < 0.0) ? -1 : (d > 0.0);
+}
+
+
+static int hatch_edges_init(const HPGL_Pt polygon[], int numpoints,
+			    int vert, double o, double k)
+{
+	HatchEdge *e;
+	double c0, c1;
+	int j, n = numpoints / 2 + 1;
+
+	if (n > hatch_size) {
+		free(hatch_edge);
+		free(hatch_active);
+		free(segment);
+		hatch_edge = (HatchEdge *) malloc(n * sizeof(HatchEdge));
+		hatch_active = (int *) malloc(n * sizeof(int));
+		segment = (HPGL_Pt2 *) malloc(n * sizeof(HPGL_Pt2));
+		if (hatch_edge == NULL || hatch_active == NULL
+		    || segment == NULL) {
+			Eprintf("\nNo memory for polygon fill - skipped\n");
+			hatch_size = 0;
+			return ERROR;
+		}
+		hatch_size = n;
+	}
+	for (j = 0, e = hatch_edge; j < numpoints; j += 2, e++) {
+		if (vert) {
+			c0 = polygon[j].x + (polygon[j].y - o) * k;
+			c1 = polygon[j + 1].x + (polygon[j + 1].y - o) * k;
+		} else {
+			c0 = polygon[j].y + (polygon[j].x - o) * k;
+			c1 = polygon[j + 1].y + (polygon[j + 1].x - o) * k;
+		}
+		e->lo = MIN(c0, c1);
+		e->hi = MAX(c0, c1);
+		e->j = j;
+	}
+	n_edges = (int) (e - hatch_edge);
+	qsort(hatch_edge, (size_t) n_edges, sizeof(HatchEdge),
+	      cmp_HatchEdge);
+	n_active = next_edge = 0;
+	return 0;
+}
+
+
+static void hatch_edges_active(double c, double eps)
+/**
+ ** Update the active edges for hatch line c (lines in ascending order)
+ **/
+{
+	int a, b;
+
+	for (a = b = 0; a < n_active; a++)
+		if (hatch_edge[hatch_active[a]].hi >= c - eps)
+			hatch_active[b++] = hatch_active[a];
+	n_active = b;
+	while (next_edge < n_edges && hatch_edge[next_edge].lo <= c + eps)
+		if (hatch_edge[next_edge++].hi >= c - eps)
+			hatch_active[n_active++] = next_edge - 1;
+}
+
+
+static int hatch_sort(int k, int vert)
+/**
+ ** Sort the intersections segment[0..k] along the hatch line and
+ ** drop duplicates (a vertex shared by two edges). Returns new k.
+ **/
+{
+	int i, n;
+
+	qsort(segment, (size_t) (k + 1), sizeof(HPGL_Pt2),
+	      vert ? cmp_seg_y : cmp_seg_x);
+	for (i = 1, n = 0; i <= k; i++)
+		if (vert ? fabs(segment[i].y - segment[n].y) >= 1.e-8
+		    : fabs(segment[i].x - segment[n].x) >= 1.e-8)
+			segment[++n] = segment[i];
+	return (k < 0) ? k : n;
+}
+
+
+void PolyBuf_add(PolyBuf * pb, HPGL_Pt p)
+/**
+ ** Append a point, doubling the buffer when full
+ **/
+{
+	HPGL_Pt *q;
+	int size;
+
+	if (pb->last + 1 >= pb->size) {
+		size = pb->size ? 2 * pb->size : 1024;
+		q = (HPGL_Pt *) realloc(pb->pt, size * sizeof(HPGL_Pt));
+		if (q == NULL) {
+			Eprintf("\nNo memory for polygon of %d points\n",
+				pb->last + 2);
+			exit(ERROR);
+		}
+		pb->pt = q;
+		pb->size = size;
+	}
+	pb->pt[++pb->last] = p;
+}
+
+
 void fill(HPGL_Pt polygon[], int numpoints, HPGL_Pt point1,
 	  HPGL_Pt point2, int scale_flag, int filltype, float spacing,
 	  float hatchangle)
 {
-	typedef struct {
-		double x, y;
-	} HPGL_Pt2;
 	double pxmin, pxmax, pymin, pymax;
 	double polyxmin, polyymin, polyxmax, polyymax;
 	double scanx1, scanx2, scany1, scany2;
-	HPGL_Pt2 segment[MAXPOLY], tmp;
-	double segx, segy;
+	double segx, segy, slope;
 	static int i;		/* to please valgrind when debugging memory accesses */
-	int j, k, jj, kk;
+	int j, k, a;
 	int numlines;
 	double penwidth;
 	HPGL_Pt p;
@@ -31,6 +173,12 @@ void fill(HPGL_Pt polygon[], int numpoints, HPGL_Pt point1,
 	double avx, avy, bvx, bvy, ax, ay, bx, by, atx, aty, btx, bty, mu;
 	PEN_W SafePenW = pt.width[1];
 	LineEnds SafeLineEnd = CurrentLineEnd;
+
+	/* Solid fills: let the output mode fill the polygon itself */
+	if (filltype < 3
+	    && Polygon_to_tmpfile(polygon, numpoints, scale_flag) == 0)
+		return;
+
 	CurrentLineEnd = LAE_butt;
 
 	penwidth = 0.1;
@@ -119,6 +267,9 @@ return;
 
 	if (hatchangle != 0.)
 		pydiff = tan(M_PI * hatchangle / 180.) * pxdiff;
+	slope = (pxdiff != 0.) ? pydiff / pxdiff : 0.;
+	if (hatch_edges_init(polygon, numpoints, FALSE, pxmin, -slope))
+		goto FILL_EXIT;
 	for (i = 0; i <= numlines; i++) {	/* for all scanlines ... */
 		k = -1;
 		scany1 = pymin + (double) i *penwidth;
@@ -129,6 +280,7 @@ return;
 		}
 		if (scany2 < polyymin)
 			continue;
+		hatch_edges_active(scany1, 1.e-3 * (1. + fabs(slope)));
 /* coefficients for current scan line */
 		bx = pxmin;
 		btx = pxmax;
@@ -137,7 +289,8 @@ return;
 		bvx = btx - bx;
 		bvy = bty - by;
 
-		for (j = 0; j <= numpoints; j = j + 2) {	/*for all polygon edges */
+		for (a = 0; a < n_active; a++) {	/*for all edges crossing */
+			j = hatch_edge[hatch_active[a]].j;
 			ax = polygon[j].x;
 			ay = polygon[j].y;
 			atx = polygon[j + 1].x;
@@ -175,31 +328,13 @@ return;
 				    (double) polygon[j + 1].x))) {
 /*fprintf(stderr,"intersection  at %f %f is not within (%f,%f)-(%f,%f)\n",segx,segy,polygon[j].x,polygon[j].y,polygon[j+1].x,polygon[j+1].y ) ; */
 			} else {
-				for (kk = 0; kk <= k; kk++) {
-					if (fabs(segment[kk].x - segx) <
-					    1.e-8)
-						goto BARF;
-				}
 				k++;
 				segment[k].x = segx;
 				segment[k].y = segy;
-
 /*fprintf(stderr,"fill: intersection %d with line %d at (%f %f)\n",k,j,segx,segy);*/
-				if (k > 0) {
-					for (jj = 0; jj < k; jj++) {
-						if (segment[k].x <
-						    segment[jj].x) {
-							tmp = segment[jj];
-							segment[jj] =
-							    segment[k];
-							segment[k] = tmp;
-						}
-					}
-				}	/* if not the first intersection */
 			}	/* if crossing withing range */
-		      BARF:
-			continue;
 		}		/*next edge */
+		k = hatch_sort(k, FALSE);
 
 		if (k > 0) {
 /*fprintf(stderr, "%d segments for scanline %d\n",k,i);*/
@@ -282,11 +417,15 @@ return;
 	pxdiff = 0.;
 	if (hatchangle != 0.)
 		pxdiff = tan(M_PI * hatchangle / 180.) * (pymax - pymin);
+	slope = pxdiff / (pymax - pymin);
+	if (hatch_edges_init(polygon, numpoints, TRUE, pymin, slope))
+		goto FILL_EXIT;
 	for (i = 0; i <= numlines; ++i) {	/* for all scanlines ... */
 		k = -1;
 		scanx1 = pxmin + (double) i *penwidth;
 		if (scanx1 >= pxmax || scanx1 <= pxmin)
 			continue;
+		hatch_edges_active(scanx1, 1.001 * (1. + fabs(slope)));
 		scanx2 = scanx1 - pxdiff;
 /*		if (scanx2 < polyxmin)
 			continue;*/
@@ -298,7 +437,8 @@ return;
 		bvx = btx - bx;
 		bvy = bty - by;
 
-		for (j = 0; j <= numpoints; j = j + 2) {	/*for all polygon edges */
+		for (a = 0; a < n_active; a++) {	/*for all edges crossing */
+			j = hatch_edge[hatch_active[a]].j;
 			ax = polygon[j].x;
 			ay = polygon[j].y;
 			atx = polygon[j + 1].x;
@@ -339,31 +479,13 @@ return;
 				MAX(polygon[j].x, polygon[j + 1].x))) {
 /*fprintf(stderr,"intersection  at %f %f is not within (%f,%f)-(%f,%f)\n",segx,segy,polygon[j].x,polygon[j].y,polygon[j+1].x,polygon[j+1].y ) ; */
 			} else {
-				for (kk = 0; kk <= k; kk++) {
-					if (fabs(segment[kk].y - segy) <
-					    1.e-8)
-						goto BARF2;
-				}
 				k++;
 				segment[k].x = segx;
 				segment[k].y = segy;
-
 /*fprintf(stderr,"fill: intersection %d with line %d at (%f %f)\n",k,j,segx,segy);*/
-				if (k > 0) {
-					for (jj = 0; jj < k; jj++) {
-						if (segment[k].y <
-						    segment[jj].y) {
-							tmp = segment[jj];
-							segment[jj] =
-							    segment[k];
-							segment[k] = tmp;
-						}
-					}
-				}	/* if not the first intersection */
 			}	/* if crossing withing range */
-		      BARF2:
-			continue;
 		}		/*next edge */
+		k = hatch_sort(k, TRUE);
 
 
 		if (k > 0) {
@@ -392,6 +514,7 @@ return;
 		}
 
 	}			/* next scanline */
+      FILL_EXIT:
 	CurrentLineEnd = SafeLineEnd;
 	PlotCmd_to_tmpfile(DEF_PW);
 	Pen_Width_to_tmpfile(1, SafePenW);
@@ -149,6 +149,15 @@ copies.
  **			   constant, user-defined Z depths (Michael Rooke)
  ** 03/02/26	      GV   Add -S option for DXF mode (pen attribute mapping)
  ** 12/11/17	Test for Windows7. See http://sourceforge.net/p/gnuwin32/discussion/74807/thread/903411c4/
+ ** 26/10/19		   New mode "tiles", a PNG tile pyramid for zoomable viewers
+ ** 26/10/19		   Option -k: crop to the preset range, using the temp. file index
+ ** 26/10/19		   Option -A: anti-aliased rasterization
+ ** 26/10/19		   Options -G, -g: polyline simplification
+ ** 26/10/19		   Option -T: labels as vectors in all modes
+ ** 26/10/19		   Option -R: profile of the HP-GL commands
+ ** 26/10/19		   Options -L, -U, -E, -j: PNG compression
+ ** 26/10/19		   Multi-page TIFF, -S 9; -j now --threads
+ ** 26/10/19		   New modes "pgm" and "pam"
  **/
 
 #include <stdio.h>
@@ -159,6 +168,7 @@ copies.
 #include "pendef.h"
 #include "hp2xx.h"
 #include "hpgl.h"
+#include "tmpindex.h"
 
 /* the version string is now declared in hp2xx.h, so that output modules
    may easily include the version of hp2xx that generated the file */
@@ -199,6 +209,7 @@ mode_list ModeList[] = {
 #endif
 	{XX_MF, "mf"},		/* Metafont source output               */
 	{XX_NC, "nc"},		/* G code for CNC milling               */
+	{XX_PAM, "pam"},	/* Portable Arbitrary Map (netpbm)      */
 	{XX_PBM, "pbm"},	/* Portable Bitmap                      */
 	{XX_PCL, "pcl"},	/* HP-PCL Level 5 printer code          */
 	{XX_PCX, "pcx"},	/* Paintbrush's PCX raster format       */
@@ -209,6 +220,7 @@ mode_list ModeList[] = {
 #ifdef USEPDF
 	{XX_PDF, "pdf"},	/* Portable Document Format       */
 #endif
+	{XX_PGM, "pgm"},	/* Portable Graymap                     */
 #ifdef PNG
 	{XX_PNG, "png"},	/* Portable Network Graphics            */
 #endif
@@ -217,6 +229,9 @@ mode_list ModeList[] = {
 	{XX_SVG, "svg"},	/* W3C Scalable vector graphics         */
 #ifdef TIF
 	{XX_TIFF, "tiff"},	/* Tagged image file format            */
+#endif
+#ifdef PNG
+	{XX_TILES, "tiles"},	/* Pyramid of PNG tiles (web maps)      */
 #endif
 	{XX_TERM, ""}		/* Dummy: List terminator               */
 };
@@ -314,6 +329,13 @@ void usage_msg(const GEN_PAR * pg, const IN_PAR * pi, const OUT_PAR * po)
 		pi->first_page, pi->last_page);
 	Eprintf("-q        %s\t\tQuiet mode (no diagnostics)\n",
 		FLAGSTATE(pg->quiet));
+	Eprintf("-G        %s\t\tSimplify polylines within the output resolution\n",
+		FLAGSTATE(pg->simplify));
+	Eprintf("-g float  -\t\tSimplify polylines within float [mm] (0: collinear only)\n");
+	Eprintf("-T        %s\t\tLabels as vectors, not text (eps, pdf, svg)\n",
+		FLAGSTATE(pg->stroke_text));
+	Eprintf("-R[json]  %s\t\tProfile of the HP-GL commands read (table or JSON)\n",
+		FLAGSTATE(pg->profile));
 	Eprintf
 	    ("-r float%5.1f\t\tRotation angle [deg]. -r90 = landscape\n",
 	     pi->rotation);
@@ -325,6 +347,8 @@ void usage_msg(const GEN_PAR * pg, const IN_PAR * pi, const OUT_PAR * po)
 	Eprintf("-D int    %d\t\tDPI value for y ONLY\n", po->dpi_x);
 	/* x, not y! */
 	Eprintf("-e int    %d\t\tExtra clipping space\n", pg->extraclip);
+	Eprintf("-A        %s\t\tAnti-aliased lines (png, tiles, jpg, tiff, pbm, pgm, pam)\n",
+		FLAGSTATE(pg->antialias));
 
 	Eprintf("\nPCL-exclusive options:\n");
 	Eprintf("-i         %s\tPre-initialize printer\n",
@@ -347,9 +371,20 @@ void usage_msg(const GEN_PAR * pg, const IN_PAR * pi, const OUT_PAR * po)
 
 	Eprintf("\nTiff-exclusive options:\n");
 	Eprintf
-	    ("-S int     %d\tUse Tiff Compression Format (0/1=None, 2=RLE, 3=G3Fax, 4=G4Fax, 5=LZW, 6=OJpeg, 7=Jpeg, 8=Deflate)\n",
+	    ("-S int     %d\tUse Tiff Compression Format (0/1=None, 2=RLE, 3=G3Fax, 4=G4Fax, 5=LZW, 6=OJpeg, 7=Jpeg, 8=Deflate, 9=G4 if mono, else LZW)\n",
 	     po->specials);
 
+	Eprintf("\nPNG-exclusive options:\n");
+	Eprintf
+	    ("-L int     %d\tCompression level, also PDF (0 = none ... 9 = best)\n",
+	     po->png_level);
+	Eprintf
+	    ("-U strg   default\tCompression strategy (default, filtered, huffman, rle, fixed)\n");
+	Eprintf
+	    ("-E strg   auto\tRow filters: auto, all or a list of none,sub,up,avg,paeth\n");
+	Eprintf("-j int     %d\tCompression threads, also TIFF (0 = one per CPU)\n",
+		po->threads);
+
 	NormalWait();
 
 	Eprintf("\nDXF-exclusive options:\n");
@@ -375,6 +410,8 @@ void usage_msg(const GEN_PAR * pg, const IN_PAR * pi, const OUT_PAR * po)
 	Eprintf("-X float   -\tManual HPGL-coord range presetting: x1\n");
 	Eprintf("-y float   -\tManual HPGL-coord range presetting: y0\n");
 	Eprintf("-Y float   -\tManual HPGL-coord range presetting: y1\n");
+	Eprintf("-k         %s\tCrop picture to the range preset by -x -X -y -Y\n",
+		FLAGSTATE(pi->crop));
 	Eprintf("-z float %5.1f\t(3d nc output only) Z engage depth\n",
 		po->zengage);
 	Eprintf("-Z float %5.1f\t(3d nc output only) Z retract depth\n",
@@ -392,15 +429,18 @@ void usage_msg(const GEN_PAR * pg, const IN_PAR * pi, const OUT_PAR * po)
 	Eprintf
 	    ("hp2xx   [--mode] [--colors] [--pensizes] [--pages] [--quiet]\n");
 	Eprintf
-	    ("\t[--nofill] [--no_ps] [--mapzero]\n");
+	    ("\t[--nofill] [--no_ps] [--mapzero] [--simplify] [--simplify_tol]\n");
+	Eprintf("\t[--stroke_text] [--profile]\n");
 	Eprintf
 	    ("\t[--width] [--height] [--aspectfactor] [--truesize]\n");
-	Eprintf("\t[--x0] [--x1] [--y0] [--y1]\n");
+	Eprintf("\t[--x0] [--x1] [--y0] [--y1] [--crop]\n");
 	Eprintf("\t[--xoffset] [--yoffset] [--center]\n");
-	Eprintf("\t[--DPI] [--DPI_x] [--DPI_y] [--extraclip]\n");
+	Eprintf("\t[--DPI] [--DPI_x] [--DPI_y] [--extraclip] [--antialias]\n");
 	Eprintf("\t[--outfile] [--logfile] [--swapfile]\n");
 	Eprintf
 	    ("\t[--PCL_formfeed] [--PCL_init] [--PCL_Deskjet] [--PCL_PCL3GUI]\n");
+	Eprintf
+	    ("\t[--png_level] [--png_strategy] [--png_filter] [--threads]\n");
 #ifdef DOS
 	Eprintf("\t[--VGAmodebyte]");
 #endif
@@ -445,6 +485,7 @@ void preset_par(GEN_PAR * pg, IN_PAR * pi, OUT_PAR * po)
 	pi->xoff = 0.0;
 	pi->yoff = 0.0;
 	pi->truesize = FALSE;
+	pi->crop = FALSE;
 	pi->hwcolor = FALSE;
 	pi->hwsize = FALSE;
 	pi->rotation = 0.0;
@@ -460,6 +501,10 @@ void preset_par(GEN_PAR * pg, IN_PAR * pi, OUT_PAR * po)
 	po->init_p3gui = FALSE;
 	po->formfeed = FALSE;
 	po->specials = 0;
+	po->png_level = 9;	/* Z_BEST_COMPRESSION   */
+	po->png_strategy = 0;	/* Z_DEFAULT_STRATEGY   */
+	po->png_filter = 0;	/* Chosen by bit depth  */
+	po->threads = 1;
 	po->dpi_x = 75;
 	po->dpi_y = 0;
 	po->vga_mode = 18;	/* 0x12: VGA 640x480, 16 colors */
@@ -475,12 +520,19 @@ void preset_par(GEN_PAR * pg, IN_PAR * pi, OUT_PAR * po)
 	pg->xx_mode = XX_PRE;
 	pg->nofill = FALSE;
 	pg->no_ps = FALSE;
+	pg->antialias = FALSE;
 	pg->quiet = FALSE;
 	pg->extraclip = 0;
 	pg->maxpensize = 0.1;	/* 1/10 mm              */
+	pg->chord_tol = 0.1;	/* Refined to dpi in std_main.c */
+	pg->simplify = FALSE;
+	pg->simplify_tol = -1.0;	/* Tolerance of the output mode */
+	pg->stroke_text = FALSE;
+	pg->profile = 0;
 	pg->maxcolor = 1;	/* max. color index             */
 	pg->maxpens = 8;
 	pg->is_color = FALSE;
+	pg->direct_color = FALSE;
 	pg->mapzero = -1;
 	pg->td_file[0] = '\0';
 
@@ -610,6 +662,7 @@ void cleanup_g(GEN_PAR * pg)
 			//pg->td_file = NULL;
 			pg->td_file[0] = '\0';
 		}
+		free_TmpIndex();
 	}
 }
 
@@ -813,6 +866,11 @@ int TMP_to_VEC(const GEN_PAR * pg, const OUT_PAR * po)
 		to_mftex(pg, po, 9);
 		return 0;
 
+#ifdef PNG
+	case XX_TILES:		/* Rasterizes on its own, tile by tile */
+		return to_tiles(pg, po);
+#endif
+
 	default:
 		return 1;
 	}
@@ -840,6 +898,7 @@ int TMP_to_VEC(const GEN_PAR * pg, const OUT_PAR * po)
 
 int TMP_to_BUF(const GEN_PAR * pg, OUT_PAR * po)
 {
+	OUT_PAR lpo;
 	int n_rows, n_cols;
 
 	if (pg->td == NULL)
@@ -863,11 +922,27 @@ int TMP_to_BUF(const GEN_PAR * pg, OUT_PAR * po)
 		return ERROR;
 	}
 
+/**
+ ** Cropping: As in tiles mode, dots count from the lower left of the
+ ** uncropped picture, and the buffer holds a section of it. So the
+ ** crop shows exactly the dots of the uncropped picture (of the same
+ ** scale) there, wide lines and their joins included.
+ **/
+	lpo = *po;
+	if (TmpIndex_windowed()) {
+		lpo.xmin = po->pic_xmin;
+		lpo.ymin = po->pic_ymin;
+		window_PicBuf((int) ((po->xmin - po->pic_xmin) *
+				     po->HP_to_xdots),
+			      (int) ((po->ymin - po->pic_ymin) *
+				     po->HP_to_ydots));
+	}
+
 /**
  ** Read vectors from temporary file and plot them in memory buffer
  **/
 
-	tmpfile_to_PicBuf(pg, po);
+	tmpfile_to_PicBuf(pg, &lpo);
 
 	return 0;
 }
@@ -919,6 +994,8 @@ int BUF_to_RAS(const GEN_PAR * pg, OUT_PAR * po)
 		return PicBuf_to_JPG(pg, po);
 #endif
 	case XX_PBM:		/* Portable BitMap fmt  */
+	case XX_PGM:		/* Portable GrayMap     */
+	case XX_PAM:		/* Portable Arb. Map    */
 		return PicBuf_to_PBM(pg, po);
 #ifdef PNG
 	case XX_PNG:		/* Portable Network fmt */
@@ -147,8 +147,6 @@ copies.
 
 #define	MAX_LB_LEN	150	/* Max num of chars per label   */
 
-#define MAXPOLY 20480		/* Size of polygon vertex buffer */
-
 #ifndef VOID
 #ifdef	__STDC__
 #define	VOID	void
@@ -187,9 +185,9 @@ typedef enum {
 	XX_CAD, XX_CS, XX_DXF, XX_EM, XX_EMF, XX_EMP, XX_EPIC, XX_EPS,
 	    XX_ESC2, XX_FIG, XX_GPT, XX_HPGL,
 	XX_ILBM, XX_IMG, XX_JPG,
-	XX_MF, XX_NC, XX_PBM, XX_PCL, XX_PCX, XX_PAC, XX_PDF, XX_PIC,
-	    XX_PNG, XX_PRE,
-	XX_RGIP, XX_SVG, XX_TIFF, XX_TERM	/* Dummy: terminator    */
+	XX_MF, XX_NC, XX_PAM, XX_PBM, XX_PCL, XX_PCX, XX_PAC, XX_PDF,
+	    XX_PGM, XX_PIC, XX_PNG, XX_PRE,
+	XX_RGIP, XX_SVG, XX_TIFF, XX_TILES, XX_TERM	/* Dummy: terminator    */
 } hp2xx_mode;
 
 
@@ -211,7 +209,7 @@ typedef struct Row {
 
 typedef struct {
 	int nr, nc, nb;		/* Number of rows / columns / bytes per row     */
-	int depth;		/* Depth: Number of bit planes (1 to 4)         */
+	int depth;		/* Depth: Number of bit planes (1, 4, 8, 32)    */
 	RowBuf *row;		/* Array pointer of all rows                    */
 	char *sf_name;		/* Swapfile name                                */
 	FILE *sd;		/* Swapfile pointer                             */
@@ -223,9 +221,47 @@ typedef struct {
 } HPGL_Pt;
 
 
+/**
+ ** Polygon edges as point pairs. The buffer grows as needed and keeps
+ ** its memory for the next polygon.
+ **/
+typedef struct {
+	HPGL_Pt *pt;
+	int last;		/* Index of last point, -1 if empty */
+	int size;		/* Number of points allocated       */
+} PolyBuf;
+
+
+/**
+ ** Circular arc of an ARC record. It starts at the current point.
+ **/
+typedef struct {
+	HPGL_Pt center;
+	HPGL_Pt end;
+	float sweep;		/* [rad], counter-clockwise if > 0  */
+} HPGL_Arc;
+
+
+/**
+ ** Label of a TEXT record; its characters follow it. Char. i is drawn
+ ** at (i * adv, 0) in char. cell units, which map to plotter units by
+ **   x' = m[0] x + m[2] y + org.x,  y' = m[1] x + m[3] y + org.y .
+ ** The cell of the stick font is 4 units wide, caps are 6 units high.
+ **/
+typedef struct {
+	HPGL_Pt org;
+	float m[4];
+	float adv;		/* Char. advance [cell units]       */
+	int font;		/* Stick font number                */
+	int n;			/* Number of characters             */
+} HPGL_Text;
+
+#define	TEXT_EM	10.5	/* Font size giving Courier caps of 6 units */
+
+
 typedef enum {
 	NOP, MOVE_TO, DRAW_TO, PLOT_AT, SET_PEN, DEF_PW, DEF_PC, DEF_LA,
-	    CMD_EOF
+	    FILL_POLY, ARC, CUBIC, DEF_LT, TEXT, CMD_EOF
 } PlotCmd;
 
 
@@ -248,6 +284,7 @@ typedef struct {		/* Corresponding option(s)        */
 	double aspectfactor;	/* -a aspectfactor              */
 	double rotation;	/* -r rotation                  */
 	double x0, x1, y0, y1;	/* -x x0 -X x1 -y y0 -Y y1      */
+	int crop;		/* -k                           */
 	double xoff, yoff;	/* -o xoff  -O yoff             */
 	HPGL_Pt hwlimit;	/* -W p2.x -H p2.y		*/
 	char *in_file;		/* Input file name ("-" = stdin) */
@@ -268,9 +305,14 @@ typedef struct {		/* Corresponding option(s)        */
 	int init_p3gui;		/* -I  (PCL only)               */
 	int formfeed;		/* -F  (PCL only)               */
 	int specials;		/* -s specials  (PCL only)      */
+	int png_level;		/* -L  (PNG, PDF)               */
+	int png_strategy;	/* -U  (PNG only)               */
+	int png_filter;		/* -E  (PNG only)               */
+	int threads;		/* -j  (PNG, TIFF)              */
 	int pagecount;		/* for naming multi-page output */
 	char *outfile;		/* -f outfile ("-" = stdout)    */
 	double xmin, ymin, xmax, ymax;	/* (internally needed)          */
+	double pic_xmin, pic_ymin;	/* Before cropping (-k)         */
 	double xoff, yoff;	/* Internal copies from IN_PAR  */
 	double width, height;	/* Internal copies from IN_PAR  */
 	double HP_to_xdots;	/* (internally needed)          */
@@ -292,9 +334,16 @@ typedef struct {		/* Corresponding option(s)        */
 	int quiet;		/* -q                           */
 	int nofill;		/* -n                           */
 	int no_ps;		/* -N                           */
+	int antialias;		/* -A                           */
 	int extraclip;		/* -e extraclip                 */
 	PEN_W maxpensize;	/* (internally needed)          */
+	double chord_tol;	/* Max. arc chord error [mm]    */
+	int simplify;		/* -G, -g                       */
+	double simplify_tol;	/* -g tol [mm], < 0: from dpi   */
+	int stroke_text;	/* -T                           */
+	int profile;		/* -R: 0 off, 1 table, 2 JSON   */
 	int is_color;		/* (internally needed)          */
+	int direct_color;	/* (internally needed)          */
 	int maxcolor;		/* (internally needed)          */
 	FILE *td;		/* (internally needed)          */
 	hp2xx_mode xx_mode;	/* (internally needed)          */
@@ -360,7 +409,14 @@ void read_HPGL(GEN_PAR *, const IN_PAR *);
 void adjust_input_transform(const GEN_PAR *, const IN_PAR *, OUT_PAR *);
 PlotCmd PlotCmd_from_tmpfile(void);
 void HPGL_Pt_from_tmpfile(HPGL_Pt *);
+int Polygon_from_tmpfile(HPGL_Pt **);
+void Arc_from_tmpfile(HPGL_Arc *);
+void Cubic_from_tmpfile(HPGL_Pt *);
+char *Text_from_tmpfile(HPGL_Text *);
 void Pen_action_to_tmpfile(PlotCmd, const HPGL_Pt *, int);
+void Polyline_to_tmpfile(const HPGL_Pt *, const char *, int);
+int Polygon_to_tmpfile(const HPGL_Pt *, int, int);
+int Text_to_tmpfile(const HPGL_Text *, const char *, const HPGL_Pt *);
 /*int read_float(float *, FILE *);*/
 double ceil_with_tolerance(double, double);
 void line(int relative, HPGL_Pt p);
@@ -380,17 +436,25 @@ void size_PicBuf(const GEN_PAR *, const OUT_PAR *, int *, int *);
 PicBuf *allocate_PicBuf(const GEN_PAR *, int, int);
 void free_PicBuf(PicBuf *);
 void tmpfile_to_PicBuf(const GEN_PAR *, const OUT_PAR *);
+void cmds_to_PicBuf(const GEN_PAR *, const OUT_PAR *, const HPGL_Pt *, int,
+		    int, long);
+void window_PicBuf(int, int);
 int index_from_PicBuf(const PicBuf *, const DevPt *);
 int index_from_RowBuf(const RowBuf *, int, const PicBuf *);
+void RowBuf_to_RGB(const RowBuf *, const PicBuf *, Byte *);
 RowBuf *get_RowBuf(const PicBuf *, int);
 
 int PicBuf_to_PCL(const GEN_PAR *, const OUT_PAR *);
 int PicBuf_to_PCX(const GEN_PAR *, const OUT_PAR *);
 int PicBuf_to_PNG(const GEN_PAR *, const OUT_PAR *);
+#ifdef PNG
+int to_tiles(const GEN_PAR *, const OUT_PAR *);
+#endif
 #ifdef JPG
 int PicBuf_to_JPG(const GEN_PAR *, const OUT_PAR *);
 #endif
 int PicBuf_to_TIF(const GEN_PAR *, const OUT_PAR *);
+void TIF_close(const GEN_PAR *);
 int PicBuf_to_IMG(const GEN_PAR *, const OUT_PAR *);
 int PicBuf_to_PBM(const GEN_PAR *, const OUT_PAR *);
 int PicBuf_to_ILBM(const GEN_PAR *, const OUT_PAR *);
@@ -399,6 +463,7 @@ int PicBuf_to_ESCP2(const GEN_PAR *, const OUT_PAR *);
 #endif
 #ifdef USEPDF
 int to_pdf(const GEN_PAR *, const OUT_PAR *);
+void pdf_close(const GEN_PAR *);
 #endif
 
 #ifdef PIC_PAC
@@ -426,6 +491,7 @@ int to_emp(const GEN_PAR * pg, const OUT_PAR * po);
 
 void fill(HPGL_Pt polygon[], int numpoints, HPGL_Pt P1, HPGL_Pt P2,
 	  int scale_flag, int filltype, float spacing, float hatchangle);
+void PolyBuf_add(PolyBuf *, HPGL_Pt);
 
 /*std_main*/
 void action_oldstyle(GEN_PAR *, IN_PAR *, OUT_PAR *);
@@ -99,6 +99,20 @@
  **			   from reset_HPGL to init_HPGL so that they are not overwritten
  **			   when a single drawing contains several IN statements
  ** 02/06/02	      AJB  Moved HYPOT macro to hpgl.h - so we can use it in murphy.c
+ ** 26/10/19		   temp. file commands feed the spatial index (tmpindex.c);
+ **			   optional crop to the -x -X -y -Y range (-k)
+ ** 26/10/19		   PC: detect pens recolored after drawing (direct color)
+ ** 26/10/19		   Solid fills kept as FILL_POLY records where the
+ **			   output mode can fill polygons itself
+ ** 26/10/19		   Polygon buffer grows as needed (was MAXPOLY points)
+ ** 26/10/19		   Arcs & circles: chord angle from the output resolution
+ ** 26/10/19		   ARC and CUBIC records for modes drawing curves natively
+ ** 26/10/19		   Fixed line types as DEF_LT records (dash patterns)
+ **			   for modes stroking them natively
+ ** 26/10/19		   Optional polyline simplification (-G, -g)
+ ** 26/10/19		   Labels as TEXT records for modes writing text (-T: off)
+ ** 26/10/19		   Profile of count, input, output & CPU time per command (-R)
+ ** 26/10/19		   Arcs & -G/-g: output scale from the crop window (-k)
  **/
 
 #include <stdio.h>
@@ -111,6 +125,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <time.h>
 #include "bresnham.h"
 #include "hp2xx.h"
 #include "chardraw.h"
@@ -118,6 +133,7 @@
 #include "pendef.h"
 #include "lindef.h"
 #include "hpgl.h"
+#include "tmpindex.h"
 
 #define	ETX		'\003'
 
@@ -136,6 +152,11 @@
 #define P2X_default   33600.	/* A0 media */
 #define P2Y_default   47520.
 
+#define	VEC_CHORD_TOL	0.01	/* Max. arc chord error of vector modes [mm] */
+#define	MAX_CHORD_ANGLE	(M_PI / 4.0)	/* Coarsest arc step: 45 deg    */
+#define	MIN_CHORD_ANGLE	(M_PI / 18000.0)	/* Finest arc step: 0.01 deg */
+#define	SIMPLIFY_WINDOW	64	/* Max. vertices dropped in a row       */
+#define	SIMPLIFY_EPS	0.01	/* Float rounding [plotter units]       */
 
 #ifdef NORINT
 #define rint(a) (long)(a+0.5)
@@ -147,6 +168,7 @@
 LineType CurrentLineType = LT_solid;
 short scale_flag = FALSE;
 short record_off = FALSE;
+short native_text = FALSE;	/* Mode writes TEXT records     */
 long vec_cntr_w = 0L;
 long n_commands = 0L;
 short silent_mode = FALSE;
@@ -175,8 +197,23 @@ static float xmin, xmax, ymin, ymax, neg_ticklen, pos_ticklen;
 static double Diag_P1_P2, pat_pos;
 static HPGL_Pt p_last = { M_PI, M_PI };	/* Init. to "impossible" values */
 
-static HPGL_Pt polygons[MAXPOLY];
-static int vertices = -1;
+static PolyBuf polygons = { NULL, -1, 0 };
+static short native_fills = FALSE;	/* Mode renders FILL_POLY records */
+static short native_curves = FALSE;	/* Mode renders ARC & CUBIC records */
+static short native_dashes = FALSE;	/* Mode strokes DEF_LT patterns */
+static LineDash dash_last;	/* Pattern last written as DEF_LT       */
+static double out_aspect = 1.0;	/* Copy of -a: arcs stay circular if 1 */
+static double arc_tol_mm = VEC_CHORD_TOL;	/* Max. chord error [mm]   */
+static short out_truesize = FALSE;	/* Copies from IN_PAR for arcs  */
+static double out_width = 200.0, out_height = 200.0;
+static double crop_x0 = 1e10, crop_x1 = -1e10;	/* Sides fixed by -k */
+static double crop_y0 = 1e10, crop_y1 = -1e10;
+static double simplify_mm = -1.0;	/* Vertex tolerance [mm], < 0: off */
+static HPGL_Pt sv_anchor, sv_buf[SIMPLIFY_WINDOW];	/* Held back run  */
+static int sv_n = 0;
+static long sv_in, sv_out;	/* Vertices seen / dropped by -G, -g    */
+static HPGL_Pt *poly_buf = NULL;	/* Polygon read from temp. file */
+static int poly_buf_size = 0;
 static short polygon_mode = FALSE;
 static int filltype = 1;
 static float hatchspace = 0.;
@@ -195,6 +232,7 @@ static short ac_flag = FALSE;
 static double rot_ang = 0.;
 static double rot_tmp = 0.;	/* saved RO value for resetting after drawing */
 static short mv_flag = FALSE;
+static HPGL_Pt P_last;		/* Last pen position in the temp. file  */
 static short pg_flag = FALSE;
 static short ct_dist = FALSE;
 static short fixedcolor = FALSE;
@@ -203,10 +241,22 @@ static int first_page = 0;
 static int last_page = 0;
 static int n_unexpected = 0;
 static int n_unknown = 0;
+
+typedef struct {		/* Profile of an HP-GL mnemonic (-R)    */
+	int cmd;		/* Mnemonic, upper case                 */
+	long calls;
+	long bytes;		/* Input bytes, -1 if not seekable      */
+	long vectors;		/* Internal commands written            */
+	double cpu;		/* CPU time [s]                         */
+} CmdProfile;
+
+static CmdProfile *cmd_prof = NULL;	/* 26 x 26 mnemonics, NULL: off */
 static int page_number = 1;
 static long vec_cntr_r = 0L;
 static short pen = -1;
 static short pens_in_use[NUMPENS];
+static short pens_drawn[NUMPENS];	/* Pen drew since its last PC   */
+static long pen_rgb[NUMPENS];	/* Last PC color of pen, -1 = none      */
 static short pen_down = FALSE;	/* Internal HP-GL book-keeping: */
 static short plot_rel = FALSE;
 static short saved_penstate = FALSE;	/* to track penstate over polygon mode */
@@ -347,6 +397,114 @@ static void par_err_exit(int code, int cmd, FILE * hd)
 
 
 
+static double out_mm(double x0, double y0, double x1, double y1)
+/**
+ ** Millimeters per plotter unit of the output, for a picture range of
+ ** (at least) x0..x1 by y0..y1 plotter units. Sides of the crop window
+ ** (-k) are the final ones already. Exact with -t only.
+ **/
+{
+	if (out_truesize)
+		return 0.025;
+	if (crop_x0 < 1e10)
+		x0 = crop_x0;
+	if (crop_x1 > -1e10)
+		x1 = crop_x1;
+	if (crop_y0 < 1e10)
+		y0 = crop_y0;
+	if (crop_y1 > -1e10)
+		y1 = crop_y1;
+	return MIN(out_width / MAX(x1 - x0, 1.0),
+		   out_height / MAX(y1 - y0, 1.0));
+}
+
+
+
+static double seg_dist2(const HPGL_Pt * p, const HPGL_Pt * a,
+			const HPGL_Pt * b)
+/**
+ ** Squared distance of *p from the line segment *a - *b
+ **/
+{
+	double dx, dy, ex, ey, l2, t;
+
+	dx = b->x - a->x;
+	dy = b->y - a->y;
+	ex = p->x - a->x;
+	ey = p->y - a->y;
+	if ((l2 = dx * dx + dy * dy) > 0.0) {
+		t = (ex * dx + ey * dy) / l2;
+		t = MAX(0.0, MIN(1.0, t));
+		ex -= t * dx;
+		ey -= t * dy;
+	}
+	return ex * ex + ey * ey;
+}
+
+
+
+static void flush_vertices(void)
+/**
+ ** Write the vertex held back by Vertex_to_tmpfile(), if any
+ **/
+{
+	HPGL_Pt p;
+
+	if (sv_n == 0)
+		return;
+	p = sv_buf[sv_n - 1];
+	sv_n = 0;		/* PlotCmd_to_tmpfile() calls us, too */
+	PlotCmd_to_tmpfile(DRAW_TO);
+	HPGL_Pt_to_tmpfile(&p);
+}
+
+
+
+static void Vertex_to_tmpfile(const HPGL_Pt * pa, const HPGL_Pt * pb)
+/**
+ ** Solid vector from *pa (the pen position) to *pb. With -G or -g,
+ ** the vertex *pb is held back as long as the next one may replace
+ ** it, i.e. as long as all vertices held back since the last one
+ ** written stay within the tolerance of the single vector from there.
+ ** Duplicate and collinear vertices go first. Any other temp. file
+ ** command writes the vertex held back. SIMPLIFY_WINDOW bounds the
+ ** work per vertex.
+ **/
+{
+	double tol;
+	int i;
+
+	if (simplify_mm < 0.0) {
+		PlotCmd_to_tmpfile(DRAW_TO);
+		HPGL_Pt_to_tmpfile(pb);
+		return;
+	}
+	if (record_off)		/* Wrong page!  */
+		return;
+
+	sv_in++;
+	if (sv_n > 0 && sv_n < SIMPLIFY_WINDOW) {
+		tol = MAX(simplify_mm / out_mm(MIN(xmin, pb->x),
+					       MIN(ymin, pb->y),
+					       MAX(xmax, pb->x),
+					       MAX(ymax, pb->y)), SIMPLIFY_EPS);
+		for (i = 0; i < sv_n; i++)
+			if (seg_dist2(&sv_buf[i], &sv_anchor, pb) > tol * tol)
+				break;
+		if (i == sv_n) {
+			sv_buf[sv_n++] = *pb;
+			sv_out++;
+			return;
+		}
+	}
+	flush_vertices();
+	sv_anchor = *pa;
+	sv_buf[0] = *pb;
+	sv_n = 1;
+}
+
+
+
 static void reset_HPGL(void)
 {
 	int i;
@@ -430,6 +588,7 @@ static void reset_HPGL(void)
 	if (fixedwidth == FALSE)
 		for (i = 0; i < 8; i++)
 			pt.width[i] = 0.1;
+	flush_vertices();
 	record_off = (first_page > page_number)
 	    || ((last_page < page_number) && (last_page > 0));
 }
@@ -439,6 +598,8 @@ static void init_HPGL(GEN_PAR * pg, const IN_PAR * pi)
 /**
  ** Re-init. global var's for multiple-file applications
  **/
+	int i;
+
 /*fprintf(stderr,"init_HPGL\n");*/
 	td = pg->td;
 	silent_mode = (short) pg->quiet;
@@ -455,6 +616,10 @@ static void init_HPGL(GEN_PAR * pg, const IN_PAR * pi)
 	pg->maxpens = 8;
 	pg->maxcolor = 1;
 	memset(pens_in_use, 0, NUMPENS * sizeof(short));
+	memset(pens_drawn, 0, NUMPENS * sizeof(short));
+	for (i = 0; i < NUMPENS; i++)
+		pen_rgb[i] = -1L;
+	pg->direct_color = FALSE;
   /**
    ** Record ON if no page selected (pg->page == 0)!
    **/
@@ -514,8 +679,11 @@ void PlotCmd_to_tmpfile(PlotCmd cmd)
 	if (record_off)		/* Wrong page!  */
 		return;
 
+	if (sv_n > 0)		/* Vertex held back goes first  */
+		flush_vertices();
+
 	if (!silent_mode)
-		switch (vec_cntr_w++) {
+		switch (vec_cntr_w) {
 		case 0:
 			Eprintf("Writing Cmd: ");
 			break;
@@ -592,7 +760,13 @@ void PlotCmd_to_tmpfile(PlotCmd cmd)
 			Eprintf("10000k ");
 			break;
 		}
+	vec_cntr_w++;		/* Counted in quiet mode, too   */
+
+	if (cmd == DRAW_TO || cmd == PLOT_AT || cmd == FILL_POLY
+	    || cmd == ARC || cmd == CUBIC || cmd == TEXT)
+		pens_drawn[(pen < 0) ? 1 : pen] = TRUE;
 
+	cmd_to_TmpIndex(cmd, td);
 	if (fputc((int) cmd, td) == EOF) {
 		PError("PlotCmd_to_tmpfile");
 		Eprintf("Error @ Cmd %ld\n", vec_cntr_w);
@@ -608,6 +782,7 @@ void HPGL_Pt_to_tmpfile(const HPGL_Pt * pf)
 	if (record_off)		/* Wrong page!  */
 		return;
 
+	pt_to_TmpIndex(pf, td);
 	if (fwrite((VOID *) pf, sizeof(*pf), 1, td) != 1) {
 		PError("HPGL_Pt_to_tmpfile");
 		Eprintf("Error @ Cmd %ld\n", vec_cntr_w);
@@ -620,12 +795,385 @@ void HPGL_Pt_to_tmpfile(const HPGL_Pt * pf)
 }
 
 
+int Polygon_to_tmpfile(const HPGL_Pt * polygon, int numpoints, int scaled)
+/**
+ ** Record a solid fill of the polygon given as a list of edges
+ ** (point pairs, numpoints being the index of the last point).
+ ** Returns ERROR if the output mode needs the fill as hatch lines.
+ **/
+{
+	HPGL_Pt *p;
+	double tmp;
+	int i, n;
+
+	if (!native_fills)
+		return ERROR;
+	if (record_off)		/* Wrong page!  */
+		return 0;
+	if ((n = numpoints + 1) < 2)
+		return 0;
+	if ((p = (HPGL_Pt *) malloc(n * sizeof(HPGL_Pt))) == NULL)
+		return ERROR;
+
+	for (i = 0; i < n; i++) {
+		if (scaled)	/* Rescaling    */
+			User_to_Plotter_coord(&polygon[i], &p[i]);
+		else
+			p[i] = polygon[i];
+		if (rotate_flag) {
+			tmp = rot_cos * p[i].x - rot_sin * p[i].y;
+			p[i].y = rot_sin * p[i].x + rot_cos * p[i].y;
+			p[i].x = tmp;
+		}
+		xmin = MIN(p[i].x, xmin);
+		ymin = MIN(p[i].y, ymin);
+		xmax = MAX(p[i].x, xmax);
+		ymax = MAX(p[i].y, ymax);
+	}
+
+	PlotCmd_to_tmpfile(FILL_POLY);
+	poly_to_TmpIndex(p, n, td);
+	if (fwrite((VOID *) & n, sizeof(n), 1, td) != 1 ||
+	    fwrite((VOID *) p, sizeof(*p), (size_t) n, td) != (size_t) n) {
+		PError("Polygon_to_tmpfile");
+		Eprintf("Error @ Cmd %ld\n", vec_cntr_w);
+		exit(ERROR);
+	}
+	free(p);
+	return 0;
+}
+
+
+
+static void Pen_coord(const HPGL_Pt * p, HPGL_Pt * P)
+/**
+ ** Temp. file coordinates of user point p, as Pen_action_to_tmpfile()
+ ** computes them
+ **/
+{
+	double tmp;
+
+	if (scale_flag)
+		User_to_Plotter_coord(p, P);
+	else
+		*P = *p;
+	if (rotate_flag) {
+		tmp = rot_cos * P->x - rot_sin * P->y;
+		P->y = rot_sin * P->x + rot_cos * P->y;
+		P->x = tmp;
+	}
+}
+
+
+
+static int dash_native(LineDash * pd)
+/**
+ ** Fixed line types go to the temp. file as dash pattern if the mode
+ ** strokes it itself, and -a leaves lengths the same in all directions
+ **/
+{
+	pd->n = 0;
+	return native_dashes && out_aspect == 1.0 && make_line_dash(pd) == 0;
+}
+
+
+
+static void Dash_to_tmpfile(void)
+/**
+ ** Before anything is stroked: write a DEF_LT record if the dash
+ ** pattern to use is not the one last written
+ **/
+{
+	LineDash d;
+
+	if (!native_dashes || record_off)
+		return;
+	dash_native(&d);
+	if (d.n == dash_last.n && (d.n == 0 ||
+				   memcmp(d.len, dash_last.len,
+					  d.n * sizeof(d.len[0])) == 0))
+		return;
+	dash_last = d;
+	PlotCmd_to_tmpfile(DEF_LT);
+	Line_Dash_to_tmpfile(&d);
+}
+
+
+
+static int curves_native(void)
+/**
+ ** Curves may go to the temp. file as such unless single vectors are
+ ** needed: clipping to IW, polygon mode or line patterns the mode
+ ** does not stroke itself
+ **/
+{
+	LineDash d;
+
+	return native_curves && !polygon_mode && !iwflag
+	    && (CurrentLineType == LT_solid || dash_native(&d));
+}
+
+
+
+static void Curve_to_tmpfile(PlotCmd cmd, const VOID * data, size_t size,
+			     const HPGL_Pt * box, const HPGL_Pt * end)
+/**
+ ** Write an ARC or CUBIC record, preceded by a pending move. box holds
+ ** the lower left and upper right corner of the curve's extent.
+ **/
+{
+	Dash_to_tmpfile();
+	if (mv_flag) {
+		PlotCmd_to_tmpfile(MOVE_TO);
+		HPGL_Pt_to_tmpfile(&P_last);
+		mv_flag = FALSE;
+	}
+	xmin = MIN(box[0].x, xmin);
+	ymin = MIN(box[0].y, ymin);
+	xmax = MAX(box[1].x, xmax);
+	ymax = MAX(box[1].y, ymax);
+
+	PlotCmd_to_tmpfile(cmd);
+	curve_to_TmpIndex(box, 2, end, td);
+	if (fwrite(data, size, 1, td) != 1) {
+		PError("Curve_to_tmpfile");
+		Eprintf("Error @ Cmd %ld\n", vec_cntr_w);
+		exit(ERROR);
+	}
+	P_last = *end;
+}
+
+
+
+static void grow_box(HPGL_Pt * box, double x, double y)
+{
+	box[0].x = (float) MIN(box[0].x, x);
+	box[0].y = (float) MIN(box[0].y, y);
+	box[1].x = (float) MAX(box[1].x, x);
+	box[1].y = (float) MAX(box[1].y, y);
+}
+
+
+
+int Text_to_tmpfile(const HPGL_Text * pt, const char *s, const HPGL_Pt * ink)
+/**
+ ** Record a label as TEXT. ink[0], ink[1] are the lower left and
+ ** upper right corner of the vectors it replaces.
+ ** Returns ERROR if the output mode needs the label as vectors.
+ **/
+{
+	HPGL_Text t;
+	HPGL_Pt box[2];
+	double tmp;
+	int i;
+
+	if (!native_text || polygon_mode)
+		return ERROR;
+	if (record_off)		/* Wrong page!  */
+		return 0;
+
+	t = *pt;
+	box[0] = ink[0];
+	box[1] = ink[1];
+	if (rotate_flag) {
+		tmp = rot_cos * t.org.x - rot_sin * t.org.y;
+		t.org.y = rot_sin * t.org.x + rot_cos * t.org.y;
+		t.org.x = tmp;
+		for (i = 0; i < 4; i += 2) {
+			tmp = rot_cos * t.m[i] - rot_sin * t.m[i + 1];
+			t.m[i + 1] = rot_sin * t.m[i] + rot_cos * t.m[i + 1];
+			t.m[i] = tmp;
+		}
+		box[0].x = box[0].y = 1.e10;
+		box[1].x = box[1].y = -1.e10;
+		for (i = 0; i < 4; i++)		/* Corners, rotated */
+			grow_box(box,
+				 rot_cos * ink[i & 1].x - rot_sin * ink[i >> 1].y,
+				 rot_sin * ink[i & 1].x + rot_cos * ink[i >> 1].y);
+	}
+	xmin = MIN(box[0].x, xmin);
+	ymin = MIN(box[0].y, ymin);
+	xmax = MAX(box[1].x, xmax);
+	ymax = MAX(box[1].y, ymax);
+
+	PlotCmd_to_tmpfile(TEXT);
+	curve_to_TmpIndex(box, 2, &t.org, td);
+	if (fwrite((VOID *) & t, sizeof(t), 1, td) != 1 ||
+	    fwrite((VOID *) s, 1, (size_t) t.n, td) != (size_t) t.n) {
+		PError("Text_to_tmpfile");
+		Eprintf("Error @ Cmd %ld\n", vec_cntr_w);
+		exit(ERROR);
+	}
+	P_last = t.org;
+	mv_flag = TRUE;
+	return 0;
+}
+
+
+
+static void cubic_range(double a, double b, double c, double d,
+			double *lo, double *hi)
+/**
+ ** Range of one coordinate of the cubic Bezier curve with control
+ ** values a, b, c, d: its ends and where the derivative vanishes
+ **/
+{
+	double qa, qb, qc, disc, t, v, root[2];
+	int i, n = 0;
+
+	*lo = MIN(a, d);
+	*hi = MAX(a, d);
+	qa = d - a + 3.0 * (b - c);
+	qb = 2.0 * (a - 2.0 * b + c);
+	qc = b - a;
+	if (fabs(qa) < 1.e-12) {
+		if (fabs(qb) > 1.e-12)
+			root[n++] = -qc / qb;
+	} else if ((disc = qb * qb - 4.0 * qa * qc) >= 0.0) {
+		root[n++] = (-qb + sqrt(disc)) / (2.0 * qa);
+		root[n++] = (-qb - sqrt(disc)) / (2.0 * qa);
+	}
+	for (i = 0; i < n; i++) {
+		if ((t = root[i]) <= 0.0 || t >= 1.0)
+			continue;
+		v = (1 - t) * (1 - t) * (1 - t) * a
+		    + 3 * t * (1 - t) * (1 - t) * b
+		    + 3 * t * t * (1 - t) * c + t * t * t * d;
+		*lo = MIN(*lo, v);
+		*hi = MAX(*hi, v);
+	}
+}
+
+
+
+static int Cubic_to_tmpfile(const HPGL_Pt * p0, const HPGL_Pt * p1,
+			    const HPGL_Pt * p2, const HPGL_Pt * p3)
+/**
+ ** Record the Bezier curve from *p0 (the pen position) to *p3, with
+ ** control points *p1, *p2 (user coordinates), as CUBIC record. Affine
+ ** maps keep it a Bezier curve. Returns ERROR if it must be split into
+ ** vectors instead.
+ **/
+{
+	HPGL_Pt P[4], box[2];
+	double lo, hi;
+
+	if (!curves_native())
+		return ERROR;
+	if (record_off)
+		return 0;
+
+	Pen_coord(p0, &P[0]);
+	Pen_coord(p1, &P[1]);
+	Pen_coord(p2, &P[2]);
+	Pen_coord(p3, &P[3]);
+	cubic_range(P[0].x, P[1].x, P[2].x, P[3].x, &lo, &hi);
+	box[0].x = (float) lo;
+	box[1].x = (float) hi;
+	cubic_range(P[0].y, P[1].y, P[2].y, P[3].y, &lo, &hi);
+	box[0].y = (float) lo;
+	box[1].y = (float) hi;
+
+	Curve_to_tmpfile(CUBIC, (VOID *) & P[1], 3 * sizeof(HPGL_Pt), box,
+			 &P[3]);
+	if (scale_flag)
+		User_to_Plotter_coord(p3, &HP_pos);
+	else
+		HP_pos = *p3;
+	return 0;
+}
+
+
+
+static int Arc_to_tmpfile(const HPGL_Pt * pcenter, double r, double phi0,
+			  double alpha)
+/**
+ ** Record the arc of radius r around *pcenter from angle phi0 to
+ ** phi0 + alpha (user coordinates, pen at its start) as ARC record.
+ ** Where scaling makes it elliptic, it is written as CUBIC records
+ ** of at most 45 degrees each (relative error below 5e-6).
+ ** Like Pen_action_to_tmpfile(), this leaves p_last to the caller.
+ ** Returns ERROR if it has to be split into chords instead.
+ **/
+{
+	HPGL_Arc a;
+	HPGL_Pt e, S, box[2], c[4];
+	double R, b0, b1, t, k;
+	int i, n;
+
+	if (!curves_native() || r == 0.0
+	    || fabs(alpha) > 2.0 * M_PI + 1.e-9)
+		return ERROR;
+
+	if (out_aspect != 1.0 || (scale_flag &&
+				  fabs(fabs(Q.x) - fabs(Q.y)) >
+				  1.e-6 * fabs(Q.x))) {
+		n = (int) ceil(fabs(alpha) / (M_PI / 4.0) - 1.e-9);
+		t = alpha / n;
+		k = 4.0 / 3.0 * tan(t / 4.0) * r;
+		c[3].x = (float) (pcenter->x + r * cos(phi0));
+		c[3].y = (float) (pcenter->y + r * sin(phi0));
+		for (i = 1; i <= n; i++) {
+			b0 = phi0 + (i - 1) * t;
+			b1 = phi0 + i * t;
+			c[0] = c[3];
+			c[1].x = (float) (c[0].x - k * sin(b0));
+			c[1].y = (float) (c[0].y + k * cos(b0));
+			c[3].x = (float) (pcenter->x + r * cos(b1));
+			c[3].y = (float) (pcenter->y + r * sin(b1));
+			c[2].x = (float) (c[3].x + k * sin(b1));
+			c[2].y = (float) (c[3].y - k * cos(b1));
+			Cubic_to_tmpfile(&c[0], &c[1], &c[2], &c[3]);
+		}
+		return 0;
+	}
+
+	e.x = (float) (pcenter->x + r * cos(phi0 + alpha));
+	e.y = (float) (pcenter->y + r * sin(phi0 + alpha));
+	if (!record_off) {
+		S.x = (float) (pcenter->x + r * cos(phi0));
+		S.y = (float) (pcenter->y + r * sin(phi0));
+		Pen_coord(&S, &S);
+		Pen_coord(pcenter, &a.center);
+		Pen_coord(&e, &a.end);
+		a.sweep = (float) alpha;
+		if (scale_flag && Q.x * Q.y < 0.0)	/* Mirrored */
+			a.sweep = -a.sweep;
+
+		/* Extent: end points and the quadrant points passed */
+		box[0] = box[1] = S;
+		grow_box(box, a.end.x, a.end.y);
+		R = HYPOT(S.x - a.center.x, S.y - a.center.y);
+		b0 = atan2(S.y - a.center.y, S.x - a.center.x);
+		b1 = b0 + a.sweep;
+		if (b1 < b0) {
+			t = b0;
+			b0 = b1;
+			b1 = t;
+		}
+		for (i = (int) ceil(2.0 * b0 / M_PI); i * M_PI / 2.0 <= b1; i++)
+			grow_box(box, a.center.x + R * cos(i * M_PI / 2.0),
+				 a.center.y + R * sin(i * M_PI / 2.0));
+
+		Curve_to_tmpfile(ARC, (VOID *) & a, sizeof(a), box, &a.end);
+	}
+	if (scale_flag)
+		User_to_Plotter_coord(&e, &HP_pos);
+	else
+		HP_pos = e;
+	return 0;
+}
+
+
+
+
+
 void HPGL_Pt_to_polygon(HPGL_Pt pf)
 {
 	if (record_off)		/* Wrong page!  */
 		return;
 
-	polygons[++vertices] = pf;
+	PolyBuf_add(&polygons, pf);
 	if (rotate_flag) {
 		double tmp = rot_cos * pf.x - rot_sin * pf.y;
 		pf.y = rot_sin * pf.x + rot_cos * pf.y;
@@ -876,7 +1424,7 @@ static void rect(int relative, int filled, float cur_pensize, HPGL_Pt p)
 		p1.y = p_last.y;
 		Pen_action_to_tmpfile(DRAW_TO, &p1, scale_flag);
 	} else {
-		vertices = -1;
+		polygons.last = -1;
 		HPGL_Pt_to_polygon(p_last);
 		p1.x = p_last.x;
 		p1.y = p.y;
@@ -900,7 +1448,7 @@ static void rect(int relative, int filled, float cur_pensize, HPGL_Pt p)
 
 			/*      anchor.y=MIN(P1.y,ymin); */
 		}
-		fill(polygons, vertices, anchor, P2, scale_flag,
+		fill(polygons.pt, polygons.last, anchor, P2, scale_flag,
 		     filltype, hatchspace, hatchangle);
 	}
 	Pen_action_to_tmpfile(MOVE_TO, &p_last, scale_flag);
@@ -967,6 +1515,8 @@ int read_PE_flags(GEN_PAR * pg, int c, FILE * hd, PE_flags * fl)
 		if (pen == 0 && pg->mapzero > -1)
 			pen = pg->mapzero;
 		if (old_pen != pen) {
+			flush_vertices();	/* Held back: old pen's */
+			pen_to_TmpIndex(pen, td);
 			if ((fputc(SET_PEN, td) == EOF)
 			    || (fputc(pen, td) == EOF)) {
 				PError("Writing to temporary file:");
@@ -1144,7 +1694,8 @@ static void Line_Generator(HPGL_Pt * pa, const HPGL_Pt * pb, int mv_flag)
 	dy = pb->y - pa->y;
 	seg_len = HYPOT(dx, dy);
 
-	switch (CurrentLineType) {
+	/* A pattern written as DEF_LT is the output's business */
+	switch (dash_last.n > 0 ? LT_solid : CurrentLineType) {
 
 	case LT_solid:
 		if (seg_len < 1.e-8) {
@@ -1153,8 +1704,7 @@ static void Line_Generator(HPGL_Pt * pa, const HPGL_Pt * pb, int mv_flag)
 				    ("Warning: Zero line segment length -- skipped\n");
 			return;	/* No line to draw ??           */
 		}
-		PlotCmd_to_tmpfile(DRAW_TO);
-		HPGL_Pt_to_tmpfile(pb);
+		Vertex_to_tmpfile(pa, pb);
 		return;
 
 	case LT_adaptive:
@@ -1230,7 +1780,6 @@ static void Line_Generator(HPGL_Pt * pa, const HPGL_Pt * pb, int mv_flag)
 
 void Pen_action_to_tmpfile(PlotCmd cmd, const HPGL_Pt * p, int scaled)
 {
-	static HPGL_Pt P_last;
 	HPGL_Pt P;
 	double tmp;
 
@@ -1250,6 +1799,9 @@ void Pen_action_to_tmpfile(PlotCmd cmd, const HPGL_Pt * p, int scaled)
 		P.x = tmp;
 	}
 
+	if (cmd != MOVE_TO)	/* Pattern change precedes the vector   */
+		Dash_to_tmpfile();
+
 	/* Extreme values needed for later scaling:    */
 
 	switch (cmd) {
@@ -1283,6 +1835,47 @@ void Pen_action_to_tmpfile(PlotCmd cmd, const HPGL_Pt * p, int scaled)
 
 
 
+void Polyline_to_tmpfile(const HPGL_Pt * p, const char *draw, int n)
+/**
+ ** Same as n calls of Pen_action_to_tmpfile(draw[i] ? DRAW_TO :
+ ** MOVE_TO, &p[i], FALSE), for a batch of plotter coordinates
+ **/
+{
+	HPGL_Pt P;
+	double tmp;
+	int i, dash = FALSE;
+
+	if (record_off)		/* Wrong page!  */
+		return;
+
+	for (i = 0; i < n; i++) {
+		P = p[i];
+		if (rotate_flag) {
+			tmp = rot_cos * P.x - rot_sin * P.y;
+			P.y = rot_sin * P.x + rot_cos * P.y;
+			P.x = tmp;
+		}
+		if (!draw[i])
+			mv_flag = TRUE;
+		else {
+			if (!dash) {	/* Pattern change precedes the vector */
+				Dash_to_tmpfile();
+				dash = TRUE;
+			}
+			if (mv_flag) {
+				PlotCmd_to_tmpfile(MOVE_TO);
+				HPGL_Pt_to_tmpfile(&P_last);
+			}
+			Line_Generator(&P_last, &P, mv_flag);
+			mv_flag = FALSE;
+		}
+		P_last = P;
+	}
+	HP_pos = p[n - 1];
+}
+
+
+
 
 
 int read_float(float *pnum, FILE * hd)
@@ -1845,12 +2438,72 @@ void line(int relative, HPGL_Pt p)
  **/
 
 
-static void arc_increment(HPGL_Pt * pcenter, double r, double phi)
+static double chord_angle(const HPGL_Pt * pcenter, double r, double eps,
+			  int given)
+/**
+ ** Step angle [rad] for arcs of radius r around *pcenter (user units
+ ** if scaled), keeping the chord error on the output below arc_tol_mm.
+ ** The output scale is exact with -t. Otherwise the final picture
+ ** range is not known yet: the range so far (which starts from the
+ ** preset range), including this arc, fitted into the -w/-h box
+ ** overestimates it, which errs on the fine side. Sides of a crop
+ ** window (-k) replace those of the range. A chord angle given in the
+ ** command is kept if finer.
+ **/
+{
+	HPGL_Pt c;
+	double dx, tol, step;
+
+	c = *pcenter;
+	if (scale_flag) {
+		User_to_Plotter_coord(pcenter, &c);
+		r *= MAX(fabs(Q.x), fabs(Q.y));
+	}
+	if (rotate_flag) {
+		dx = rot_cos * c.x - rot_sin * c.y;
+		c.y = rot_sin * c.x + rot_cos * c.y;
+		c.x = dx;
+	}
+	r = fabs(r);
+
+	tol = arc_tol_mm / out_mm(MIN(xmin, c.x - r), MIN(ymin, c.y - r),
+				  MAX(xmax, c.x + r), MAX(ymax, c.y + r));
+
+	step = (r > tol) ? 2.0 * acos(1.0 - tol / r) : MAX_CHORD_ANGLE;
+	step = MIN(step, MAX_CHORD_ANGLE);
+	step = MAX(step, MIN_CHORD_ANGLE);
+	if (given && eps > 0.0 && eps < step)
+		step = eps;
+	return step;
+}
+
+
+
+static int arc_steps(double alpha, double *p_eps)
+/**
+ ** Number of equal steps for an arc of angle alpha, none exceeding
+ ** *p_eps. The step actually used (signed) is returned in *p_eps.
+ **/
+{
+	int n;
+
+	if (alpha == 0.0)
+		return 0;
+	n = (int) ceil(fabs(alpha) / *p_eps - 1.e-9);
+	if (n < 1)
+		n = 1;
+	*p_eps = alpha / n;
+	return n;
+}
+
+
+
+static void arc_increment(const HPGL_Pt * pcenter, double dx, double dy)
 {
 	HPGL_Pt p;
 	int outside = 0;
-	p.x = pcenter->x + r * cos(phi);
-	p.y = pcenter->y + r * sin(phi);
+	p.x = pcenter->x + dx;
+	p.y = pcenter->y + dy;
 
 	if (iwflag) {
 		if (P1.x + (p.x - S1.x) * Q.x > C2.x
@@ -1889,6 +2542,31 @@ static void arc_increment(HPGL_Pt * pcenter, double r, double phi)
 	p_last = p;
 }
 
+
+
+static void arc_to(const HPGL_Pt * pcenter, double r, double phi0,
+		   double alpha, double eps, int n)
+/**
+ ** Arc of n steps of angle eps from phi0 to phi0 + alpha. Points
+ ** follow by rotating the radius vector, saving trig calls per point.
+ **/
+{
+	double dx, dy, rc, rs, t;
+	int i;
+
+	rc = cos(eps);
+	rs = sin(eps);
+	dx = r * cos(phi0);
+	dy = r * sin(phi0);
+	for (i = 1; i < n; i++) {
+		t = dx * rc - dy * rs;
+		dy = dx * rs + dy * rc;
+		dx = t;
+		arc_increment(pcenter, dx, dy);
+	}
+	arc_increment(pcenter, r * cos(phi0 + alpha), r * sin(phi0 + alpha));
+}
+
 static void bezier(int relative, FILE * hd)
 {
 	HPGL_Pt p, p1, p2, p3, polyp;
@@ -1928,6 +2606,11 @@ static void bezier(int relative, FILE * hd)
 p(t) = t^3*P3 + 3*t^2*(1-t)*P2 + 3*t*(1-t)^2* P1 + (1-t)^3 * P0
 */
 
+		if (Cubic_to_tmpfile(&p_last, &p1, &p2, &p3) == 0) {
+			p_last = p3;
+			continue;
+		}
+
 		polyp = p_last;
 		outside = 0;
 
@@ -1986,8 +2669,9 @@ static void tarcs(int relative, FILE * hd)
 {
 	HPGL_Pt p, p2, p3, center, d;
 	float alpha, eps;
-	double phi, phi0, r;
+	double phi0, r, step;
 	double SafeLinePatLen = CurrentLinePatLen;
+	int n, given = TRUE;
 
 	if (read_float(&p2.x, hd))	/* No number found      */
 		return;
@@ -2008,6 +2692,7 @@ static void tarcs(int relative, FILE * hd)
 		break;
 	case 1:		/* No resolution option */
 		eps = 5.0;	/*    so use default!   */
+		given = FALSE;
 		break;
 	case 2:		/* Illegal state        */
 		par_err_exit(98, AT, hd);
@@ -2073,9 +2758,12 @@ fprintf(stderr,"AT: P1 at %f %f , P2 %f %f, P3 %f %f, center %f %f radius %f\n",
 p_last.x,p_last.y,p2.x+p_last.x,p2.y+p_last.y,p3.x+p_last.x,p3.y+p_last.y,
 center.x,center.y,r);
 */
+	step = chord_angle(&center, r, eps, given);
+	n = arc_steps(alpha, &step);
+
 	if (CurrentLineType == LT_adaptive) {	/* Adaptive patterns:   */
-		p.x = r * cos(eps);	/* A chord segment      */
-		p.y = r * sin(eps);
+		p.x = r * cos(step);	/* A chord segment      */
+		p.y = r * sin(step);
 		if (scale_flag)
 			User_to_Plotter_coord(&p, &p);
 
@@ -2083,16 +2771,13 @@ center.x,center.y,r);
 		CurrentLinePatLen = HYPOT(p.x, p.y);
 	}
 
-	if (alpha > 0.0) {
-		for (phi = phi0 + MIN(eps, alpha); phi < phi0 + alpha;
-		     phi += eps)
-			arc_increment(&center, r, phi);
-		arc_increment(&center, r, phi0 + alpha);	/* to endpoint */
-	} else {
-		for (phi = phi0 - MIN(eps, -alpha); phi > phi0 + alpha;
-		     phi -= eps)
-			arc_increment(&center, r, phi);
-		arc_increment(&center, r, phi0 + alpha);	/* to endpoint */
+	if (n > 0) {
+		if (!pen_down || Arc_to_tmpfile(&center, r, phi0, alpha))
+			arc_to(&center, r, phi0, alpha, step, n);
+		else {
+			p_last.x = center.x + r * cos(phi0 + alpha);
+			p_last.y = center.y + r * sin(phi0 + alpha);
+		}
 	}
 
 	CurrentLinePatLen = SafeLinePatLen;	/* Restore */
@@ -2106,8 +2791,9 @@ static void arcs(int relative, FILE * hd)
 {
 	HPGL_Pt p, d, center;
 	float alpha, eps;
-	double phi, phi0, r;
+	double phi0, r, step;
 	double SafeLinePatLen = CurrentLinePatLen;
+	int n, given = TRUE;
 
 	if (read_float(&p.x, hd))	/* No number found      */
 		return;
@@ -2127,6 +2813,7 @@ static void arcs(int relative, FILE * hd)
 		break;
 	case 1:		/* No resolution option */
 		eps = 5.0;	/*    so use default!   */
+		given = FALSE;
 		break;
 	case 2:		/* Illegal state        */
 		par_err_exit(98, AA, hd);
@@ -2158,9 +2845,12 @@ static void arcs(int relative, FILE * hd)
 
 	phi0 = atan2(-d.y, -d.x);
 
+	step = chord_angle(&center, r, eps, given);
+	n = arc_steps(alpha, &step);
+
 	if (CurrentLineType == LT_adaptive) {	/* Adaptive patterns:   */
-		p.x = r * cos(eps);	/* A chord segment      */
-		p.y = r * sin(eps);
+		p.x = r * cos(step);	/* A chord segment      */
+		p.y = r * sin(step);
 		if (scale_flag)
 			User_to_Plotter_coord(&p, &p);
 
@@ -2168,16 +2858,13 @@ static void arcs(int relative, FILE * hd)
 		CurrentLinePatLen = HYPOT(p.x, p.y);
 	}
 
-	if (alpha > 0.0) {
-		for (phi = phi0 + MIN(eps, alpha); phi < phi0 + alpha;
-		     phi += eps)
-			arc_increment(&center, r, phi);
-		arc_increment(&center, r, phi0 + alpha);	/* to endpoint */
-	} else {
-		for (phi = phi0 - MIN(eps, -alpha); phi > phi0 + alpha;
-		     phi -= eps)
-			arc_increment(&center, r, phi);
-		arc_increment(&center, r, phi0 + alpha);	/* to endpoint */
+	if (n > 0) {
+		if (!pen_down || Arc_to_tmpfile(&center, r, phi0, alpha))
+			arc_to(&center, r, phi0, alpha, step, n);
+		else {
+			p_last.x = center.x + r * cos(phi0 + alpha);
+			p_last.y = center.y + r * sin(phi0 + alpha);
+		}
 	}
 	CurrentLinePatLen = SafeLinePatLen;	/* Restore */
 }
@@ -2186,10 +2873,10 @@ static void fwedges(FILE * hd, float cur_pensize)
 {				/*derived from circles */
 	HPGL_Pt p, oldp, center;
 	float eps, r, start, sweep;
-	double phi;
+	double dx, dy, rc, rs, t, step;
 	double SafeLinePatLen = CurrentLinePatLen;
 	int outside = 0;
-	int i;
+	int i, n, given = TRUE;
 
 	if (read_float(&r, hd))	/* No radius found      */
 		return;
@@ -2206,6 +2893,7 @@ static void fwedges(FILE * hd, float cur_pensize)
 		break;
 	case 1:		/* No resolution option */
 		eps = 5.0;	/*    so use default!   */
+		given = FALSE;
 		break;
 	case 2:		/* Illegal state        */
 		par_err_exit(98, EW, hd);
@@ -2224,7 +2912,7 @@ static void fwedges(FILE * hd, float cur_pensize)
 
 
 	center = p_last;	/* reference point is last position */
-	vertices = -1;		/* clear the polygon buffer */
+	polygons.last = -1;	/* clear the polygon buffer */
 	if (r == 0.0)		/* Zero radius given    */
 		return;
 
@@ -2233,21 +2921,34 @@ static void fwedges(FILE * hd, float cur_pensize)
 	p.y = center.y + r * sin(start);
 	HPGL_Pt_to_polygon(p);
 
+	step = chord_angle(&center, r, eps, given);
+	n = arc_steps(sweep, &step);
 
 	if (CurrentLineType == LT_adaptive) {	/* Adaptive patterns    */
-		p.x = r * cos(eps);	/* A chord segment      */
-		p.y = r * sin(eps);
+		p.x = r * cos(step);	/* A chord segment      */
+		p.y = r * sin(step);
 		if (scale_flag)
 			User_to_Plotter_coord(&p, &p);
 
 		/*      Pattern length = chord length           */
 		CurrentLinePatLen = HYPOT(p.x, p.y);
 	}
-	i = 1;
-	for (phi = eps; phi <= sweep; phi += eps) {
+	rc = cos(step);
+	rs = sin(step);
+	dx = r * cos(start);
+	dy = r * sin(start);
+	for (i = 1; i <= n; i++) {
 		oldp = p;
-		p.x = center.x + r * cos(start + phi);
-		p.y = center.y + r * sin(start + phi);
+		if (i < n) {
+			t = dx * rc - dy * rs;
+			dy = dx * rs + dy * rc;
+			dx = t;
+		} else {	/* Exact endpoint       */
+			dx = r * cos(start + sweep);
+			dy = r * sin(start + sweep);
+		}
+		p.x = center.x + dx;
+		p.y = center.y + dy;
 		if (iwflag) {
 			if (P1.x + (p.x - S1.x) * Q.x > C2.x
 			    || P1.y + (p.y - S1.y) * Q.y > C2.y) {
@@ -2276,8 +2977,8 @@ static void fwedges(FILE * hd, float cur_pensize)
 		anchor.x = P1.x;
 		anchor.y = P1.y;
 	}
-	fill(polygons, vertices, anchor, P2, scale_flag, filltype,
-	     hatchspace, hatchangle);
+	fill(polygons.pt, polygons.last, anchor, P2, scale_flag,
+	     filltype, hatchspace, hatchangle);
 
 
 	CurrentLinePatLen = SafeLinePatLen;	/* Restore */
@@ -2290,9 +2991,10 @@ static void circles(FILE * hd)
 {
 	HPGL_Pt p, center, polyp = { 0, 0 };
 	float eps, r;
-	double phi;
+	double dx, dy, rc, rs, t, step;
 	double SafeLinePatLen = CurrentLinePatLen;
 	int outside = 0;
+	int i, n, given = TRUE;
 
 	if (read_float(&r, hd))	/* No radius found      */
 		return;
@@ -2304,6 +3006,7 @@ static void circles(FILE * hd)
 		break;
 	case 1:		/* No resolution option */
 		eps = 5.0;	/*    so use default!   */
+		given = FALSE;
 		break;
 	case 2:		/* Illegal state        */
 		par_err_exit(98, CI, hd);
@@ -2331,9 +3034,17 @@ static void circles(FILE * hd)
 		polyp.x = p.x;
 		polyp.y = p.y;
 	}
+	if (Arc_to_tmpfile(&center, r, 0.0, 2.0 * M_PI) == 0) {
+		Pen_action_to_tmpfile(MOVE_TO, &center, scale_flag);
+		return;
+	}
+
+	step = chord_angle(&center, r, eps, given);
+	n = arc_steps(2.0 * M_PI, &step);
+
 	if (CurrentLineType == LT_adaptive) {	/* Adaptive patterns    */
-		p.x = r * cos(eps);	/* A chord segment      */
-		p.y = r * sin(eps);
+		p.x = r * cos(step);	/* A chord segment      */
+		p.y = r * sin(step);
 		if (scale_flag)
 			User_to_Plotter_coord(&p, &p);
 
@@ -2341,9 +3052,16 @@ static void circles(FILE * hd)
 		CurrentLinePatLen = HYPOT(p.x, p.y);
 	}
 
-	for (phi = eps; phi < 2.0 * M_PI; phi += eps) {
-		p.x = center.x + r * cos(phi);
-		p.y = center.y + r * sin(phi);
+	rc = cos(step);
+	rs = sin(step);
+	dx = r;
+	dy = 0.0;
+	for (i = 1; i < n; i++) {
+		t = dx * rc - dy * rs;
+		dy = dx * rs + dy * rc;
+		dx = t;
+		p.x = center.x + dx;
+		p.y = center.y + dy;
 		if (iwflag) {
 			if (P1.x + (p.x - S1.x) * Q.x > C2.x
 			    || P1.y + (p.y - S1.y) * Q.y > C2.y) {
@@ -2381,8 +3099,8 @@ static void circles(FILE * hd)
 
 	if (!polygon_mode) {
 		/* draw one overlapping segment to avoid leaving gap with wide pens */
-		p.x = center.x + r * cos(eps);
-		p.y = center.y + r * sin(eps);
+		p.x = center.x + r * rc;
+		p.y = center.y + r * rs;
 		if (iwflag) {
 			if (P1.x + (p.x - S1.x) * Q.x > C2.x
 			    || P1.y + (p.y - S1.y) * Q.y > C2.y) {
@@ -2417,9 +3135,10 @@ static void wedges(FILE * hd)
 {				/*derived from circles */
 	HPGL_Pt p, center;
 	float eps, r, start, sweep;
-	double phi;
+	double dx, dy, rc, rs, t, step;
 	double SafeLinePatLen = CurrentLinePatLen;
 	int outside = 0;
+	int i, n, given = TRUE;
 
 	if (read_float(&r, hd))	/* No radius found      */
 		return;
@@ -2437,6 +3156,7 @@ static void wedges(FILE * hd)
 		break;
 	case 1:		/* No resolution option */
 		eps = 5.0;	/*    so use default!   */
+		given = FALSE;
 		break;
 	case 2:		/* Illegal state        */
 		par_err_exit(98, EW, hd);
@@ -2463,9 +3183,14 @@ static void wedges(FILE * hd)
 	p.y = center.y + r * sin(start);
 	Pen_action_to_tmpfile(DRAW_TO, &p, scale_flag);
 
+	step = chord_angle(&center, r, eps, given);
+	n = arc_steps(sweep, &step);
+	if (n > 0 && Arc_to_tmpfile(&center, r, start, sweep) == 0)
+		n = 0;		/* Written as ARC record        */
+
 	if (CurrentLineType == LT_adaptive) {	/* Adaptive patterns    */
-		p.x = r * cos(eps);	/* A chord segment      */
-		p.y = r * sin(eps);
+		p.x = r * cos(step);	/* A chord segment      */
+		p.y = r * sin(step);
 		if (scale_flag)
 			User_to_Plotter_coord(&p, &p);
 
@@ -2473,9 +3198,21 @@ static void wedges(FILE * hd)
 		CurrentLinePatLen = HYPOT(p.x, p.y);
 	}
 
-	for (phi = eps; phi <= sweep; phi += eps) {
-		p.x = center.x + r * cos(start + phi);
-		p.y = center.y + r * sin(start + phi);
+	rc = cos(step);
+	rs = sin(step);
+	dx = r * cos(start);
+	dy = r * sin(start);
+	for (i = 1; i <= n; i++) {
+		if (i < n) {
+			t = dx * rc - dy * rs;
+			dy = dx * rs + dy * rc;
+			dx = t;
+		} else {	/* Exact endpoint       */
+			dx = r * cos(start + sweep);
+			dy = r * sin(start + sweep);
+		}
+		p.x = center.x + dx;
+		p.y = center.y + dy;
 		if (iwflag) {
 			if (P1.x + (p.x - S1.x) * Q.x > C2.x
 			    || P1.y + (p.y - S1.y) * Q.y > C2.y) {
@@ -2555,6 +3292,7 @@ static void read_HPGL_cmd(GEN_PAR * pg, int cmd, FILE * hd)
 	float ftmp;
 	float csfont;
 	int mypen, myred, mygreen, myblue, i;
+	long rgb;
 	float mywidth, myheight;
 	char tmpstr[1024];
 	char SafeTerm;
@@ -2723,14 +3461,14 @@ static void read_HPGL_cmd(GEN_PAR * pg, int cmd, FILE * hd)
 		if (polygon_penup == TRUE)
 			if (p_last.x != polystart.x
 			    || p_last.y != polystart.y)
-				vertices -= 2;
+				polygons.last -= 2;
 
-		for (i = 0; i < vertices; i = i + 2) {	/*for all polygon edges */
-			p1.x = polygons[i].x;
-			p1.y = polygons[i].y;
+		for (i = 0; i < polygons.last; i = i + 2) {	/*for all polygon edges */
+			p1.x = polygons.pt[i].x;
+			p1.y = polygons.pt[i].y;
 			Pen_action_to_tmpfile(MOVE_TO, &p1, scale_flag);
-			p1.x = polygons[i + 1].x;
-			p1.y = polygons[i + 1].y;
+			p1.x = polygons.pt[i + 1].x;
+			p1.y = polygons.pt[i + 1].y;
 			Pen_action_to_tmpfile(DRAW_TO, &p1, scale_flag);
 		}
 		Pen_action_to_tmpfile(MOVE_TO, &p_last, scale_flag);
@@ -2748,13 +3486,13 @@ static void read_HPGL_cmd(GEN_PAR * pg, int cmd, FILE * hd)
 		if (pg->nofill) {	/* treat like EP */
 			if (!silent_mode)
 				fprintf(stderr, "FP : suppressed\n");
-			for (i = 0; i < vertices; i = i + 2) {	/*for all polygon edges */
-				p1.x = polygons[i].x;
-				p1.y = polygons[i].y;
+			for (i = 0; i < polygons.last; i = i + 2) {	/*for all polygon edges */
+				p1.x = polygons.pt[i].x;
+				p1.y = polygons.pt[i].y;
 				Pen_action_to_tmpfile(MOVE_TO, &p1,
 						      scale_flag);
-				p1.x = polygons[i + 1].x;
-				p1.y = polygons[i + 1].y;
+				p1.x = polygons.pt[i + 1].x;
+				p1.y = polygons.pt[i + 1].y;
 				Pen_action_to_tmpfile(DRAW_TO, &p1,
 						      scale_flag);
 			}
@@ -2770,8 +3508,8 @@ static void read_HPGL_cmd(GEN_PAR * pg, int cmd, FILE * hd)
 			anchor.x = P1.x;
 			anchor.y = P1.y;
 		}
-		fill(polygons, vertices, anchor, P2, scale_flag, filltype,
-		     hatchspace, hatchangle);
+		fill(polygons.pt, polygons.last, anchor, P2, scale_flag,
+		     filltype, hatchspace, hatchangle);
 		Pen_action_to_tmpfile(MOVE_TO, &p_last, scale_flag);
 		break;
 	case FT:		/* Fill Type */
@@ -2857,6 +3595,17 @@ static void read_HPGL_cmd(GEN_PAR * pg, int cmd, FILE * hd)
 			PlotCmd_to_tmpfile(DEF_PC);
 			if (mypen == 0 && pg->mapzero > -1)
 				mypen = pg->mapzero;
+			if (mypen >= 0 && mypen < NUMPENS) {
+				/* Recoloring a pen which drew already would
+				   recolor its vectors in any palette image */
+				rgb = ((long) (BYTE) myred << 16) |
+				    ((long) (BYTE) mygreen << 8) |
+				    (long) (BYTE) myblue;
+				if (pens_drawn[mypen] && pen_rgb[mypen] != rgb)
+					pg->direct_color = TRUE;
+				pen_rgb[mypen] = rgb;
+				pens_drawn[mypen] = FALSE;
+			}
 			Pen_Color_to_tmpfile(mypen, myred, mygreen,
 					     myblue);
 			break;
@@ -2875,12 +3624,12 @@ static void read_HPGL_cmd(GEN_PAR * pg, int cmd, FILE * hd)
 			polygon_mode = TRUE;
 			polygon_penup = FALSE;
 			saved_penstate = pen_down;
-			vertices = -1;
+			polygons.last = -1;
 			polystart = p_last;
 			break;
 		}
 		if (ftmp == 1) {
-			if (vertices > 0)
+			if (polygons.last > 0)
 				polygon_penup = TRUE;
 			pen_down = FALSE;
 			break;
@@ -3263,6 +4012,7 @@ static void read_HPGL_cmd(GEN_PAR * pg, int cmd, FILE * hd)
 		/* record ON happens only once! */
 		page_number++;
 /*		fprintf(stderr, "PG: page_number now %d\n", page_number);*/
+		flush_vertices();
 		record_off = (first_page > page_number)
 		    || ((last_page < page_number) && (last_page > 0));
 		pg_flag = TRUE;
@@ -3427,6 +4177,8 @@ static void read_HPGL_cmd(GEN_PAR * pg, int cmd, FILE * hd)
 			pen = pen % pg->maxpens;
 		}
 		if (old_pen != pen) {
+			flush_vertices();	/* Held back: old pen's */
+			pen_to_TmpIndex(pen, td);
 			if ((fputc(SET_PEN, td) == EOF)
 			    || (fputc(pen, td) == EOF)) {
 				PError("Writing to temporary file:");
@@ -3786,6 +4538,125 @@ static void read_HPGL_cmd(GEN_PAR * pg, int cmd, FILE * hd)
 }
 
 
+static void profiled_HPGL_cmd(GEN_PAR * pg, int cmd, FILE * hd)
+/**
+ ** read_HPGL_cmd(), charging its input bytes, internal commands and
+ ** CPU time to the mnemonic
+ **/
+{
+	CmdProfile *cp;
+	clock_t t0;
+	long pos, n0;
+	int c1, c2;
+
+	c1 = (cmd >> 8) & 0xDF;	/* & forces to upper case       */
+	c2 = cmd & 0xDF;
+	if (c1 < 'A' || c1 > 'Z' || c2 < 'A' || c2 > 'Z') {
+		read_HPGL_cmd(pg, cmd, hd);
+		return;
+	}
+	cp = &cmd_prof[(c1 - 'A') * 26 + (c2 - 'A')];
+	cp->cmd = (c1 << 8) | c2;
+
+	pos = ftell(hd);
+	n0 = vec_cntr_w;
+	t0 = clock();
+	read_HPGL_cmd(pg, cmd, hd);
+	cp->cpu += (double) (clock() - t0) / CLOCKS_PER_SEC;
+	cp->vectors += vec_cntr_w - n0;
+	cp->calls++;
+	if (pos >= 0L && cp->bytes >= 0L && (n0 = ftell(hd)) >= 0L)
+		cp->bytes += n0 - pos + 2;	/* Mnemonic included    */
+	else
+		cp->bytes = -1L;
+}
+
+
+
+static int cmp_profile(const void *a, const void *b)
+/**
+ ** Most CPU time first, then most calls
+ **/
+{
+	const CmdProfile *pa = (const CmdProfile *) a;
+	const CmdProfile *pb = (const CmdProfile *) b;
+
+	if (pa->cpu != pb->cpu)
+		return (pa->cpu < pb->cpu) ? 1 : -1;
+	if (pa->calls != pb->calls)
+		return (pa->calls < pb->calls) ? 1 : -1;
+	return pa->cmd - pb->cmd;
+}
+
+
+
+static void print_profile(int format)
+/**
+ ** Report the profile of all mnemonics used, as table or JSON,
+ ** and clear it for the next file
+ **/
+{
+	CmdProfile *cp, total;
+	int i, n;
+
+	qsort(cmd_prof, 26 * 26, sizeof(CmdProfile), cmp_profile);
+	for (n = 0; n < 26 * 26 && cmd_prof[n].calls > 0; n++);
+	if (n == 0)		/* Nothing read, e.g. past the last page */
+		return;
+	memset(&total, 0, sizeof(total));
+	for (i = 0, cp = cmd_prof; i < n; i++, cp++) {
+		total.calls += cp->calls;
+		total.vectors += cp->vectors;
+		total.cpu += cp->cpu;
+		if (total.bytes >= 0L)
+			total.bytes = (cp->bytes >= 0L) ?
+			    total.bytes + cp->bytes : -1L;
+	}
+
+	if (format == 2) {
+		Eprintf("{\"profile\": [");
+		for (i = 0, cp = cmd_prof; i < n; i++, cp++) {
+			Eprintf("%s\n  {\"cmd\": \"%c%c\", \"calls\": %ld, ",
+				i ? "," : "", cp->cmd >> 8, cp->cmd & 0xFF,
+				cp->calls);
+			if (cp->bytes >= 0L)
+				Eprintf("\"bytes\": %ld, ", cp->bytes);
+			else
+				Eprintf("\"bytes\": null, ");
+			Eprintf("\"internal\": %ld, \"cpu_ms\": %.3f}",
+				cp->vectors, cp->cpu * 1000.0);
+		}
+		Eprintf("\n ],\n \"total\": {\"calls\": %ld, ", total.calls);
+		if (total.bytes >= 0L)
+			Eprintf("\"bytes\": %ld, ", total.bytes);
+		else
+			Eprintf("\"bytes\": null, ");
+		Eprintf("\"internal\": %ld, \"cpu_ms\": %.3f}}\n",
+			total.vectors, total.cpu * 1000.0);
+	} else {
+		Eprintf("\nHPGL profile:\n");
+		Eprintf("Cmd       Calls  Input bytes  Internal cmds    CPU [ms]\n");
+		for (i = 0, cp = cmd_prof; i <= n; i++, cp++) {
+			if (i == n)
+				cp = &total;
+			if (i == n)
+				Eprintf("All");
+			else
+				Eprintf("%c%c ", cp->cmd >> 8, cp->cmd & 0xFF);
+			Eprintf(" %10ld", cp->calls);
+			if (cp->bytes >= 0L)
+				Eprintf("  %11ld", cp->bytes);
+			else
+				Eprintf("  %11s", "-");
+			Eprintf("  %13ld  %10.3f\n", cp->vectors,
+				cp->cpu * 1000.0);
+		}
+	}
+	memset(cmd_prof, 0, 26 * 26 * sizeof(CmdProfile));
+}
+
+
+
 void read_HPGL(GEN_PAR * pg, const IN_PAR * pi)
 /**
  ** This routine is the high-level entry for HP-GL processing.
@@ -3803,6 +4674,108 @@ void read_HPGL(GEN_PAR * pg, const IN_PAR * pi)
 	n_unexpected = 0;
 	n_commands = 0;
 	n_unknown = 0;
+	reset_TmpIndex();
+	if (pg->profile && cmd_prof == NULL
+	    && (cmd_prof = (CmdProfile *) calloc(26 * 26,
+						 sizeof(CmdProfile))) == NULL)
+		Eprintf("\nNo memory for profile -- ignored\n");
+
+	switch (pg->xx_mode) {	/* Modes filling FILL_POLY records */
+	case XX_EPS:
+	case XX_SVG:
+	case XX_TILES:
+	case XX_PCL:
+	case XX_PCX:
+	case XX_PIC:
+	case XX_PAC:
+	case XX_ILBM:
+	case XX_IMG:
+	case XX_JPG:
+	case XX_PBM:
+	case XX_PGM:
+	case XX_PAM:
+	case XX_PNG:
+	case XX_TIFF:
+	case XX_ESC2:
+		native_fills = TRUE;
+		break;
+#if !defined(EMF) || defined(UNIX)
+	case XX_PRE:		/* Raster previewer */
+		native_fills = TRUE;
+		break;
+#endif
+	default:
+		native_fills = FALSE;
+		break;
+	}
+
+	switch (pg->xx_mode) {	/* Vector modes: arcs kept smooth on zooming */
+	case XX_CAD:
+	case XX_CS:
+	case XX_DXF:
+	case XX_EM:
+	case XX_EMF:
+	case XX_EMP:
+	case XX_EPIC:
+	case XX_EPS:
+	case XX_FIG:
+	case XX_GPT:
+	case XX_HPGL:
+	case XX_MF:
+	case XX_NC:
+	case XX_PDF:
+	case XX_RGIP:
+	case XX_SVG:
+		arc_tol_mm = VEC_CHORD_TOL;
+		break;
+	default:		/* Raster: nothing finer than a dot */
+		arc_tol_mm = pg->chord_tol;
+		break;
+	}
+	switch (pg->xx_mode) {	/* Modes drawing ARC & CUBIC records */
+	case XX_DXF:
+	case XX_EPS:
+	case XX_PDF:
+	case XX_SVG:
+		native_curves = TRUE;
+		break;
+	default:
+		native_curves = FALSE;
+		break;
+	}
+	switch (pg->xx_mode) {	/* Modes stroking DEF_LT dash patterns */
+	case XX_EPS:
+	case XX_PDF:
+	case XX_SVG:
+		native_dashes = TRUE;
+		break;
+	default:
+		native_dashes = FALSE;
+		break;
+	}
+	switch (pg->xx_mode) {	/* Modes writing labels as text */
+	case XX_EPS:
+	case XX_PDF:
+	case XX_SVG:
+		native_text = !pg->stroke_text;
+		break;
+	default:
+		native_text = FALSE;
+		break;
+	}
+	dash_last.n = 0;
+	simplify_mm = !pg->simplify ? -1.0
+	    : (pg->simplify_tol >= 0.0) ? pg->simplify_tol : arc_tol_mm;
+	sv_n = 0;
+	sv_in = sv_out = 0L;
+	out_truesize = pi->truesize;
+	out_aspect = pi->aspectfactor;
+	out_width = pi->width;
+	out_height = pi->height;
+	crop_x0 = pi->crop ? pi->x0 : 1e10;
+	crop_x1 = pi->crop ? pi->x1 : -1e10;
+	crop_y0 = pi->crop ? pi->y0 : 1e10;
+	crop_y1 = pi->crop ? pi->y1 : -1e10;
 
 	if ((c = getc(pi->hd)) == EOF)
 		return;
@@ -3837,6 +4810,7 @@ void read_HPGL(GEN_PAR * pg, const IN_PAR * pi)
 				if ((cmd = getc(pi->hd)) == 'G') {
 					page_number++;
 /*		fprintf(stderr, "stream-reading PG: page_number now %d\n", page_number);*/
+					flush_vertices();
 					record_off =
 					    (first_page > page_number)
 					    || ((last_page < page_number)
@@ -3853,6 +4827,7 @@ void read_HPGL(GEN_PAR * pg, const IN_PAR * pi)
 /*	  fprintf(stderr,"***NR***\n");'*/
 					page_number++;
 /*		fprintf(stderr, "stream-reading NR: page_number now %d\n", page_number);*/
+					flush_vertices();
 					record_off =
 					    (first_page > page_number)
 					    || ((last_page < page_number)
@@ -3870,6 +4845,7 @@ void read_HPGL(GEN_PAR * pg, const IN_PAR * pi)
 /*	  fprintf(stderr,"***AF/AH***\n");*/
 					page_number++;
 /*		fprintf(stderr, "stream-reading AF/AH: page_number now %d\n", page_number);*/
+					flush_vertices();
 					record_off =
 					    (first_page > page_number)
 					    || ((last_page < page_number)
@@ -3891,7 +4867,10 @@ void read_HPGL(GEN_PAR * pg, const IN_PAR * pi)
 			}
 			cmd |= (c & 0xFF);
 			n_commands++;
-			read_HPGL_cmd(pg, cmd, pi->hd);
+			if (cmd_prof != NULL)
+				profiled_HPGL_cmd(pg, cmd, pi->hd);
+			else
+				read_HPGL_cmd(pg, cmd, pi->hd);
 		}
 	}
 	if (c == EOF) {
@@ -3899,6 +4878,7 @@ void read_HPGL(GEN_PAR * pg, const IN_PAR * pi)
 /*			fprintf(stderr, "EOF : page_number now %d\n", page_number);*/
 	}
       END:
+	flush_vertices();
 	if (!pg->quiet && n_commands > 0) {
 		Eprintf("Page number %d of range %d - %d\n",
 			page_number - 1, pi->first_page, pi->last_page);
@@ -3906,6 +4886,9 @@ void read_HPGL(GEN_PAR * pg, const IN_PAR * pi)
 		Eprintf("HPGL command(s) ignored: %d\n", n_unknown);
 		Eprintf("Unexpected event(s):  %d\n", n_unexpected);
 		Eprintf("Internal command(s):  %ld\n", vec_cntr_w);
+		if (simplify_mm >= 0.0)
+			Eprintf("Vertices simplified:  %ld of %ld dropped\n",
+				sv_out, sv_in);
 		if ((pi->first_page > page_number - 1)
 		    || ((pi->last_page < page_number - 1)
 			&& (pi->last_page > 0))) {
@@ -3925,6 +4908,8 @@ void read_HPGL(GEN_PAR * pg, const IN_PAR * pi)
 /*                      Eprintf ("%d ", c+1); */
 		Eprintf("\nMax. number of pages: %d\n", page_number - 1);
 	}
+	if (cmd_prof != NULL)
+		print_profile(pg->profile);
 }
 
 
@@ -3947,8 +4932,34 @@ adjust_input_transform(const GEN_PAR * pg, const IN_PAR * pi, OUT_PAR * po)
  **/
 
 	double dot_ratio, Dx, Dy, tmp_w, tmp_h;
+	double cx0, cx1, cy0, cy1;
 	char *dir_str;
 
+	flush_vertices();	/* In case read_HPGL() met EOF early */
+
+  /**
+   ** Cropping (-k): the preset range limits replace those of the
+   ** picture. Only commands near this window are read back later.
+   **/
+	clear_TmpIndex_window();
+	po->pic_xmin = xmin;
+	po->pic_ymin = ymin;
+	if (pi->crop) {
+		cx0 = (pi->x0 < 1e10) ? pi->x0 : xmin;
+		cx1 = (pi->x1 > -1e10) ? pi->x1 : xmax;
+		cy0 = (pi->y0 < 1e10) ? pi->y0 : ymin;
+		cy1 = (pi->y1 > -1e10) ? pi->y1 : ymax;
+		if (cx0 < cx1 && cy0 < cy1) {
+			xmin = cx0;
+			xmax = cx1;
+			ymin = cy0;
+			ymax = cy1;
+			set_TmpIndex_window(xmin, ymin, xmax, ymax,
+					    pg->maxpensize / 0.025);
+		} else
+			Eprintf("\nEmpty crop window - option -k ignored\n");
+	}
+
 	Dx = xmax - xmin;
 	Dy = ymax - ymin;
 	dot_ratio = (double) po->dpi_y / (double) po->dpi_x;
@@ -4102,7 +5113,8 @@ PlotCmd PlotCmd_from_tmpfile(void)
 			break;
 		}
 
-	switch (cmd = fgetc(td)) {
+	switch (cmd = (TmpIndex_windowed()? cmd_from_TmpIndex(td)
+		       : fgetc(td))) {
 	case NOP:
 	case MOVE_TO:
 	case DRAW_TO:
@@ -4111,6 +5123,11 @@ PlotCmd PlotCmd_from_tmpfile(void)
 	case DEF_PW:
 	case DEF_PC:
 	case DEF_LA:
+	case FILL_POLY:
+	case ARC:
+	case CUBIC:
+	case DEF_LT:
+	case TEXT:
 		return cmd;
 	/*case (unsigned int) EOF:*/
 	default:
@@ -4120,13 +5137,111 @@ PlotCmd PlotCmd_from_tmpfile(void)
 
 
 
+int Polygon_from_tmpfile(HPGL_Pt ** p_polygon)
+/**
+ ** Read the edge list of a FILL_POLY record into a buffer kept here.
+ ** Returns the number of points (twice the number of edges).
+ **/
+{
+	HPGL_Pt *p;
+	int n;
+
+	if (fread((VOID *) & n, sizeof(n), 1, td) != 1 || n < 0) {
+		PError("Polygon_from_tmpfile");
+		Eprintf("Error @ Cmd %ld\n", vec_cntr_r);
+		exit(ERROR);
+	}
+	if (n > poly_buf_size) {
+		if ((p = (HPGL_Pt *) realloc(poly_buf,
+					     n * sizeof(HPGL_Pt))) == NULL) {
+			Eprintf("\nNo memory for polygon of %d points\n", n);
+			exit(ERROR);
+		}
+		poly_buf = p;
+		poly_buf_size = n;
+	}
+	if (fread((VOID *) poly_buf, sizeof(HPGL_Pt), (size_t) n, td) !=
+	    (size_t) n) {
+		PError("Polygon_from_tmpfile");
+		Eprintf("Error @ Cmd %ld\n", vec_cntr_r);
+		exit(ERROR);
+	}
+	*p_polygon = poly_buf;
+	return n;
+}
+
+
+
+void Arc_from_tmpfile(HPGL_Arc * pa)
+{
+	if (fread((VOID *) pa, sizeof(*pa), 1, td) != 1) {
+		PError("Arc_from_tmpfile");
+		Eprintf("Error @ Cmd %ld\n", vec_cntr_r);
+		exit(ERROR);
+	}
+}
+
+
+
+void Cubic_from_tmpfile(HPGL_Pt * p)
+/**
+ ** Read both control points and the end point of a CUBIC record
+ **/
+{
+	if (fread((VOID *) p, sizeof(*p), 3, td) != 3) {
+		PError("Cubic_from_tmpfile");
+		Eprintf("Error @ Cmd %ld\n", vec_cntr_r);
+		exit(ERROR);
+	}
+}
+
+
+
+char *Text_from_tmpfile(HPGL_Text * pt)
+/**
+ ** Read a TEXT record. Returns its characters, NUL terminated,
+ ** in a buffer kept here.
+ **/
+{
+	static char *buf = NULL;
+	static int buf_size = 0;
+	char *p;
+
+	if (fread((VOID *) pt, sizeof(*pt), 1, td) != 1 || pt->n < 0) {
+		PError("Text_from_tmpfile");
+		Eprintf("Error @ Cmd %ld\n", vec_cntr_r);
+		exit(ERROR);
+	}
+	if (pt->n >= buf_size) {
+		if ((p = (char *) realloc(buf, (size_t) pt->n + 1)) == NULL) {
+			Eprintf("\nNo memory for label of %d chars\n", pt->n);
+			exit(ERROR);
+		}
+		buf = p;
+		buf_size = pt->n + 1;
+	}
+	if (fread((VOID *) buf, 1, (size_t) pt->n, td) != (size_t) pt->n) {
+		PError("Text_from_tmpfile");
+		Eprintf("Error @ Cmd %ld\n", vec_cntr_r);
+		exit(ERROR);
+	}
+	buf[pt->n] = '\0';
+	return buf;
+}
+
+
+
 void HPGL_Pt_from_tmpfile(HPGL_Pt * pf)
 {
+	if (pt_from_TmpIndex(pf))
+		return;
 	if (fread((VOID *) pf, sizeof(*pf), 1, td) != 1) {
 		PError("HPGL_Pt_from_tmpfile");
 		Eprintf("Error @ Cmd %ld\n", vec_cntr_r);
 		exit(ERROR);
 	}
+	if (TmpIndex_windowed())	/* Cropping: points may lie outside */
+		return;
 	if (pf->x < xmin || pf->x > xmax)
 		Eprintf
 		    ("HPGL_Pt_from_tmpfile: x out of range (%g not in [%g, %g])\n",
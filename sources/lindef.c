@@ -34,6 +34,7 @@ double CurrentLinePatLen;
 signed int CurrentLinePattern;
 
 LINESTYLE lt;
+LineDash CurrentLineDash;
 
 LineAttr CurrentLineAttr;
 LineEnds CurrentLineEnd;
@@ -181,6 +182,79 @@ void print_line_style(void)
 }
 
 
+/********************************************
+ * Dash patterns
+ ********************************************/
+
+int make_line_dash(LineDash * pd)
+/**
+ ** Express the current line type as dash pattern for modes stroking
+ ** it themselves. Returns ERROR unless it is a fixed (positive) type
+ ** of nonzero pattern length. Since every pattern restarts with a
+ ** dash, a gap of length zero completes an odd number of elements.
+ **/
+{
+	const double *p = lt[CurrentLinePattern - LT_MIN];
+	double sum = 0.0;
+	int i;
+
+	pd->n = 0;
+	if (CurrentLineType != LT_fixed)
+		return ERROR;
+	for (i = 0; i < LT_ELEMENTS && p[i] >= 0.0; i++) {
+		pd->len[i] = (float) (p[i] * CurrentLinePatLen / 100.0);
+		sum += pd->len[i];
+	}
+	if (sum <= 0.0)
+		return ERROR;
+	if (i % 2)
+		pd->len[i++] = 0.0;
+	pd->n = i;
+	return 0;
+}
+
+int line_dash_has_dots(const LineDash * pd)
+/**
+ ** Zero-length dashes are dots; they need round line caps to show
+ **/
+{
+	int i;
+
+	for (i = 0; i < pd->n; i += 2)
+		if (pd->len[i] == 0.0)
+			return TRUE;
+	return FALSE;
+}
+
+void Line_Dash_to_tmpfile(const LineDash * pd)
+{
+	if (record_off)		/* return if current plot is not the selected one */
+		return;		/* (of a multi-image file) */
+
+	if (fwrite(&pd->n, sizeof(pd->n), 1, td) != 1
+	    || fwrite(pd->len, sizeof(pd->len[0]), (size_t) pd->n,
+		      td) != (size_t) pd->n) {
+		PError("Line_Dash_to_tmpfile");
+		Eprintf("Error @ Cmd %ld\n", vec_cntr_w);
+		exit(ERROR);
+	}
+}
+
+int load_line_dash(FILE * td)
+{
+	LineDash d;
+
+	if (fread((void *) &d.n, sizeof(d.n), 1, td) != 1
+	    || d.n < 0 || d.n > LT_ELEMENTS + 1)
+		return (-1);
+	if (fread((void *) d.len, sizeof(d.len[0]), (size_t) d.n, td)
+	    != (size_t) d.n)
+		return (-1);
+	CurrentLineDash = d;
+	return (0);
+}
+
+
 /************************************************* 
  *  Line Attributes
  *************************************************/
@@ -52,6 +52,20 @@ void set_line_style_by_UL(FILE *hd);
 
 void print_line_style(void);
 
+/* dash pattern of a line type, for modes stroking it natively */
+
+typedef struct {
+   int   n;                     /* Number of elements, 0: solid line */
+   float len[LT_ELEMENTS+1];    /* Dash, gap, dash, ... [plotter units] */
+} LineDash;
+
+extern LineDash CurrentLineDash;
+
+int  make_line_dash(LineDash *pd);
+int  line_dash_has_dots(const LineDash *pd);
+void Line_Dash_to_tmpfile(const LineDash *pd);
+int  load_line_dash(FILE *td);
+
 /* line attributes */
 
 typedef enum { LAE_butt          = 1,
@@ -39,6 +39,8 @@ static struct {
 	int oct2;
 	int quad4;
 	DevPt last1, last2, first1, first2, temp;
+	int windowed;		/* Plot only within xlo..xhi, ylo..yhi */
+	int xlo, ylo, xhi, yhi;
 } murphy;
 
 
@@ -55,14 +57,87 @@ void murphy_init(PicBuf * pb, PEN_C color)
 {
 	murphy.color = color;	/* setup buffer / color info */
 	murphy.pb = pb;
+	murphy.windowed = 0;
+}
+
+void murphy_window(int xlo, int ylo, int xhi, int yhi)
+{				/* only pels within these bounds are visible */
+	murphy.windowed = 1;
+	murphy.xlo = xlo;
+	murphy.ylo = ylo;
+	murphy.xhi = xhi;
+	murphy.yhi = yhi;
+}
+
+void murphy_break(void)
+{				/* the next line is not joined to the last one */
+	murphy.first1.x = -10000000;
+	murphy.first1.y = -10000000;
+	murphy.first2.x = -10000000;
+	murphy.first2.y = -10000000;
+	murphy.last1.x = -10000000;
+	murphy.last1.y = -10000000;
+	murphy.last2.x = -10000000;
+	murphy.last2.y = -10000000;
+}
+
+static void murphy_skip(DevPt * pt, int *d1, int n)
+{				/* n moves of murphy_paraline() at once */
+	double h;
+	int diag;
+
+	if (n <= 0)
+		return;
+	/* ceil((d1 - kt + (n-1)*kv) / ku) diagonal moves, at most n */
+	h = (double) *d1 - murphy.kt + (double) (n - 1) * murphy.kv;
+	if (h <= 0.0)
+		diag = 0;
+	else if (h >= (double) n * murphy.ku)
+		diag = n;
+	else {
+		diag = (int) (h / murphy.ku);
+		while ((double) diag * murphy.ku >= h)
+			diag--;
+		while ((double) diag * murphy.ku < h)
+			diag++;
+	}
+	if (murphy.oct2 == 0) {
+		pt->x += n;
+		pt->y += murphy.quad4 ? -diag : diag;
+	} else {
+		pt->x += diag;
+		pt->y += murphy.quad4 ? -n : n;
+	}
+	*d1 += n * murphy.kv - diag * murphy.ku;
 }
 
 void murphy_paraline(DevPt pt, int d1)
 {				/* implements Figure 5B */
 	int p;			/* pel counter, p=along line */
+	int lo = 0, hi = murphy.u;	/* visible pels */
 	d1 = -d1;
 
-	for (p = 0; p <= murphy.u; p++) {	/* test for end of parallel line */
+	if (murphy.windowed) {	/* each move is one pel along the major axis */
+		if (murphy.oct2 == 0) {
+			lo = murphy.xlo - pt.x;
+			hi = murphy.xhi - pt.x;
+		} else if (murphy.quad4 == 0) {
+			lo = murphy.ylo - pt.y;
+			hi = murphy.yhi - pt.y;
+		} else {
+			lo = pt.y - murphy.yhi;
+			hi = pt.y - murphy.ylo;
+		}
+		lo = MAX(lo, 0);
+		hi = MIN(hi, murphy.u);
+		if (lo > hi) {	/* nothing visible */
+			lo = murphy.u + 1;
+			hi = murphy.u;
+		}
+		murphy_skip(&pt, &d1, lo);
+	}
+
+	for (p = lo; p <= hi; p++) {	/* test for end of parallel line */
 
 		plot_PicBuf(murphy.pb, &pt, murphy.color);
 
@@ -87,6 +162,8 @@ void murphy_paraline(DevPt pt, int d1)
 			d1 += murphy.kd;
 		}
 	}
+	if (murphy.windowed)
+		murphy_skip(&pt, &d1, murphy.u - hi);
 	murphy.temp = pt;
 }
 
@@ -162,16 +239,8 @@ void murphy_wideline(DevPt p0, DevPt p1, int width, int miter)
 
 	tk = (int) (4. * HYPOT(pt.x - p0.x, pt.y - p0.y) * HYPOT(murphy.u, murphy.v));	/* used here for constant thickness line */
 
-	if (miter == 0) {
-		murphy.first1.x = -10000000;
-		murphy.first1.y = -10000000;
-		murphy.first2.x = -10000000;
-		murphy.first2.y = -10000000;
-		murphy.last1.x = -10000000;
-		murphy.last1.y = -10000000;
-		murphy.last2.x = -10000000;
-		murphy.last2.y = -10000000;
-	}
+	if (miter == 0)
+		murphy_break();
 	ptx = pt;
 
 	for (q = 0; dd <= tk; q++) {	/* outer loop, stepping perpendicular to line */
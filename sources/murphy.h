@@ -26,6 +26,10 @@ copies.
 
 void murphy_init(PicBuf *pb,PEN_C color);
 
+void murphy_window(int xlo, int ylo, int xhi, int yhi);
+
+void murphy_break(void);
+
 void murphy_paraline(DevPt p1,int d1);
 
 void murphy_wideline(DevPt p0, DevPt p1, int width, int miter);
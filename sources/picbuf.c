@@ -41,6 +41,16 @@ copies.
  **			   Improved cleanup & error handling
  ** 00/07/16          MK   Modify pensize correction in size_Pixbuf
  **                        for new .1 pixel pensize unit scheme (G.B.)
+ ** 26/10/19               Windowed mode for rendering picture sections
+ **                        (tiles); cmds_to_PicBuf() for indexed replay
+ ** 26/10/19               Direct color (32 bit RGBA) depth; horizontal
+ **                        spans; RowBuf_to_RGB() for true color formats
+ ** 26/10/19               Anti-aliased rasterizer (option -A)
+ ** 26/10/19               Scanline filling of FILL_POLY records
+ ** 26/10/19               Windowed mode skips dots outside the buffer
+ **                        instead of clipping vectors; joins restored
+ **                        at chunk starts. Tiles now match whole plots.
+ ** 26/10/19               MOVE_TO resumes joins after skipped chunks (-k)
  **/
 
 
@@ -58,12 +68,56 @@ copies.
 #include "picbuf.h"
 #include "hp2xx.h"
 #include "hpgl.h"
+#include "tmpindex.h"
 
 
 static RowBuf *first_buf = NULL, *last_buf = NULL;
 
 static int X_Offset = 0;
 static int Y_Offset = 0;
+static int Margin = 0;		/* Pensize correction of size_PicBuf()  */
+static int Windowed = FALSE;	/* Buffer holds a section of the picture */
+static int AntiAlias = FALSE;	/* Coverage rasterizer, 32 bit buffer   */
+static int AA_Mono = FALSE;	/* ... for a b/w picture                */
+
+/**
+ ** Rasterizer state, kept across calls of cmd_to_PicBuf()
+ **/
+static DevPt ref = { 0, 0 };
+static int consecutive = 0;
+static int pen_no = 1;
+
+/**
+ ** Anti-aliasing: Vectors in (unrounded) dot coordinates. The last one
+ ** is held back until it is known whether the next one continues it.
+ **/
+typedef struct {
+	double x0, y0, x1, y1;	/* End points                           */
+	double r;		/* Half line width [dots]               */
+	int cap0, cap1;		/* LineEnds; 0: joined to neighbour     */
+	PEN_C color;
+	PicBuf *pb;
+} AA_Vec;
+
+static double aa_ref_x = 0.0, aa_ref_y = 0.0;
+static AA_Vec aa_pending;
+static int aa_is_pending = FALSE;
+
+/**
+ ** Polygon filling: Edges sorted by their lower end, and work space
+ **/
+typedef struct {
+	double ylo, yhi;	/* Range of y covered (dot coordinates) */
+	double x, dxdy;		/* x at ylo, slope                      */
+} FillEdge;
+
+static FillEdge *fill_edges = NULL;
+static int fill_edges_size = 0;
+static double *fill_xs = NULL;	/* Crossings of the current scanline   */
+static int *fill_cover = NULL;	/* Coverage per dot of current row     */
+static int fill_cover_size = 0;
+
+#define	FILL_SUB	4	/* Sub-scanlines per row (anti-aliased) */
 
 #ifndef SEEK_SET
 #define SEEK_SET 0
@@ -215,6 +269,18 @@ static void plot_RowBuf(RowBuf * rowbuf, int x, int depth,
  ** but not easily readable...
  **/
 
+	if (depth == 32) {	/* Direct color: RGB, alpha 0 = background */
+		addr = rowbuf->buf + 4 * x;
+		if (color_index == xxBackground) {
+			addr[0] = addr[1] = addr[2] = addr[3] = 0;
+		} else {
+			addr[0] = pt.clut[color_index][0];
+			addr[1] = pt.clut[color_index][1];
+			addr[2] = pt.clut[color_index][2];
+			addr[3] = 0xFF;
+		}
+		return;
+	}
 	if (depth == 1) {
 		if (color_index > 1)
 			color_index = 1;
@@ -248,14 +314,50 @@ static void plot_RowBuf(RowBuf * rowbuf, int x, int depth,
 
 
 
+static void span_RowBuf(RowBuf * rowbuf, int x0, int x1, int depth,
+			PEN_C color_index)
+/**
+ ** Write color index into pixels x0 ... x1 (x0 <= x1) of given row buffer
+ **/
+{
+	Byte *addr;
+	Byte r, g, b;
+
+	if (rowbuf == NULL)
+		return;
+	if (depth == 8) {
+		memset(rowbuf->buf + x0, (int) color_index,
+		       (size_t) (x1 - x0 + 1));
+	} else if (depth == 32 && color_index != xxBackground) {
+		r = pt.clut[color_index][0];
+		g = pt.clut[color_index][1];
+		b = pt.clut[color_index][2];
+		for (addr = rowbuf->buf + 4 * x0; x0 <= x1; x0++) {
+			*addr++ = r;
+			*addr++ = g;
+			*addr++ = b;
+			*addr++ = 0xFF;
+		}
+	} else
+		for (; x0 <= x1; x0++)
+			plot_RowBuf(rowbuf, x0, depth, color_index);
+}
+
+
+
+
+
 int index_from_RowBuf(const RowBuf * rowbuf, int x, const PicBuf * pb)
 /**
  ** Return color index of pixel x in given row
+ ** (direct color: just foreground or background)
  **/
 {
 	int i, Mask, color_index;
 	Byte *addr;
 
+	if (pb->depth == 32)
+		return rowbuf->buf[4 * x + 3] ? xxForeground : xxBackground;
 	if (pb->depth == 1) {
 		Mask = 0x80;
 		if ((i = x & 0x07) != 0)
@@ -282,6 +384,52 @@ int index_from_RowBuf(const RowBuf * rowbuf, int x, const PicBuf * pb)
 
 
 
+void RowBuf_to_RGB(const RowBuf * rowbuf, const PicBuf * pb, Byte * rgb)
+/**
+ ** Convert a whole row into pb->nc RGB triplets for true color formats.
+ ** Direct color rows are copied; only the background needs the clut,
+ ** partially covered dots are blended with it.
+ **/
+{
+	const Byte *src;
+	const Byte *bg = pt.clut[xxBackground];
+	int x;
+
+	if (pb->depth == 32) {
+		for (x = 0, src = rowbuf->buf; x < pb->nc; x++, src += 4) {
+			if (src[3] == 0xFF) {
+				*rgb++ = src[0];
+				*rgb++ = src[1];
+				*rgb++ = src[2];
+			} else if (src[3] == 0) {
+				*rgb++ = bg[0];
+				*rgb++ = bg[1];
+				*rgb++ = bg[2];
+			} else {	/* Partial coverage (-A) */
+				*rgb++ = (Byte) ((src[0] * src[3] +
+						  bg[0] * (255 - src[3]) +
+						  127) / 255);
+				*rgb++ = (Byte) ((src[1] * src[3] +
+						  bg[1] * (255 - src[3]) +
+						  127) / 255);
+				*rgb++ = (Byte) ((src[2] * src[3] +
+						  bg[2] * (255 - src[3]) +
+						  127) / 255);
+			}
+		}
+	} else
+		for (x = 0; x < pb->nc; x++) {
+			src = pt.clut[index_from_RowBuf(rowbuf, x, pb)];
+			*rgb++ = src[0];
+			*rgb++ = src[1];
+			*rgb++ = src[2];
+		}
+}
+
+
+
+
+
 static void
 HPcoord_to_dotcoord(const HPGL_Pt * HP_P, DevPt * DevP, const OUT_PAR * po)
 {
@@ -290,6 +438,18 @@ HPcoord_to_dotcoord(const HPGL_Pt * HP_P, DevPt * DevP, const OUT_PAR * po)
 }
 
 
+static void
+HPcoord_to_aacoord(const HPGL_Pt * HP_P, double *x, double *y,
+		   const OUT_PAR * po)
+/**
+ ** Unrounded dot coordinates for the anti-aliasing rasterizer
+ **/
+{
+	*x = (HP_P->x - po->xmin) * po->HP_to_xdots;
+	*y = (HP_P->y - po->ymin) * po->HP_to_ydots;
+}
+
+
 
 void size_PicBuf(const GEN_PAR * pg, const OUT_PAR * po, int *p_rows,
 		 int *p_cols)
@@ -306,6 +466,8 @@ void size_PicBuf(const GEN_PAR * pg, const OUT_PAR * po, int *p_rows,
 	maxps = 1 + ceil(pg->maxpensize * po->HP_to_xdots / 0.025);
 	X_Offset = maxps / 2;
 	Y_Offset = maxps / 2;
+	Margin = maxps / 2;
+	Windowed = FALSE;
 
 /*   printf("maxps = %d\n",maxps);*/
 	*p_cols = D_Pt.x + maxps + 1;
@@ -375,6 +537,33 @@ PicBuf *allocate_PicBuf(const GEN_PAR * pg, int n_rows, int n_cols)
 		if (!pg->quiet)
 			fprintf(stderr, "using 8bpp picbuf for NP>15\n");
 	}
+/**
+ ** Direct color (RGBA) if pens got new colors after drawing, which a
+ ** palette cannot show, or for anti-aliasing (alpha = coverage) -
+ ** but only for formats taking RGB pixels.
+ **/
+	if ((pg->is_color && pg->direct_color) || pg->antialias)
+		switch (pg->xx_mode) {
+		case XX_PNG:
+		case XX_TILES:
+		case XX_JPG:
+		case XX_TIFF:
+		case XX_PBM:
+		case XX_PGM:
+		case XX_PAM:
+			pb->depth = 32;
+			if (!pg->quiet && !pg->antialias)
+				fprintf(stderr,
+					"using 32bpp picbuf for recolored pens\n");
+			break;
+		default:
+			if (pg->antialias && !pg->quiet)
+				Eprintf
+				    ("\nAnti-aliasing not supported in this mode - option -A ignored\n");
+			break;
+		}
+	AntiAlias = (pb->depth == 32 && pg->antialias);
+	AA_Mono = !pg->is_color;
 /**
  ** Allocate a (large) array of RowBuf structures: One for each scan line.
  ** !!! The NULL initialization done implicitly by calloc() is crucial !!!
@@ -500,8 +689,35 @@ void free_PicBuf(PicBuf * pb)
 
 
 
+void window_PicBuf(int x0, int y0)
+/**
+ ** Let the picture buffer hold only a section of the picture sized by
+ ** the last call of size_PicBuf(): (x0, y0) is the position of the
+ ** buffer's lower left corner within the whole picture.
+ ** In this mode, dots outside the buffer are dropped silently, and
+ ** thin vectors not touching it are skipped. size_PicBuf() resets it.
+ **/
+{
+	X_Offset = Margin - x0;
+	Y_Offset = Margin - y0;
+	Windowed = TRUE;
+}
+
+
+
+
 void plot_PicBuf(PicBuf * pb, DevPt * pt, PEN_C color_index)
 {
+	int x, y;
+
+	if (Windowed) {
+		x = pt->x + X_Offset;
+		y = pt->y + Y_Offset;
+		if (x < 0 || x >= pb->nc || y < 0 || y >= pb->nr)
+			return;
+		plot_RowBuf(get_RowBuf(pb, y), x, pb->depth, color_index);
+		return;
+	}
 	if ((pt->x + X_Offset) < 0 || pt->x > (pb->nc - X_Offset)) {
 		Eprintf("plot_PicBuf: Illegal x (%d not in [0, %d])\n",
 			pt->x + X_Offset, pb->nc);
@@ -514,6 +730,38 @@ void plot_PicBuf(PicBuf * pb, DevPt * pt, PEN_C color_index)
 
 
 
+static int hspan_PicBuf(PicBuf * pb, int x0, int x1, int y,
+			PEN_C color_index)
+/**
+ ** Plot a horizontal run of dots in one go. Returns 0 (nothing done)
+ ** if the run leaves the buffer outside windowed mode, so that
+ ** plot_PicBuf() may complain as usual.
+ **/
+{
+	int t;
+
+	if (x0 > x1) {
+		t = x0;
+		x0 = x1;
+		x1 = t;
+	}
+	x0 += X_Offset;
+	x1 += X_Offset;
+	y += Y_Offset;
+	if (Windowed) {
+		if (y < 0 || y >= pb->nr || x1 < 0 || x0 >= pb->nc)
+			return 1;
+		x0 = MAX(x0, 0);
+		x1 = MIN(x1, pb->nc - 1);
+	} else if (y < 0 || y >= pb->nr || x0 < 0 || x1 >= pb->nc)
+		return 0;
+	span_RowBuf(get_RowBuf(pb, y), x0, x1, pb->depth, color_index);
+	return 1;
+}
+
+
+
+
 int index_from_PicBuf(const PicBuf * pb, const DevPt * pt)
 {
 	if (pt->x < 0 || pt->x > pb->nc) {
@@ -563,6 +811,57 @@ static void dot_PicBuf(DevPt * p0, int pensize, PEN_C pencolor,
 }
 
 
+static int window_line(const DevPt * p0, const DevPt * p1, int linewidth,
+		       const PicBuf * pb)
+/**
+ ** Windowed mode only: Returns 0 if the vector cannot touch the buffer.
+ **/
+{
+	int xlo, xhi, ylo, yhi;
+
+	xlo = -X_Offset - linewidth - 1;
+	xhi = pb->nc - X_Offset + linewidth + 1;
+	ylo = -Y_Offset - linewidth - 1;
+	yhi = pb->nr - Y_Offset + linewidth + 1;
+
+	return !(MAX(p0->x, p1->x) < xlo || MIN(p0->x, p1->x) > xhi ||
+		 MAX(p0->y, p1->y) < ylo || MIN(p0->y, p1->y) > yhi);
+}
+
+
+static void window_steps(const DevPt * p0, const DevPt * p1,
+			 const PicBuf * pb, int *first, int *last)
+/**
+ ** Windowed mode only: Bresenham steps first..last of the vector
+ ** may plot dots within the buffer, judged by the major axis. The
+ ** rasterizers skip the others, instead of clipping the vector:
+ ** Moving its end points would change the dots it is made of.
+ **/
+{
+	int d, lo, hi;
+
+	if (abs(p1->x - p0->x) >= abs(p1->y - p0->y)) {
+		d = p1->x - p0->x;
+		lo = -X_Offset - p0->x;
+		hi = pb->nc - 1 - X_Offset - p0->x;
+	} else {
+		d = p1->y - p0->y;
+		lo = -Y_Offset - p0->y;
+		hi = pb->nr - 1 - Y_Offset - p0->y;
+	}
+	if (d < 0) {		/* Steps count downwards */
+		d = -d;
+		lo = -lo;
+		hi = -hi;
+		*first = MAX(hi, 0);
+		*last = MIN(lo, d);
+	} else {
+		*first = MAX(lo, 0);
+		*last = MIN(hi, d);
+	}
+}
+
+
 static void
 line_PicBuf(DevPt * p0, DevPt * p1, PEN_W pensize, PEN_C pencolor,
 	    int consecutive, const OUT_PAR * po)
@@ -576,6 +875,7 @@ line_PicBuf(DevPt * p0, DevPt * p1, PEN_W pensize, PEN_C pencolor,
 	DevPt t0, t1, t2, t3;
 	double len, xoff, yoff;
 	int dx, dy;
+	int first, last;
 	int linewidth = (int) ceil(pensize * po->HP_to_xdots / 0.025);	/* convert to pixel space */
 
 /*   printf("pensize = %0.3f mm, linewidth = %d pixels\n",pensize,linewidth);*/
@@ -589,8 +889,25 @@ line_PicBuf(DevPt * p0, DevPt * p1, PEN_W pensize, PEN_C pencolor,
 	if (linewidth < 5)
 		consecutive = 0;
 
+	/* Wide vectors are kept: The next one joins to their corners */
+	if (Windowed && linewidth < 5 && !window_line(p0, p1, linewidth, pb))
+		return;
+
+	if (linewidth == 1 && p0->y == p1->y
+	    && hspan_PicBuf(pb, p0->x, p1->x, p0->y, pencolor))
+		return;	/* Horizontal, e.g. hatching       */
+
 	if (linewidth == 1) {	/* Thin lines of any attitude */
 		p_act = bresenham_init(p0, p1);
+		if (Windowed) {
+			window_steps(p0, p1, pb, &first, &last);
+			bresenham_skip(first);
+			for (; first <= last; first++) {
+				plot_PicBuf(pb, p_act, pencolor);
+				bresenham_next();
+			}
+			return;
+		}
 		do {
 			plot_PicBuf(pb, p_act, pencolor);
 		} while (bresenham_next() != BRESENHAM_ERR);
@@ -603,6 +920,9 @@ line_PicBuf(DevPt * p0, DevPt * p1, PEN_W pensize, PEN_C pencolor,
 	}
 
 	murphy_init(pb, pencolor);	/* Wide Lines */
+	if (Windowed)
+		murphy_window(-X_Offset, -Y_Offset, pb->nc - 1 - X_Offset,
+			      pb->nr - 1 - Y_Offset);
 	murphy_wideline(*p0, *p1, linewidth, consecutive);
 
 	if (pensize > 0.35) {
@@ -669,7 +989,7 @@ line_PicBuf(DevPt * p0, DevPt * p1, PEN_W pensize, PEN_C pencolor,
 		dot_PicBuf(p0, linewidth, pencolor, pb);	/* lines upto 0.35 always have round ends */
 		dot_PicBuf(p1, linewidth, pencolor, pb);
 	}
-
+	return;
 }
 
 void polygon_PicBuf(DevPt p4, DevPt p2, DevPt p1, DevPt p3, PEN_C pencolor,
@@ -798,6 +1118,481 @@ continue;
 
 }
 
+static void blend_RowBuf(RowBuf * rowbuf, int x, PEN_C color_index,
+			 int cover)
+/**
+ ** Direct color only: Paint cover/255 of pixel x with the given color
+ ** ("over" operator). Alpha accumulates the total coverage.
+ **/
+{
+	Byte *addr;
+	const Byte *c;
+	long wc, wa, na;
+	int i;
+
+	if (rowbuf == NULL)
+		return;
+	addr = rowbuf->buf + 4 * x;
+	c = pt.clut[color_index];
+	if (cover >= 255 || addr[3] == 0) {
+		addr[0] = c[0];
+		addr[1] = c[1];
+		addr[2] = c[2];
+		addr[3] = (Byte) MIN(cover, 255);
+		return;
+	}
+	wc = 255L * cover;
+	wa = (long) addr[3] * (255 - cover);
+	na = wc + wa;
+	for (i = 0; i < 3; i++)
+		addr[i] = (Byte) ((c[i] * wc + addr[i] * wa + na / 2) / na);
+	addr[3] = (Byte) ((na + 127) / 255);
+}
+
+
+
+static void aa_range(double a, double b, double lo, double hi,
+		     double *p_lo, double *p_hi)
+/**
+ ** Narrow [*p_lo, *p_hi] to the q satisfying  lo <= a * q + b <= hi
+ **/
+{
+	double q0, q1;
+
+	if (fabs(a) < 1.e-9) {
+		if (b < lo || b > hi) {
+			*p_lo = 1.e30;
+			*p_hi = -1.e30;
+		}
+		return;
+	}
+	q0 = (lo - b) / a;
+	q1 = (hi - b) / a;
+	if (q0 > q1) {
+		a = q0;
+		q0 = q1;
+		q1 = a;
+	}
+	*p_lo = MAX(*p_lo, q0);
+	*p_hi = MIN(*p_hi, q1);
+}
+
+
+
+static double aa_cap(int cap, double s, double d, double r)
+/**
+ ** Signed distance of a dot to the outline of a line end:
+ ** s is its distance beyond the end point, d from the line's axis.
+ **/
+{
+	switch (cap) {
+	case LAE_butt:
+		return -s;
+	case LAE_square:
+		return r - s;
+	case LAE_triangular:
+		return (s > 0.0) ? (r - s - d) * M_SQRT1_2 : r;
+	case LAE_round:
+	default:
+		return (s > 0.0) ? r - HYPOT(s, d) : r;
+	}
+}
+
+
+
+static void aa_vec_to_PicBuf(const AA_Vec * v)
+/**
+ ** Anti-aliased rasterization of a wide vector with its line ends.
+ ** Each dot gets the fraction of its area inside the outline, taken
+ ** from its center's signed distance to the outline. Only the dots
+ ** within reach of the outline are visited, row by row.
+ **/
+{
+	PicBuf *pb = v->pb;
+	RowBuf *row;
+	double x0, y0, x1, y1, len, ux, uy, ext, lo, hi, qx, qy, t, d, sd;
+	int x, y, xlo, xhi, ylo, yhi, cover;
+
+	x0 = v->x0 + X_Offset;
+	y0 = v->y0 + Y_Offset;
+	x1 = v->x1 + X_Offset;
+	y1 = v->y1 + Y_Offset;
+	len = HYPOT(x1 - x0, y1 - y0);
+	if (len < 1.e-6) {
+		len = 0.0;
+		ux = 1.0;
+		uy = 0.0;
+	} else {
+		ux = (x1 - x0) / len;
+		uy = (y1 - y0) / len;
+	}
+
+	ext = v->r + 0.5;	/* Reach of partially covered dots      */
+	ylo = (int) floor(MIN(y0, y1) - 1.5 * ext);
+	yhi = (int) ceil(MAX(y0, y1) + 1.5 * ext);
+	ylo = MAX(ylo, 0);
+	yhi = MIN(yhi, pb->nr - 1);
+
+	for (y = ylo; y <= yhi; y++) {
+		qy = y + 0.5 - y0;
+		lo = -1.e30;
+		hi = 1.e30;
+		aa_range(ux, qy * uy, -ext, len + ext, &lo, &hi);
+		aa_range(-uy, qy * ux, -ext, ext, &lo, &hi);
+		if (lo > hi)
+			continue;
+		xlo = MAX(0, (int) ceil(lo + x0 - 0.5));
+		xhi = MIN(pb->nc - 1, (int) floor(hi + x0 - 0.5));
+		for (row = NULL, x = xlo; x <= xhi; x++) {
+			qx = x + 0.5 - x0;
+			t = qx * ux + qy * uy;
+			d = fabs(qy * ux - qx * uy);
+			sd = v->r - d;
+			if (t < ext)	/* Line ends matter near them only */
+				sd = MIN(sd, aa_cap(v->cap0, -t, d, v->r));
+			if (t > len - ext)
+				sd = MIN(sd, aa_cap(v->cap1, t - len, d, v->r));
+			if (sd <= -0.5)
+				continue;
+			cover = (sd >= 0.5) ? 255 :
+			    (int) ((sd + 0.5) * 255.0 + 0.5);
+			if (cover == 0)
+				continue;
+			if (row == NULL)
+				row = get_RowBuf(pb, y);
+			blend_RowBuf(row, x, v->color, cover);
+		}
+	}
+}
+
+
+
+static void aa_flush(void)
+{
+	if (aa_is_pending) {
+		aa_vec_to_PicBuf(&aa_pending);
+		aa_is_pending = FALSE;
+	}
+}
+
+
+
+static void
+aa_line_PicBuf(double x0, double y0, double x1, double y1, PEN_W pensize,
+	       PEN_C pencolor, int consecutive, const OUT_PAR * po)
+/**
+ ** Anti-aliased counterpart of line_PicBuf(). Vectors continuing the
+ ** previous one are joined to it by a round join.
+ **/
+{
+	int cap, cap0;
+
+	if (pensize <= 0.0 || pencolor == xxBackground) {
+		aa_flush();
+		return;
+	}
+	if (AA_Mono)
+		pencolor = xxForeground;
+	cap = (pensize > 0.35) ? (int) CurrentLineAttr.End : LAE_round;
+
+	if (aa_is_pending && consecutive > 0) {
+		if (x0 == x1 && y0 == y1)
+			return;	/* Nothing new to join          */
+		aa_pending.cap1 = LAE_round;
+		cap0 = LAE_butt;
+	} else
+		cap0 = cap;
+	aa_flush();
+	if (x0 == x1 && y0 == y1)	/* Dots are always round        */
+		cap = cap0 = LAE_round;
+
+	aa_pending.x0 = x0;
+	aa_pending.y0 = y0;
+	aa_pending.x1 = x1;
+	aa_pending.y1 = y1;
+	aa_pending.r = 0.5 * MAX(pensize * po->HP_to_xdots / 0.025, 1.0);
+	aa_pending.cap0 = cap0;
+	aa_pending.cap1 = cap;
+	aa_pending.color = pencolor;
+	aa_pending.pb = po->picbuf;
+	aa_is_pending = TRUE;
+}
+
+
+
+static int cmp_FillEdge(const void *a, const void *b)
+{
+	double d = ((const FillEdge *) a)->ylo - ((const FillEdge *) b)->ylo;
+
+	return (d < 0.0) ? -1 : (d > 0.0);
+}
+
+
+
+static int fill_crossings(int n_edges, int *p_first, double ys)
+/**
+ ** Sorted x of all edges crossing scanline ys (half-open in y,
+ ** so vertices shared by two edges count once). Edges ending below
+ ** ys are dropped from the front of the active range.
+ **/
+{
+	const FillEdge *e;
+	double x;
+	int i, j, n = 0;
+
+	while (*p_first < n_edges && fill_edges[*p_first].yhi <= ys)
+		(*p_first)++;
+	for (i = *p_first, e = fill_edges + i; i < n_edges && e->ylo <= ys;
+	     i++, e++) {
+		if (ys >= e->yhi)
+			continue;
+		x = e->x + (ys - e->ylo) * e->dxdy;
+		for (j = n++; j > 0 && fill_xs[j - 1] > x; j--)
+			fill_xs[j] = fill_xs[j - 1];
+		fill_xs[j] = x;
+	}
+	return n;
+}
+
+
+
+static void fill_PicBuf(const HPGL_Pt * p, int n, PEN_C pencolor,
+			const OUT_PAR * po)
+/**
+ ** Fill a polygon given as list of edges (point pairs), even-odd rule.
+ ** Dots are set if their centers lie inside. In anti-aliasing mode,
+ ** FILL_SUB sub-scanlines with exact span ends yield the coverage.
+ **/
+{
+	PicBuf *pb = po->picbuf;
+	RowBuf *row;
+	FillEdge *e;
+	double x0, y0, x1, y1, ymin, ymax, ys, xa, xb;
+	int i, k, n_edges, first, n_xs, y, ylo, yhi, xlo, xhi, xl, xr;
+	int sub, cmin, cmax;
+
+	if (pencolor == xxBackground)	/* No drawable color!       */
+		return;
+	if (AntiAlias && AA_Mono)
+		pencolor = xxForeground;
+
+	if (n / 2 > fill_edges_size) {
+		free(fill_edges);
+		free(fill_xs);
+		fill_edges_size = n / 2;
+		fill_edges = (FillEdge *) malloc(fill_edges_size *
+						 sizeof(FillEdge));
+		fill_xs = (double *) malloc(fill_edges_size * sizeof(double));
+		if (fill_edges == NULL || fill_xs == NULL) {
+			Eprintf("\nNo memory for polygon fill - skipped\n");
+			free(fill_edges);
+			free(fill_xs);
+			fill_edges = NULL;
+			fill_xs = NULL;
+			fill_edges_size = 0;
+			return;
+		}
+	}
+	if (AntiAlias && pb->nc > fill_cover_size) {
+		free(fill_cover);
+		if ((fill_cover = (int *) calloc((size_t) pb->nc,
+						 sizeof(int))) == NULL) {
+			Eprintf("\nNo memory for polygon fill - skipped\n");
+			fill_cover_size = 0;
+			return;
+		}
+		fill_cover_size = pb->nc;
+	}
+
+	/* Edges in dot coordinates of the buffer; horizontal ones drop out */
+	ymin = 1.e30;
+	ymax = -1.e30;
+	for (i = 0, n_edges = 0, e = fill_edges; i + 1 < n; i += 2) {
+		HPcoord_to_aacoord(&p[i], &x0, &y0, po);
+		HPcoord_to_aacoord(&p[i + 1], &x1, &y1, po);
+		if (y0 == y1)
+			continue;
+		x0 += X_Offset;
+		x1 += X_Offset;
+		y0 += Y_Offset;
+		y1 += Y_Offset;
+		if (y0 < y1) {
+			e->ylo = y0;
+			e->yhi = y1;
+			e->x = x0;
+		} else {
+			e->ylo = y1;
+			e->yhi = y0;
+			e->x = x1;
+		}
+		e->dxdy = (x1 - x0) / (y1 - y0);
+		ymin = MIN(ymin, e->ylo);
+		ymax = MAX(ymax, e->yhi);
+		e++;
+		n_edges++;
+	}
+	if (n_edges < 2)
+		return;
+	qsort(fill_edges, (size_t) n_edges, sizeof(FillEdge), cmp_FillEdge);
+
+	ylo = MAX(0, (int) floor(ymin));
+	yhi = MIN(pb->nr - 1, (int) ceil(ymax));
+	first = 0;
+	for (y = ylo; y <= yhi; y++) {
+		if (!AntiAlias) {
+			n_xs = fill_crossings(n_edges, &first, y + 0.5);
+			for (row = NULL, k = 0; k + 1 < n_xs; k += 2) {
+				xlo = (int) ceil(fill_xs[k] - 0.5);
+				xhi = (int) ceil(fill_xs[k + 1] - 0.5) - 1;
+				xlo = MAX(xlo, 0);
+				xhi = MIN(xhi, pb->nc - 1);
+				if (xlo > xhi)
+					continue;
+				if (row == NULL)
+					row = get_RowBuf(pb, y);
+				span_RowBuf(row, xlo, xhi, pb->depth,
+					    pencolor);
+			}
+			continue;
+		}
+
+		/* Anti-aliased: 256 units of coverage per sub-scanline */
+		cmin = pb->nc;
+		cmax = -1;
+		for (sub = 0; sub < FILL_SUB; sub++) {
+			ys = y + (sub + 0.5) / FILL_SUB;
+			n_xs = fill_crossings(n_edges, &first, ys);
+			for (k = 0; k + 1 < n_xs; k += 2) {
+				xa = MAX(fill_xs[k], 0.0);
+				xb = MIN(fill_xs[k + 1], (double) pb->nc);
+				if (xa >= xb)
+					continue;
+				xl = (int) floor(xa);
+				xr = MIN((int) floor(xb), pb->nc - 1);
+				cmin = MIN(cmin, xl);
+				cmax = MAX(cmax, xr);
+				if (xl == xr) {
+					fill_cover[xl] +=
+					    (int) ((xb - xa) * 256.0 + 0.5);
+					continue;
+				}
+				fill_cover[xl] +=
+				    (int) ((xl + 1 - xa) * 256.0 + 0.5);
+				for (i = xl + 1; i < xr; i++)
+					fill_cover[i] += 256;
+				fill_cover[xr] += (int) ((xb - xr) * 256.0 + 0.5);
+			}
+		}
+		for (row = NULL, i = cmin; i <= cmax; i++) {
+			k = fill_cover[i] * 255 / (256 * FILL_SUB);
+			fill_cover[i] = 0;
+			if (k <= 0)
+				continue;
+			if (row == NULL)
+				row = get_RowBuf(pb, y);
+			blend_RowBuf(row, i, pencolor, k);
+		}
+	}
+}
+
+
+
+static void
+cmd_to_PicBuf(const GEN_PAR * pg, const OUT_PAR * po, PlotCmd cmd)
+/**
+ ** Read the parameters of a single command from the temporary file
+ ** and execute it
+ **/
+{
+	HPGL_Pt pt1, *poly;
+	DevPt next;
+	double x, y;
+	int n;
+
+	if (AntiAlias && cmd != DRAW_TO)
+		aa_flush();
+
+	switch (cmd) {
+	case NOP:
+		break;
+	case SET_PEN:
+		if ((pen_no = fgetc(pg->td)) == EOF) {
+			PError("Unexpected end of temp. file");
+			exit(ERROR);
+		}
+		consecutive = 0;
+		break;
+	case DEF_PW:
+		if (!load_pen_width_table(pg->td)) {
+			PError("Unexpected end of temp. file");
+			exit(ERROR);
+		}
+		break;
+	case DEF_PC:
+		if (load_pen_color_table(pg->td) < 0) {
+			PError("Unexpected end of temp. file");
+			exit(ERROR);
+		}
+		consecutive = 0;
+		break;
+	case DEF_LA:
+		if (load_line_attr(pg->td) < 0) {
+			PError("Unexpected end of temp. file");
+			exit(ERROR);
+		}
+		consecutive = 0;
+		break;
+	case MOVE_TO:
+		HPGL_Pt_from_tmpfile(&pt1);
+		HPcoord_to_dotcoord(&pt1, &ref, po);
+		HPcoord_to_aacoord(&pt1, &aa_ref_x, &aa_ref_y, po);
+		consecutive = joins_from_TmpIndex();
+		murphy_break();
+		break;
+	case DRAW_TO:
+		HPGL_Pt_from_tmpfile(&pt1);
+		HPcoord_to_dotcoord(&pt1, &next, po);
+		if (AntiAlias) {
+			HPcoord_to_aacoord(&pt1, &x, &y, po);
+			aa_line_PicBuf(aa_ref_x, aa_ref_y, x, y,
+				       pt.width[pen_no], pt.color[pen_no],
+				       consecutive, po);
+			aa_ref_x = x;
+			aa_ref_y = y;
+		} else {
+			line_PicBuf(&ref, &next, pt.width[pen_no],
+				    pt.color[pen_no], consecutive, po);
+		}
+		memcpy(&ref, &next, sizeof(ref));
+		consecutive++;
+		break;
+	case PLOT_AT:
+		HPGL_Pt_from_tmpfile(&pt1);
+		HPcoord_to_dotcoord(&pt1, &ref, po);
+		if (AntiAlias) {
+			HPcoord_to_aacoord(&pt1, &aa_ref_x, &aa_ref_y, po);
+			aa_line_PicBuf(aa_ref_x, aa_ref_y, aa_ref_x, aa_ref_y,
+				       pt.width[pen_no], pt.color[pen_no], 0,
+				       po);
+		} else
+			line_PicBuf(&ref, &ref, pt.width[pen_no],
+				    pt.color[pen_no], consecutive, po);
+		consecutive = 0;
+		break;
+	case FILL_POLY:
+		n = Polygon_from_tmpfile(&poly);
+		fill_PicBuf(poly, n, pt.color[pen_no], po);
+		consecutive = 0;
+		break;
+
+	default:
+		Eprintf("Illegal cmd in temp. file!\n");
+		exit(ERROR);
+	}
+}
+
+
+
 void tmpfile_to_PicBuf(const GEN_PAR * pg, const OUT_PAR * po)
 /**
  ** Interface to higher-level routines:
@@ -806,72 +1601,43 @@ void tmpfile_to_PicBuf(const GEN_PAR * pg, const OUT_PAR * po)
  **   and draw (rasterize) vectors.
  **/
 {
-	HPGL_Pt pt1;
-	static DevPt ref = { 0, 0 };
-	DevPt next;
 	PlotCmd cmd;
-	static int consecutive = 0;
-	int pen_no = 1;
 
 	if (!pg->quiet)
 		Eprintf("\nPlotting in buffer\n");
 
 	rewind(pg->td);
+	pen_no = 1;
 
 	while ((cmd = PlotCmd_from_tmpfile()) != CMD_EOF)
-		switch (cmd) {
-		case NOP:
-			break;
-		case SET_PEN:
-			if ((pen_no = fgetc(pg->td)) == EOF) {
-				PError("Unexpected end of temp. file");
-				exit(ERROR);
-			}
-			consecutive = 0;
-			break;
-		case DEF_PW:
-			if (!load_pen_width_table(pg->td)) {
-				PError("Unexpected end of temp. file");
-				exit(ERROR);
-			}
-			break;
-		case DEF_PC:
-			if (load_pen_color_table(pg->td) < 0) {
-				PError("Unexpected end of temp. file");
-				exit(ERROR);
-			}
-			consecutive = 0;
-			break;
-		case DEF_LA:
-			if (load_line_attr(pg->td) < 0) {
-				PError("Unexpected end of temp. file");
-				exit(ERROR);
-			}
-			consecutive = 0;
-			break;
-		case MOVE_TO:
-			HPGL_Pt_from_tmpfile(&pt1);
-			HPcoord_to_dotcoord(&pt1, &ref, po);
-			consecutive = 0;
-			break;
-		case DRAW_TO:
-			HPGL_Pt_from_tmpfile(&pt1);
-			HPcoord_to_dotcoord(&pt1, &next, po);
-			line_PicBuf(&ref, &next, pt.width[pen_no],
-				    pt.color[pen_no], consecutive, po);
-			memcpy(&ref, &next, sizeof(ref));
-			consecutive++;
-			break;
-		case PLOT_AT:
-			HPGL_Pt_from_tmpfile(&pt1);
-			HPcoord_to_dotcoord(&pt1, &ref, po);
-			line_PicBuf(&ref, &ref, pt.width[pen_no],
-				    pt.color[pen_no], consecutive, po);
-			consecutive = 0;
-			break;
+		cmd_to_PicBuf(pg, po, cmd);
+	aa_flush();
+}
 
-		default:
-			Eprintf("Illegal cmd in temp. file!\n");
-			exit(ERROR);
-		}
+
+
+void
+cmds_to_PicBuf(const GEN_PAR * pg, const OUT_PAR * po,
+	       const HPGL_Pt * p_ref, int pen, int joins, long n_cmds)
+/**
+ ** Rasterize the next n_cmds commands of the temporary file only,
+ ** e.g. a chunk of it located by a spatial index. The caller positions
+ ** the temp. file, and passes the pen position, the pen number and
+ ** the number of vectors drawn in a row up to that position.
+ ** joins < 0: The commands continue those of the previous call.
+ **/
+{
+	PlotCmd cmd;
+
+	HPcoord_to_dotcoord(p_ref, &ref, po);
+	HPcoord_to_aacoord(p_ref, &aa_ref_x, &aa_ref_y, po);
+	pen_no = pen;
+	if (joins >= 0) {
+		consecutive = joins;
+		murphy_break();	/* Last vector not drawn here   */
+	}
+
+	while (n_cmds-- > 0 && (cmd = PlotCmd_from_tmpfile()) != CMD_EOF)
+		cmd_to_PicBuf(pg, po, cmd);
+	aa_flush();
 }
@@ -1,113 +1,498 @@
 /**
- ** TBI: all PNF stuff goes here
+ ** png.c: libpng interface of the PNG converter (to_png.c)
+ **
+ ** 26/10/19              Images are streamed row by row; palette and
+ **                       grayscale images at their native bit depth
+ ** 26/10/19              Selectable compression level, strategy and
+ **                       filters; parallel deflate of row blocks
  **/
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "to_png.h"
 #include <zlib.h>
 #include <png.h>
+#ifdef THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
-#define PDNCOL 256
 
-void pdImagePNG(im, fd)
-pdImagePtr im;
-FILE *fd;
-{
-	png_structp png_ptr;
-	png_infop info_ptr;
-	png_uint_32 width, height;
-	int bit_depth /*, color_type, interlace_type */ ;
-/*	png_uint_32 num_palette; */
-	struct png_color_struct *palette;
-	int ci;
-	png_bytep *row_pointers;
-
-	/* allocate and init png_struct */
-	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
-					  NULL, NULL, NULL);
-	if (!png_ptr)
-		return;
+/**
+ ** Filter masks of pdCompression: bit n stands for PNG filter type n,
+ ** libpng wants the same bits shifted by 3 (PNG_FILTER_NONE = 0x08 ...)
+ **/
 
-	/* allocate and init png_info */
-	info_ptr = png_create_info_struct(png_ptr);
-	if (!info_ptr) {
-		png_destroy_write_struct(&png_ptr, (png_infopp) NULL);
-		return;
-	}
+#define	PD_FILTER_NONE	0x01
+#define	PD_FILTER_SUB	0x02
+#define	PD_FILTER_PAETH	0x10
 
-	/* set up error handlimg for libpng */
-	
-	if (setjmp(png_jmpbuf(png_ptr))) {
-		png_destroy_write_struct(&png_ptr, &info_ptr);
-		return;
-	}
 
-	png_data_freer(png_ptr, info_ptr, PNG_DESTROY_WILL_FREE_DATA, -1);
-	/* initialize I/O */
-	png_init_io(png_ptr, fd);
+static int png_filters(const pdCompression * pc, int bits_per_pixel)
+/**
+ ** Filters rarely pay off for packed pixels
+ **/
+{
+	if (pc->filters)
+		return pc->filters;
+	if (bits_per_pixel < 8)
+		return PD_FILTER_NONE;
+	return PD_FILTER_NONE | PD_FILTER_SUB | PD_FILTER_PAETH;
+}
+
 
-	/* turn on or off filtering, and/or choose specific filters */
-	png_set_filter(png_ptr, 0,
-		       PNG_FILTER_NONE | PNG_FILTER_SUB |
-		       PNG_FILTER_PAETH);
+
+static void set_png_compression(png_structp png_ptr,
+				const pdCompression * pc,
+				int bits_per_pixel)
+{
+	png_set_filter(png_ptr, 0, png_filters(pc, bits_per_pixel) << 3);
 
 	/* set the zlib compression level */
-	png_set_compression_level(png_ptr, Z_BEST_COMPRESSION);
+	png_set_compression_level(png_ptr, pc->level);
 
 	/* set other zlib parameters */
 	png_set_compression_mem_level(png_ptr, 8);
-	png_set_compression_strategy(png_ptr, Z_DEFAULT_STRATEGY);
+	png_set_compression_strategy(png_ptr, pc->strategy);
 	png_set_compression_window_bits(png_ptr, 15);
 	png_set_compression_method(png_ptr, 8);
 	png_set_compression_buffer_size(png_ptr, 8192);
+}
 
-	width = (png_uint_32) im->sx;
-	height = (png_uint_32) im->sy;
-	bit_depth = 8;		/* for now */
 
-	/* write the image header */
-	png_set_IHDR(png_ptr, info_ptr, width, height, bit_depth,
-		     PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE,
-		     PNG_COMPRESSION_TYPE_DEFAULT,
-		     PNG_FILTER_TYPE_DEFAULT);
 
-	/* allocate palette */
-	palette = png_malloc(png_ptr, PDNCOL * sizeof(png_color));
+#ifdef THREADS
+
+/**
+ ** Parallel deflate, in the manner of pigz: The filtered rows are cut
+ ** into blocks of about PAR_BLOCK bytes, each compressed by a thread of
+ ** its own into a raw deflate stream. A block is primed with the 32K of
+ ** data before it and ends on a byte boundary (sync flush), so the
+ ** blocks simply concatenate. The zlib header and the combined Adler-32
+ ** checksum are added here; each block becomes an IDAT chunk.
+ **/
+
+#define	PAR_BLOCK	(128 * 1024)	/* Uncompressed bytes per block */
+#define	PAR_DICT	(32 * 1024)	/* Deflate window               */
+
+typedef struct {
+	png_bytep in;		/* Filtered rows of this block     */
+	size_t len;
+	size_t dict_len;	/* Bytes before in[] used as dict. */
+	int level, strategy;
+	int last;		/* Block ends the zlib stream      */
+	size_t pre;		/* Room kept for the zlib header   */
+	png_bytep out;		/* pre + compressed data           */
+	size_t out_len, out_size;
+	uLong adler;		/* Adler-32 of in[]                */
+	int err;
+	int threaded;		/* Runs on a thread of its own     */
+} DeflateJob;
+
 
-	/* copy palette data */
-	for (ci = 0; ci < PDNCOL; ci++) {
-		palette[ci].red = (png_byte) im->red[ci];
-		palette[ci].green = (png_byte) im->green[ci];
-		palette[ci].blue = (png_byte) im->blue[ci];
+
+static void *deflate_job(void *arg)
+{
+	DeflateJob *job = (DeflateJob *) arg;
+	z_stream zs;
+	png_bytep p;
+	int ret, flush;
+
+	job->err = 1;
+	job->adler = adler32(adler32(0L, Z_NULL, 0), job->in,
+			     (uInt) job->len);
+	memset(&zs, 0, sizeof(zs));
+	if (deflateInit2(&zs, job->level, Z_DEFLATED, -15, 8,
+			 job->strategy) != Z_OK)
+		return NULL;
+	if (job->dict_len)
+		deflateSetDictionary(&zs, job->in - job->dict_len,
+				     (uInt) job->dict_len);
+
+	/* Room for the header, the data and the trailer or flush marker */
+	job->out_size = job->pre + deflateBound(&zs, (uLong) job->len) + 16;
+	if ((job->out = (png_bytep) malloc(job->out_size)) == NULL) {
+		deflateEnd(&zs);
+		return NULL;
 	}
+	job->out_len = job->pre;
 
-	/* set palette */
-	png_set_PLTE(png_ptr, info_ptr, palette, PDNCOL);
+	zs.next_in = job->in;
+	zs.avail_in = (uInt) job->len;
+	flush = job->last ? Z_FINISH : Z_SYNC_FLUSH;
+	do {
+		if (job->out_len == job->out_size) {
+			if ((p = (png_bytep) realloc(job->out,
+						     2 * job->out_size)) ==
+			    NULL) {
+				deflateEnd(&zs);
+				return NULL;
+			}
+			job->out = p;
+			job->out_size *= 2;
+		}
+		zs.next_out = job->out + job->out_len;
+		zs.avail_out = (uInt) (job->out_size - job->out_len);
+		ret = deflate(&zs, flush);
+		job->out_len = job->out_size - zs.avail_out;
+	} while ((ret == Z_OK || ret == Z_BUF_ERROR) &&
+		 (job->last ? ret != Z_STREAM_END : zs.avail_out == 0));
+	deflateEnd(&zs);
 
-	/* Write the file header information.  REQUIRED */
-	png_write_info(png_ptr, info_ptr);
+	/* Room for the Adler-32 trailer */
+	if (job->last && job->out_size - job->out_len < 4) {
+		if ((p = (png_bytep) realloc(job->out, job->out_len + 4)) ==
+		    NULL)
+			return NULL;
+		job->out = p;
+		job->out_size = job->out_len + 4;
+	}
+	if (ret == Z_OK || ret == Z_STREAM_END)
+		job->err = 0;
+	return NULL;
+}
+
+
+
+static int paeth(int a, int b, int c)
+{
+	int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc =
+	    abs(p - c);
+
+	if (pa <= pb && pa <= pc)
+		return a;
+	return (pb <= pc) ? b : c;
+}
+
+
+
+static void filter_row(png_const_bytep row, png_const_bytep prev,
+		       size_t n, size_t bpp, int filters, png_bytep out,
+		       png_bytep tmp)
+/**
+ ** Filter one row into out[0..n]. If several filters are allowed,
+ ** the one with the least sum of absolute (signed) results wins,
+ ** which is libpng's own choice.
+ **/
+{
+	unsigned long sum, best = 0;
+	png_bytep dst;
+	size_t i;
+	int f, a, c, p, first = 1;
+
+	if (filters == PD_FILTER_NONE) {
+		out[0] = 0;
+		memcpy(out + 1, row, n);
+		return;
+	}
+	for (f = 0; f < 5; f++) {
+		if (!(filters & (1 << f)))
+			continue;
+		dst = first ? out : tmp;
+		dst[0] = (png_byte) f;
+		for (i = 0, sum = 0; i < n; i++) {
+			a = (i >= bpp) ? row[i - bpp] : 0;
+			c = (i >= bpp) ? prev[i - bpp] : 0;
+			switch (f) {
+			case 0:
+				p = 0;
+				break;
+			case 1:
+				p = a;
+				break;
+			case 2:
+				p = prev[i];
+				break;
+			case 3:
+				p = (a + prev[i]) >> 1;
+				break;
+			default:
+				p = paeth(a, prev[i], c);
+				break;
+			}
+			dst[i + 1] = (png_byte) (row[i] - p);
+			sum += (dst[i + 1] < 128) ? dst[i + 1] :
+			    256 - dst[i + 1];
+		}
+		if (first || sum < best) {
+			if (dst != out)
+				memcpy(out, dst, n + 1);
+			best = sum;
+		}
+		first = 0;
+	}
+}
+
+
+
+static int write_parallel(png_structp png_ptr, int sy, size_t stride,
+			  size_t bpp, int filters, int threads,
+			  const pdCompression * pc, pdRowFunc get_row,
+			  void *data)
+/**
+ ** Write the IDAT chunks of all sy rows, with up to 'threads' blocks
+ ** compressed at a time. Returns nonzero on failure.
+ **/
+{
+	DeflateJob *job;
+	pthread_t *tid;
+	png_bytep fbuf, cur, prev, tmp, in;
+	size_t rb, blk, have = 0, total, keep;
+	uLong adler = adler32(0L, Z_NULL, 0);
+	unsigned int head;
+	int rows_per_block, y = 0, r, i, n, err = 0;
+
+	rb = stride + 1;	/* Filter type byte + pixels */
+	rows_per_block = (int) ((PAR_BLOCK + rb - 1) / rb);
+	blk = rows_per_block * rb;
+
+	fbuf = (png_bytep) malloc(PAR_DICT + threads * blk);
+	cur = (png_bytep) malloc(stride);
+	prev = (png_bytep) calloc(stride, 1);
+	tmp = (png_bytep) malloc(rb);
+	job = (DeflateJob *) calloc((size_t) threads, sizeof(DeflateJob));
+	tid = (pthread_t *) malloc(threads * sizeof(pthread_t));
+	if (!fbuf || !cur || !prev || !tmp || !job || !tid) {
+		err = 1;
+		goto PAR_exit;
+	}
 
-	/* pack pixels into bytes */
-	png_set_packing(png_ptr);
+	while (y < sy && !err) {
+		/* Filter the rows of up to 'threads' blocks */
+		for (n = 0; n < threads && y < sy; n++) {
+			in = fbuf + PAR_DICT + n * blk;
+			for (r = 0; r < rows_per_block && y < sy; r++, y++) {
+				get_row(y, cur, data);
+				filter_row(cur, prev, stride, bpp, filters,
+					   in + r * rb, tmp);
+				memcpy(prev, cur, stride);
+			}
+			job[n].in = in;
+			job[n].len = r * rb;
+			job[n].dict_len = have + n * blk;
+			if (job[n].dict_len > PAR_DICT)
+				job[n].dict_len = PAR_DICT;
+			job[n].level = pc->level;
+			job[n].strategy = pc->strategy;
+			job[n].last = (y == sy);
+			job[n].pre = (have == 0 && n == 0) ? 2 : 0;
+			job[n].out = NULL;
+		}
 
-	row_pointers = im->pixels;
+		/* Compress them; run a job here if no thread is left */
+		for (i = 0; i < n; i++) {
+			job[i].threaded = (i < n - 1 &&
+					   pthread_create(&tid[i], NULL,
+							  deflate_job,
+							  &job[i]) == 0);
+			if (!job[i].threaded)
+				deflate_job(&job[i]);
+		}
+		for (i = 0; i < n; i++)
+			if (job[i].threaded)
+				pthread_join(tid[i], NULL);
 
-	/* write whole image */
-	png_write_image(png_ptr, row_pointers);
+		/* Write them in order */
+		for (i = 0; i < n; i++) {
+			if (job[i].err) {
+				err = 1;
+				continue;
+			}
+			adler = adler32_combine(adler, job[i].adler,
+						(z_off_t) job[i].len);
+			if (job[i].pre) {
+				head = (0x78 << 8) | ((pc->level < 0 ? 2 :
+						       pc->level < 2 ? 0 :
+						       pc->level < 6 ? 1 :
+						       pc->level == 6 ? 2 :
+						       3) << 6);
+				head += 31 - head % 31;
+				job[i].out[0] = (png_byte) (head >> 8);
+				job[i].out[1] = (png_byte) head;
+			}
+			if (job[i].last) {
+				job[i].out[job[i].out_len++] =
+				    (png_byte) (adler >> 24);
+				job[i].out[job[i].out_len++] =
+				    (png_byte) (adler >> 16);
+				job[i].out[job[i].out_len++] =
+				    (png_byte) (adler >> 8);
+				job[i].out[job[i].out_len++] = (png_byte) adler;
+			}
+			if (!err)
+				png_write_chunk(png_ptr,
+						(png_const_bytep) "IDAT",
+						job[i].out, job[i].out_len);
+		}
+		for (i = 0; i < n; i++)
+			free(job[i].out);
 
-	/* It is REQUIRED to call this to finish writing the rest of the file */
+		/* The last 32K are the dictionary of the next batch */
+		total = (n - 1) * blk + job[n - 1].len;
+		keep = have + total;
+		if (keep > PAR_DICT)
+			keep = PAR_DICT;
+		memmove(fbuf + PAR_DICT - keep, fbuf + PAR_DICT + total - keep,
+			keep);
+		have = keep;
+	}
+
+      PAR_exit:
+	free(tid);
+	free(job);
+	free(tmp);
+	free(prev);
+	free(cur);
+	free(fbuf);
+	return err;
+}
+
+#endif				/* THREADS */
+
+
+
+static int write_rows(png_structp png_ptr, png_infop info_ptr, int sx,
+		      int sy, int bits_per_pixel, const pdCompression * pc,
+		      pdRowFunc get_row, void *data)
+/**
+ ** Write all rows and the end of the file, using pc->threads threads
+ ** if the image takes more than one block. Returns nonzero on failure.
+ **/
+{
+	png_bytep rowbuf;
+	size_t stride = ((size_t) sx * bits_per_pixel + 7) / 8;
+	int y;
+#ifdef THREADS
+	int threads = pc->threads;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	if (threads == 0)
+		threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (threads > 1 && (size_t) sy * (stride + 1) > PAR_BLOCK) {
+		if (write_parallel(png_ptr, sy, stride,
+				   (bits_per_pixel + 7) / 8,
+				   png_filters(pc, bits_per_pixel), threads, pc,
+				   get_row, data))
+			return 1;
+		/* png_write_end() insists on IDATs written by libpng */
+		png_write_chunk(png_ptr, (png_const_bytep) "IEND", NULL, 0);
+		return 0;
+	}
+#endif
+
+	if ((rowbuf = (png_bytep) malloc(stride)) == NULL)
+		return 1;
+	for (y = 0; y < sy; y++) {
+		get_row(y, rowbuf, data);
+		png_write_row(png_ptr, rowbuf);
+	}
+	free(rowbuf);
 	png_write_end(png_ptr, info_ptr);
+	return 0;
+}
+
+
 
-	/* if you malloced the palette, free it here */
-/*	free(info_ptr->palette);*/
+/**
+ ** True color image, written row by row: get_row() delivers
+ ** sx RGB triplets of row y (counted from the top) into its buffer.
+ ** Returns nonzero on failure.
+ **/
 
-	/* if you allocated any text comments, free them here */
+int pdRGBImagePNG(int sx, int sy, pdRowFunc get_row, void *data,
+		  const pdCompression * pc, FILE * fd)
+{
+	png_structp png_ptr;
+	png_infop info_ptr;
+	int err = 1;
 
-	/* clean up after the write, and free any memory allocated */
-/*	png_destroy_write_struct(&png_ptr, (png_infopp)NULL);*/
+	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+					  NULL, NULL, NULL);
+	if (!png_ptr)
+		return err;
+	info_ptr = png_create_info_struct(png_ptr);
+	if (!info_ptr) {
+		png_destroy_write_struct(&png_ptr, (png_infopp) NULL);
+		return err;
+	}
+	if (setjmp(png_jmpbuf(png_ptr))) {
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+		return err;
+	}
+
+	png_init_io(png_ptr, fd);
+	set_png_compression(png_ptr, pc, 24);
+
+	png_set_IHDR(png_ptr, info_ptr, (png_uint_32) sx,
+		     (png_uint_32) sy, 8, PNG_COLOR_TYPE_RGB,
+		     PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+		     PNG_FILTER_TYPE_DEFAULT);
+	png_write_info(png_ptr, info_ptr);
+
+	err = write_rows(png_ptr, info_ptr, sx, sy, 24, pc, get_row, data);
 	png_destroy_write_struct(&png_ptr, &info_ptr);
-	png_free_data(png_ptr, info_ptr, PNG_FREE_ALL, -1);
-	return;
+	return err;
+}
 
+
+
+/**
+ ** Palette or grayscale image of 1, 2, 4 or 8 bits per pixel, written
+ ** row by row: get_row() delivers row y (counted from the top), packed
+ ** as PNG expects it, i.e. leftmost pixel in the high order bits.
+ ** Without a palette (clut == NULL) the image is grayscale.
+ ** Returns nonzero on failure.
+ **/
+
+int pdIndexImagePNG(int sx, int sy, int bit_depth,
+		    const unsigned char (*clut)[3], int ncolors,
+		    pdRowFunc get_row, void *data,
+		    const pdCompression * pc, FILE * fd)
+{
+	png_structp png_ptr;
+	png_infop info_ptr;
+	png_color palette[PNG_MAX_PALETTE_LENGTH];
+	int i, err = 1;
+
+	if (ncolors > (1 << bit_depth))
+		ncolors = 1 << bit_depth;
+
+	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING,
+					  NULL, NULL, NULL);
+	if (!png_ptr)
+		return err;
+	info_ptr = png_create_info_struct(png_ptr);
+	if (!info_ptr) {
+		png_destroy_write_struct(&png_ptr, (png_infopp) NULL);
+		return err;
+	}
+	if (setjmp(png_jmpbuf(png_ptr))) {
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+		return err;
+	}
+
+	png_init_io(png_ptr, fd);
+	set_png_compression(png_ptr, pc, bit_depth);
+
+	png_set_IHDR(png_ptr, info_ptr, (png_uint_32) sx,
+		     (png_uint_32) sy, bit_depth,
+		     clut ? PNG_COLOR_TYPE_PALETTE : PNG_COLOR_TYPE_GRAY,
+		     PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+		     PNG_FILTER_TYPE_DEFAULT);
+	if (clut) {
+		for (i = 0; i < ncolors; i++) {
+			palette[i].red = clut[i][0];
+			palette[i].green = clut[i][1];
+			palette[i].blue = clut[i][2];
+		}
+		png_set_PLTE(png_ptr, info_ptr, palette, ncolors);
+	}
+	png_write_info(png_ptr, info_ptr);
+
+	err = write_rows(png_ptr, info_ptr, sx, sy, bit_depth, pc, get_row,
+			 data);
+	png_destroy_write_struct(&png_ptr, &info_ptr);
+	return err;
 }
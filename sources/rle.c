@@ -0,0 +1,249 @@
+/*
+   Distributed by Free Software Foundation, Inc.
+
+This file is part of HP2xx.
+
+HP2xx is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY.  No author or distributor accepts responsibility
+to anyone for the consequences of using it or for whether it serves any
+particular purpose or works at all, unless he says so in writing.  Refer
+to the GNU General Public License, Version 2 or later, for full details.
+
+Everyone is granted permission to copy, modify and redistribute
+HP2xx, but only under the conditions described in the GNU General Public
+License.  A copy of this license is supposed to have been
+given to you along with HP2xx so you can know your rights and
+responsibilities.  It should be in a file named COPYING.  Among other
+things, the copyright notice and this notice must be preserved on all
+copies.
+
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+*/
+
+
+/** rle.c: Run finding for the run-length encoders of the raster modes
+ **
+ ** PCL (method #2), Esc/P2, PCX and IMG all look for runs of equal
+ ** bytes in a row. The functions below find them for all of them.
+ ** They compare a machine word (sizeof(unsigned long) bytes) at a
+ ** time and fall back to single bytes only where a word differs,
+ ** so long runs and long literal stretches cost little.
+ **
+ ** Runs of identical rows are found through a hash of each row,
+ ** computed once; rows are compared only if their hashes agree.
+ **
+ ** 26/10/19  V 1.00       Originating (from TIFF_compress() of to_pcl.c)
+ ** 26/10/19  V 1.01       Row hashes, RLE_same_rows()
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bresnham.h"
+#include "hp2xx.h"
+#include "rle.h"
+
+
+#define	WORD	sizeof(unsigned long)
+#define	ONES	((unsigned long) -1 / 0xFF)	/* 0x0101...01 */
+#define	HIGHS	(ONES << 7)	/* 0x8080...80 */
+
+#define	HASH_MUL	0x9E3779B1UL	/* Golden ratio, 32 bit */
+
+/* Non-zero if any byte of w is zero */
+#define	HAS_ZERO(w)	(((w) - ONES) & ~(w) & HIGHS)
+
+
+
+static unsigned long load(const Byte * p)
+{
+	unsigned long w;
+
+	memcpy(&w, p, WORD);	/* No alignment needed */
+	return w;
+}
+
+
+
+int RLE_match(const Byte * a, const Byte * b, int n)
+/**
+ ** Number of leading bytes in which a and b agree (0 ... n).
+ ** The areas may overlap: RLE_match(p, p + k, n) is the length
+ ** of a pattern of period k repeating from p on.
+ **/
+{
+	int i = 0;
+
+	while (i + (int) WORD <= n && load(a + i) == load(b + i))
+		i += WORD;
+	while (i < n && a[i] == b[i])
+		i++;
+	return i;
+}
+
+
+
+int RLE_span(const Byte * p, int nb, Byte c)
+/**
+ ** Number of leading bytes equal to c (0 ... nb)
+ **/
+{
+	unsigned long cw = ONES * c;
+	int i = 0;
+
+	while (i + (int) WORD <= nb && load(p + i) == cw)
+		i += WORD;
+	while (i < nb && p[i] == c)
+		i++;
+	return i;
+}
+
+
+
+int RLE_run(const Byte * p, int nb)
+/**
+ ** Length of the run of bytes equal to p[0] (1 ... nb, 0 if nb == 0)
+ **/
+{
+	return (nb > 0) ? 1 + RLE_match(p, p + 1, nb - 1) : 0;
+}
+
+
+
+int RLE_literal(const Byte * p, int nb)
+/**
+ ** Number of bytes before the next pair of equal bytes,
+ ** i.e. before the next run (nb if there is none)
+ **/
+{
+	int i = 0;
+
+	while (i + (int) WORD < nb && !HAS_ZERO(load(p + i) ^ load(p + i + 1)))
+		i += WORD;
+	for (; i + 1 < nb; i++)
+		if (p[i] == p[i + 1])
+			return i;
+	return nb;
+}
+
+
+
+int RLE_packbits(const Byte * src, int nb, Byte * dst)
+/**
+ ** PackBits coding of nb bytes (TIFF, PCL method #2, Esc/P2):
+ **   -127 ... -1:  Next byte, repeated 2 ... 128 times
+ **      0 ... 127: Next 1 ... 128 bytes literally
+ ** Runs count from 2 bytes on. dst needs room for nb + RLE_EXTRASPACE
+ ** bytes. Return the coded length, or -1 if coding does not pay
+ ** (or would overflow dst).
+ **/
+{
+	int l, count = 0;
+	int extra = RLE_EXTRASPACE;	/* Room left beyond nb bytes */
+
+	while (nb > 0) {
+		l = RLE_run(src, nb);
+		if (l >= 2) {
+			while (l > 0) {
+				/* A remainder of 1 byte becomes a literal */
+				int n = MIN(l, 128);
+
+				*dst++ = (Byte) (1 - n);
+				*dst++ = *src;
+				count += 2;
+				extra += n - 2;
+				src += n;
+				nb -= n;
+				l -= n;
+			}
+			if (nb == 0)
+				return count;
+		}
+
+		l = RLE_literal(src, nb);
+		while (l > 0) {
+			int n = MIN(l, 128);
+
+			if (--extra < 0)
+				return -1;	/* Buffer overflow! */
+			*dst++ = (Byte) (n - 1);
+			memcpy(dst, src, (size_t) n);
+			dst += n;
+			count += n + 1;
+			src += n;
+			nb -= n;
+			l -= n;
+		}
+		if (nb == 0)	/* Nothing gained? */
+			return (extra > RLE_EXTRASPACE) ? count : -1;
+	}
+	return count;
+}
+
+
+
+unsigned long RLE_hash(const Byte * p, int nb)
+/**
+ ** Hash of nb bytes, a word at a time (multiply & xor-shift)
+ **/
+{
+	unsigned long h = (unsigned long) nb;
+	int i = 0;
+
+	for (; i + (int) WORD <= nb; i += WORD) {
+		h = (h ^ load(p + i)) * HASH_MUL;
+		h ^= h >> 15;
+	}
+	for (; i < nb; i++)
+		h = (h ^ p[i]) * HASH_MUL;
+	return h ^ (h >> 15);
+}
+
+
+
+unsigned long *RLE_hash_rows(const PicBuf * pb)
+/**
+ ** Hashes of all rows of a picture buffer, in one pass over it.
+ ** The caller frees the array. NULL if out of memory.
+ **/
+{
+	unsigned long *hash;
+	const RowBuf *row;
+	int i, n = pb->nb * pb->depth;
+
+	if ((hash = (unsigned long *) malloc((size_t) pb->nr *
+					     sizeof(unsigned long))) == NULL)
+		return NULL;
+	for (i = 0; i < pb->nr; i++) {
+		row = get_RowBuf(pb, i);
+		hash[i] = (row == NULL) ? 0 : RLE_hash(row->buf, n);
+	}
+	return hash;
+}
+
+
+
+int RLE_same_rows(const PicBuf * pb, const unsigned long *hash, int row,
+		  int dir, int max)
+/**
+ ** Number of rows following row (in direction dir = +1 or -1) which
+ ** are identical to it, at most max. Each row is compared with its
+ ** predecessor, so no more than two rows are needed at a time (rows
+ ** may be swapped out). Without hashes, all rows are compared.
+ **/
+{
+	const RowBuf *a, *b;
+	int k, r, n = pb->nb * pb->depth;
+
+	for (k = 0, r = row + dir; k < max && r >= 0 && r < pb->nr;
+	     k++, r += dir) {
+		if (hash != NULL && hash[r] != hash[r - dir])
+			break;
+		a = get_RowBuf(pb, r - dir);
+		b = get_RowBuf(pb, r);
+		if (a == NULL || b == NULL
+		    || memcmp(a->buf, b->buf, (size_t) n))
+			break;
+	}
+	return k;
+}
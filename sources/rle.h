@@ -0,0 +1,44 @@
+/*
+   Distributed by Free Software Foundation, Inc.
+
+This file is part of HP2xx.
+
+HP2xx is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY.  No author or distributor accepts responsibility
+to anyone for the consequences of using it or for whether it serves any
+particular purpose or works at all, unless he says so in writing.  Refer
+to the GNU General Public License, Version 2 or later, for full details.
+
+Everyone is granted permission to copy, modify and redistribute
+HP2xx, but only under the conditions described in the GNU General Public
+License.  A copy of this license is supposed to have been
+given to you along with HP2xx so you can know your rights and
+responsibilities.  It should be in a file named COPYING.  Among other
+things, the copyright notice and this notice must be preserved on all
+copies.
+
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+*/
+
+
+/** rle.h: Run finding for the run-length encoders of the raster modes,
+ **        within rows and across rows
+ **/
+
+#ifndef __RLE_H
+#define __RLE_H
+
+#define	RLE_EXTRASPACE	16	/* RLE_packbits() may need nb + this */
+
+int RLE_match(const Byte * a, const Byte * b, int n);
+int RLE_span(const Byte * p, int nb, Byte c);
+int RLE_run(const Byte * p, int nb);
+int RLE_literal(const Byte * p, int nb);
+int RLE_packbits(const Byte * src, int nb, Byte * dst);
+
+unsigned long RLE_hash(const Byte * p, int nb);
+unsigned long *RLE_hash_rows(const PicBuf * pb);
+int RLE_same_rows(const PicBuf * pb, const unsigned long *hash, int row,
+		  int dir, int max);
+
+#endif /* __RLE_H */
@@ -44,6 +44,12 @@ extern mode_list ModeList[];
 
 static short Logfile_flag = FALSE;
 
+/* Names of zlib strategies (Z_DEFAULT_STRATEGY ...) and PNG filters */
+static const char *png_strategy_names[] =
+    { "default", "filtered", "huffman", "rle", "fixed", NULL };
+static const char *png_filter_names[] =
+    { "none", "sub", "up", "avg", "paeth", NULL };
+
 
 
 
@@ -139,7 +145,9 @@ void action_oldstyle(GEN_PAR * pg, IN_PAR * pi, OUT_PAR * po)
 		}
 		if (strcmp(pg->mode, "pre")) {
 			po->pagecount++;
-			if ( ( *(po->outfile) != '-' ) && po->pagecount > 0) {
+			/* TIFF and PDF keep all pages in one file */
+			if ( ( *(po->outfile) != '-' ) && po->pagecount > 0
+			    && pg->xx_mode != XX_TIFF && pg->xx_mode != XX_PDF) {
 				sprintf(thepage, "%d", po->pagecount);
 				strcpy(po->outfile, savedname);
 				if (strstr(po->outfile, pg->mode))
@@ -188,11 +196,46 @@ void action_oldstyle(GEN_PAR * pg, IN_PAR * pi, OUT_PAR * po)
 		cleanup_g(pg);
 		cleanup_o(po);
 	}
+#ifdef TIF
+	if (pg->xx_mode == XX_TIFF)
+		TIF_close(pg);
+#endif
 	if (ret_file)
 		fclose(ret_file);
 }
 
 
+static int png_filter_mask(const char *s)
+/**
+ ** Comma-separated list of PNG filter names, "all", or "auto" (0).
+ ** Returns -1 if a name is unknown.
+ **/
+{
+	int i, mask = 0;
+	size_t n;
+
+	if (strcmp(s, "auto") == 0)
+		return 0;
+	if (strcmp(s, "all") == 0)
+		return 0x1F;
+	while (*s) {
+		n = strcspn(s, ",");
+		for (i = 0; png_filter_names[i] != NULL; i++)
+			if (strlen(png_filter_names[i]) == n &&
+			    strncmp(s, png_filter_names[i], n) == 0)
+				break;
+		if (png_filter_names[i] == NULL)
+			return -1;
+		mask |= 1 << i;
+		s += n;
+		if (*s == ',')
+			s++;
+	}
+	return mask ? mask : -1;
+}
+
+
+
 static void
 process_opts(int argc, char *argv[],
 	     const char *shortopts, struct option longopts[],
@@ -469,6 +512,86 @@ process_opts(int argc, char *argv[],
 			pi->truesize = TRUE;
 			break;
 
+		case 'k':
+			pi->crop = TRUE;
+			break;
+
+		case 'A':
+			pg->antialias = TRUE;
+			break;
+
+		case 'G':
+			pg->simplify = TRUE;
+			break;
+
+		case 'g':
+			pg->simplify_tol = atof(optarg);
+			if (pg->simplify_tol < 0.0) {
+				Eprintf("Simplification tolerance: %g illegal\n",
+					pg->simplify_tol);
+				exit(ERROR);
+			}
+			pg->simplify = TRUE;
+			break;
+
+		case 'T':
+			pg->stroke_text = TRUE;
+			break;
+
+		case 'R':
+			if (optarg == NULL || strcmp(optarg, "table") == 0)
+				pg->profile = 1;
+			else if (strcmp(optarg, "json") == 0)
+				pg->profile = 2;
+			else {
+				Eprintf("Invalid profile format: %s\n",
+					optarg);
+				exit(ERROR);
+			}
+			break;
+
+		case 'L':
+			po->png_level = atoi(optarg);
+			if (po->png_level < 0 || po->png_level > 9) {
+				Eprintf("PNG compression level: %d illegal\n",
+					po->png_level);
+				exit(ERROR);
+			}
+			break;
+
+		case 'U':
+			for (i = 0; png_strategy_names[i] != NULL; i++)
+				if (strcmp(optarg, png_strategy_names[i]) == 0)
+					break;
+			if (png_strategy_names[i] == NULL) {
+				Eprintf("Invalid PNG compression strategy: %s\n",
+					optarg);
+				exit(ERROR);
+			}
+			po->png_strategy = i;
+			break;
+
+		case 'E':
+			if ((po->png_filter = png_filter_mask(optarg)) < 0) {
+				Eprintf("Invalid PNG filter: %s\n", optarg);
+				exit(ERROR);
+			}
+			break;
+
+		case 'j':
+			po->threads = atoi(optarg);
+			if (po->threads < 0) {
+				Eprintf("Number of threads: %d illegal\n",
+					po->threads);
+				exit(ERROR);
+			}
+#ifndef THREADS
+			if (po->threads != 1)
+				Eprintf
+				    ("Warning: No thread support, -j ignored\n");
+#endif
+			break;
+
 		case 'V':
 			po->vga_mode = (Byte) atoi(optarg);
 			break;
@@ -531,7 +654,7 @@ int main(int argc, char *argv[])
 	char outname[256] = "";
 
 	char *shortopts =
-	    "a:c:d:D:e:f:h:l:m:M:o:O:p:P:r:s:S:V:w:x:X:y:Y:z:Z:CFH:W:inqtvNI?";
+	    "a:c:d:D:e:E:f:g:h:j:l:L:m:M:o:O:p:P:r:s:S:U:V:w:x:X:y:Y:z:Z:ACFGH:R::TW:iknqtvNI?";
 	struct option longopts[] = {
 		{"mode", 1, NULL, 'm'},
 		{"pencolors", 1, NULL, 'c'},
@@ -541,17 +664,27 @@ int main(int argc, char *argv[])
 		{"nofill", 0, NULL, 'n'},
 		{"no_ps", 0, NULL, 'N'},
 		{"mapzero", 1, NULL, 'M'},
+		{"simplify", 0, NULL, 'G'},
+		{"simplify_tol", 1, NULL, 'g'},
+		{"stroke_text", 0, NULL, 'T'},
+		{"profile", 2, NULL, 'R'},
 
 		{"DPI", 1, NULL, 'd'},
 		{"DPI_x", 1, NULL, 'd'},
 		{"DPI_y", 1, NULL, 'D'},
 		{"extraclip", 1, NULL, 'e'},
+		{"antialias", 0, NULL, 'A'},
 
 		{"PCL_formfeed", 0, NULL, 'F'},
 		{"PCL_init", 0, NULL, 'i'},
 		{"PCL_Deskjet", 1, NULL, 'S'},
 		{"PCL_PCL3GUI", 0, NULL, 'I'},
 
+		{"png_level", 1, NULL, 'L'},
+		{"png_strategy", 1, NULL, 'U'},
+		{"png_filter", 1, NULL, 'E'},
+		{"threads", 1, NULL, 'j'},
+
 		{"outfile", 1, NULL, 'f'},
 		{"logfile", 1, NULL, 'l'},
 		{"swapfile", 1, NULL, 's'},
@@ -565,6 +698,7 @@ int main(int argc, char *argv[])
 		{"x1", 1, NULL, 'X'},
 		{"y0", 1, NULL, 'y'},
 		{"y1", 1, NULL, 'Y'},
+		{"crop", 0, NULL, 'k'},
 		{"zengage", 1, NULL, 'z'},
 		{"zretract", 1, NULL, 'Z'},
 
@@ -611,6 +745,9 @@ int main(int argc, char *argv[])
 	if (Po.dpi_y == 0)
 		Po.dpi_y = Po.dpi_x;
 
+	/* Arcs: chord error of raster modes within a quarter dot */
+	Pg.chord_tol = 25.4 / (4.0 * MAX(Po.dpi_x, Po.dpi_y));
+
 	Po.pagecount = -1;
 	if (strlen(Po.outfile) > 0)
 		strcpy(outname, Po.outfile);	/* store fixed outfile name if present */
@@ -641,6 +778,10 @@ int main(int argc, char *argv[])
 			reset_par(&Pi);
 		}
 	
+#ifdef USEPDF
+	if (Pg.xx_mode == XX_PDF)
+		pdf_close(&Pg);	/* Documents may span input files */
+#endif
 	cleanup(&Pg, &Pi, &Po);
 	if (!strcmp(Pg.mode, "pre"))
 		free(Po.outfile);
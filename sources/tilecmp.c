@@ -0,0 +1,209 @@
+/*
+   Distributed by Free Software Foundation, Inc.
+
+This file is part of HP2xx.
+
+HP2xx is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY.  No author or distributor accepts responsibility
+to anyone for the consequences of using it or for whether it serves any
+particular purpose or works at all, unless he says so in writing.  Refer
+to the GNU General Public License, Version 2 or later, for full details.
+
+Everyone is granted permission to copy, modify and redistribute
+HP2xx, but only under the conditions described in the GNU General Public
+License.  A copy of this license is supposed to have been
+given to you along with HP2xx so you can know your rights and
+responsibilities.  It should be in a file named COPYING.  Among other
+things, the copyright notice and this notice must be preserved on all
+copies.
+
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+*/
+
+/** tilecmp.c: Test helper for "make check-tiles" and "make check-simplify"
+ **
+ **   tilecmp  ref.png  other.png  [x0 y0]
+ **   tilecmp  ref.png  tiledir
+ **
+ ** Compares the pixels of two PNG files, or of a PNG file and the
+ ** deepest zoom level of a tile pyramid (mode tiles) stitched together.
+ ** Given x0 and y0, other.png is a section of ref.png starting at that
+ ** column and row, e.g. one cropped by option -k.
+ ** Pixels of missing tiles must be white. Prints the number of
+ ** differing pixels; exit code 0 if there are none.
+ **
+ ** 26/10/19  V 1.00       Originating
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <png.h>
+
+#define	TILE_SIZE	256	/* As in to_tiles.c */
+
+
+typedef struct {
+	int w, h;
+	png_bytep *rows;	/* 8 bit RGB */
+} Image;
+
+
+
+static int read_png(const char *name, Image * im)
+/**
+ ** Any PNG, expanded to 8 bit RGB. Returns 0 if ok.
+ **/
+{
+	FILE *fd;
+	png_structp png;
+	png_infop info;
+	png_byte color_type, depth;
+	int y;
+
+	if ((fd = fopen(name, "rb")) == NULL) {
+		perror(name);
+		return 1;
+	}
+	png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL,
+				     NULL);
+	info = png_create_info_struct(png);
+	if (setjmp(png_jmpbuf(png))) {
+		fprintf(stderr, "%s: not a valid PNG file\n", name);
+		fclose(fd);
+		return 1;
+	}
+	png_init_io(png, fd);
+	png_read_info(png, info);
+	color_type = png_get_color_type(png, info);
+	depth = png_get_bit_depth(png, info);
+	if (color_type == PNG_COLOR_TYPE_PALETTE)
+		png_set_palette_to_rgb(png);
+	if (color_type == PNG_COLOR_TYPE_GRAY && depth < 8)
+		png_set_expand_gray_1_2_4_to_8(png);
+	if (depth == 16)
+		png_set_strip_16(png);
+	if (color_type & PNG_COLOR_MASK_ALPHA)
+		png_set_strip_alpha(png);
+	if (color_type == PNG_COLOR_TYPE_GRAY
+	    || color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+		png_set_gray_to_rgb(png);
+	png_read_update_info(png, info);
+
+	im->w = (int) png_get_image_width(png, info);
+	im->h = (int) png_get_image_height(png, info);
+	im->rows = (png_bytep *) malloc(im->h * sizeof(png_bytep));
+	for (y = 0; y < im->h; y++)
+		im->rows[y] = (png_bytep) malloc(3 * (size_t) im->w);
+	png_read_image(png, im->rows);
+	png_read_end(png, NULL);
+	png_destroy_read_struct(&png, &info, NULL);
+	fclose(fd);
+	return 0;
+}
+
+
+
+static void free_png(Image * im)
+{
+	int y;
+
+	for (y = 0; y < im->h; y++)
+		free(im->rows[y]);
+	free(im->rows);
+}
+
+
+
+static long compare(const Image * ref, const Image * im, int x0, int y0)
+/**
+ ** Differing pixels of im placed at (x0,y0) in ref; parts of
+ ** im outside of ref must be white.
+ **/
+{
+	const png_byte *p, *q;
+	long n = 0;
+	int x, y;
+
+	for (y = 0; y < im->h; y++)
+		for (x = 0; x < im->w; x++) {
+			q = im->rows[y] + 3 * x;
+			if (x0 + x >= 0 && x0 + x < ref->w &&
+			    y0 + y >= 0 && y0 + y < ref->h) {
+				p = ref->rows[y0 + y] + 3 * (x0 + x);
+				n += memcmp(p, q, 3) != 0;
+			} else
+				n += (q[0] & q[1] & q[2]) != 255;
+		}
+	return n;
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	Image ref, im;
+	struct stat st;
+	char name[1024];
+	png_bytep row;
+	long diff = 0;
+	int z, tx, ty, x, y;
+
+	if (argc != 3 && argc != 5) {
+		fprintf(stderr,
+			"usage: tilecmp ref.png {other.png [x0 y0]|tiledir}\n");
+		return 2;
+	}
+	if (read_png(argv[1], &ref))
+		return 2;
+
+	if (stat(argv[2], &st) == 0 && !S_ISDIR(st.st_mode)) {
+		if (read_png(argv[2], &im))
+			return 2;
+		if (argc == 5)
+			diff = compare(&ref, &im, atoi(argv[3]),
+				       atoi(argv[4]));
+		else if (im.w != ref.w || im.h != ref.h) {
+			fprintf(stderr, "%s: %d x %d, not %d x %d\n",
+				argv[2], im.w, im.h, ref.w, ref.h);
+			return 1;
+		} else
+			diff = compare(&ref, &im, 0, 0);
+		free_png(&im);
+	} else {
+		for (z = 0;; z++) {	/* Deepest level */
+			sprintf(name, "%s/%d", argv[2], z + 1);
+			if (stat(name, &st) != 0)
+				break;
+		}
+		for (ty = 0; ty * TILE_SIZE < ref.h; ty++)
+			for (tx = 0; tx * TILE_SIZE < ref.w; tx++) {
+				sprintf(name, "%s/%d/%d/%d.png", argv[2], z,
+					tx, ty);
+				if (stat(name, &st) == 0) {
+					if (read_png(name, &im))
+						return 2;
+					diff += compare(&ref, &im,
+							tx * TILE_SIZE,
+							ty * TILE_SIZE);
+					free_png(&im);
+					continue;
+				}
+				/* Missing tile: blank */
+				for (y = ty * TILE_SIZE;
+				     y < ref.h && y < (ty + 1) * TILE_SIZE;
+				     y++)
+					for (x = tx * TILE_SIZE, row = ref.rows[y];
+					     x < ref.w && x < (tx + 1) * TILE_SIZE;
+					     x++)
+						diff += (row[3 * x] &
+							 row[3 * x + 1] &
+							 row[3 * x + 2]) != 255;
+			}
+	}
+	free_png(&ref);
+	printf("%s: %ld pixels differ\n", argv[2], diff);
+	return diff != 0;
+}
@@ -0,0 +1,497 @@
+/*
+   Distributed by Free Software Foundation, Inc.
+
+This file is part of HP2xx.
+
+HP2xx is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY.  No author or distributor accepts responsibility
+to anyone for the consequences of using it or for whether it serves any
+particular purpose or works at all, unless he says so in writing.  Refer
+to the GNU General Public License, Version 2 or later, for full details.
+
+Everyone is granted permission to copy, modify and redistribute
+HP2xx, but only under the conditions described in the GNU General Public
+License.  A copy of this license is supposed to have been
+given to you along with HP2xx so you can know your rights and
+responsibilities.  It should be in a file named COPYING.  Among other
+things, the copyright notice and this notice must be preserved on all
+copies.
+
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+*/
+
+/** tmpindex.c: Spatial index over the commands of the temp. file
+ **
+ ** While the parser writes the temp. file, its commands are grouped
+ ** into chunks of at most CHUNK_CMDS commands. Each chunk records its
+ ** file position, the bounding box of its vectors and the pen state
+ ** needed to replay it on its own. A pen move far away from the
+ ** current chunk starts a new one, so chunks stay spatially compact.
+ **
+ ** Consumers use the index in two ways:
+ **   - Tiled output replays just the chunks touching each tile.
+ **   - With a window set, PlotCmd_from_tmpfile() passes sequential
+ **     readers only the chunks touching the window (plus all pen and
+ **     line attribute changes), seeking over the rest.
+ **
+ ** 26/10/19  V 1.00       Originating (index moved here from to_tiles.c)
+ ** 26/10/19  V 1.01       FILL_POLY records
+ ** 26/10/19  V 1.02       ARC and CUBIC records
+ ** 26/10/19  V 1.03       TEXT records
+ ** 26/10/19  V 1.04       Joined vectors counted for exact replay
+ ** 26/10/19  V 1.05       joins_from_TmpIndex()
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bresnham.h"
+#include "hp2xx.h"
+#include "pendef.h"
+#include "tmpindex.h"
+
+
+Chunk *chunks = NULL;
+int n_chunks = 0;
+long *state_cmds = NULL;
+int n_state_cmds = 0;
+
+static int failed = FALSE;	/* Out of memory: index unusable        */
+static PlotCmd last_cmd = NOP;	/* Command waiting for its point        */
+static HPGL_Pt pos = { 0, 0 };	/* Pen position after last command      */
+static int cur_pen = 1;		/* Pen selected after last command      */
+static int joins = 0;		/* Vectors drawn in a row so far        */
+
+static int windowed = FALSE;	/* Reading restricted to a window       */
+static float wxmin, wymin, wxmax, wymax, wmargin;
+static int cursor = 0;		/* Chunk of the current read position   */
+static int hidden = FALSE;	/* Chunks outside the window were left  */
+static int skipping = FALSE;	/* Current chunk lies outside window    */
+static int moved = FALSE;	/* Pending MOVE_TO to a chunk's ref.    */
+static HPGL_Pt move_pt;
+static int move_joins = 0;	/* Joins of the vectors leading to it   */
+
+
+
+void reset_TmpIndex(void)
+/**
+ ** Start indexing a new temp. file. Memory is kept for re-use.
+ **/
+{
+	n_chunks = n_state_cmds = 0;
+	failed = FALSE;
+	last_cmd = NOP;
+	pos.x = pos.y = 0;
+	cur_pen = 1;
+	joins = 0;
+	clear_TmpIndex_window();
+}
+
+
+
+void free_TmpIndex(void)
+{
+	free(chunks);
+	free(state_cmds);
+	chunks = NULL;
+	state_cmds = NULL;
+	n_chunks = n_state_cmds = 0;
+	windowed = FALSE;
+}
+
+
+
+static void index_failed(void)
+{
+	Eprintf("\nNo memory for temp. file index - index disabled\n");
+	failed = TRUE;
+	n_chunks = n_state_cmds = 0;
+}
+
+
+
+static Chunk *new_chunk(long offset)
+{
+	Chunk *p;
+
+	if ((n_chunks & 1023) == 0) {
+		p = (Chunk *) realloc(chunks,
+				      (n_chunks + 1024) * sizeof(Chunk));
+		if (p == NULL) {
+			index_failed();
+			return NULL;
+		}
+		chunks = p;
+	}
+	p = chunks + n_chunks++;
+	p->offset = offset;
+	p->n_cmds = 0;
+	p->ref = pos;
+	p->pen_no = cur_pen;
+	p->joins = joins;
+	p->drawn = FALSE;
+	p->state = FALSE;
+	p->maxwidth = 0.0;
+	return p;
+}
+
+
+
+static void grow_chunk(Chunk * c, const HPGL_Pt * p)
+{
+	if (!c->drawn) {
+		c->xmin = c->xmax = p->x;
+		c->ymin = c->ymax = p->y;
+		c->drawn = TRUE;
+	} else {
+		c->xmin = MIN(c->xmin, p->x);
+		c->xmax = MAX(c->xmax, p->x);
+		c->ymin = MIN(c->ymin, p->y);
+		c->ymax = MAX(c->ymax, p->y);
+	}
+	c->maxwidth = MAX(c->maxwidth, pt.width[cur_pen]);
+}
+
+
+
+static int far_from_chunk(const Chunk * c, const HPGL_Pt * p)
+/**
+ ** A pen move leaving the neighbourhood of the chunk's vectors
+ ** starts a new chunk, keeping chunks spatially compact.
+ **/
+{
+	float d;
+
+	if (!c->drawn)
+		return FALSE;
+	d = MAX(c->xmax - c->xmin, c->ymax - c->ymin);
+	return p->x < c->xmin - d || p->x > c->xmax + d ||
+	    p->y < c->ymin - d || p->y > c->ymax + d;
+}
+
+
+
+static Chunk *chunk_for(PlotCmd cmd, const HPGL_Pt * p, FILE * td,
+			long back)
+/**
+ ** Chunk receiving the next command. Positions are queried only
+ ** when a chunk starts, "back" bytes of it being written already.
+ **/
+{
+	Chunk *c;
+
+	if (failed)
+		return NULL;
+	c = (n_chunks > 0) ? chunks + n_chunks - 1 : NULL;
+	if (c == NULL || c->n_cmds >= CHUNK_CMDS ||
+	    (cmd == MOVE_TO && far_from_chunk(c, p)))
+		c = new_chunk(ftell(td) - back);
+	if (c != NULL)
+		c->n_cmds++;
+	return c;
+}
+
+
+
+void cmd_to_TmpIndex(PlotCmd cmd, FILE * td)
+/**
+ ** Called before writing cmd. Vector commands are indexed
+ ** together with their point, see pt_to_TmpIndex().
+ **/
+{
+	Chunk *c;
+	long *p;
+
+	last_cmd = cmd;
+	if (cmd == MOVE_TO || cmd == DRAW_TO || cmd == PLOT_AT
+	    || cmd == FILL_POLY || cmd == ARC || cmd == CUBIC || cmd == TEXT)
+		return;
+	if ((c = chunk_for(cmd, NULL, td, 0L)) == NULL)
+		return;
+	if (cmd == DEF_PC || cmd == DEF_LA)
+		joins = 0;	/* As in cmd_to_PicBuf()        */
+	if (cmd != DEF_PW && cmd != DEF_PC && cmd != DEF_LA && cmd != DEF_LT)
+		return;
+
+	c->state = TRUE;
+	if ((n_state_cmds & 255) == 0) {
+		p = (long *) realloc(state_cmds,
+				     (n_state_cmds + 256) * sizeof(long));
+		if (p == NULL) {
+			index_failed();
+			return;
+		}
+		state_cmds = p;
+	}
+	state_cmds[n_state_cmds++] = ftell(td);
+}
+
+
+
+void pt_to_TmpIndex(const HPGL_Pt * p, FILE * td)
+/**
+ ** Called before writing the point of a MOVE_TO, DRAW_TO or PLOT_AT
+ **/
+{
+	Chunk *c;
+
+	if ((c = chunk_for(last_cmd, p, td, 1L)) == NULL)
+		return;
+	switch (last_cmd) {
+	case DRAW_TO:
+		grow_chunk(c, &pos);
+		grow_chunk(c, p);
+		joins++;
+		break;
+	case PLOT_AT:
+		grow_chunk(c, p);
+		/* Fall through */
+	default:
+		joins = 0;
+		break;
+	}
+	pos = *p;
+}
+
+
+
+void poly_to_TmpIndex(const HPGL_Pt * p, int n, FILE * td)
+/**
+ ** Called before writing the n points of a FILL_POLY.
+ ** Filling leaves the pen where it was.
+ **/
+{
+	Chunk *c;
+
+	if ((c = chunk_for(FILL_POLY, NULL, td, 1L)) == NULL)
+		return;
+	while (n-- > 0)
+		grow_chunk(c, p++);
+	joins = 0;
+}
+
+
+
+void curve_to_TmpIndex(const HPGL_Pt * p, int n, const HPGL_Pt * end,
+		       FILE * td)
+/**
+ ** Called before writing an ARC, CUBIC or TEXT record. The curve runs
+ ** from the pen position to end; the n points p enclose it. A label
+ ** leaves the pen at its origin end.
+ **/
+{
+	Chunk *c;
+
+	if ((c = chunk_for(last_cmd, end, td, 1L)) == NULL)
+		return;
+	grow_chunk(c, &pos);
+	while (n-- > 0)
+		grow_chunk(c, p++);
+	grow_chunk(c, end);
+	pos = *end;
+	joins = 0;
+}
+
+
+
+void pen_to_TmpIndex(int pen, FILE * td)
+/**
+ ** Called before writing a SET_PEN command
+ **/
+{
+	Chunk *c;
+
+	if ((c = chunk_for(SET_PEN, NULL, td, 0L)) != NULL)
+		c->state = TRUE;
+	cur_pen = pen;
+	joins = 0;
+}
+
+
+
+void
+set_TmpIndex_window(double xmin, double ymin, double xmax, double ymax,
+		    double margin)
+/**
+ ** Restrict sequential reading of the temp. file to chunks touching
+ ** the given range. Chunk boxes are widened by their pen width,
+ ** but at least by margin (all in HP-GL units).
+ **/
+{
+	if (failed)
+		return;
+	wxmin = (float) xmin;
+	wymin = (float) ymin;
+	wxmax = (float) xmax;
+	wymax = (float) ymax;
+	wmargin = (float) margin;
+	windowed = TRUE;
+	cursor = 0;
+	hidden = skipping = moved = FALSE;
+	move_joins = 0;
+}
+
+
+
+void clear_TmpIndex_window(void)
+{
+	windowed = FALSE;
+	hidden = skipping = moved = FALSE;
+	move_joins = 0;
+}
+
+
+
+int TmpIndex_windowed(void)
+{
+	return windowed;
+}
+
+
+
+static int in_window(const Chunk * c)
+{
+	float d;
+
+	if (!c->drawn)
+		return FALSE;
+	d = MAX(wmargin, c->maxwidth / 0.025);
+	return c->xmax + d >= wxmin && c->xmin - d <= wxmax &&
+	    c->ymax + d >= wymin && c->ymin - d <= wymax;
+}
+
+
+
+static int find_chunk(long offset)
+/**
+ ** Index of the chunk containing file position offset.
+ ** Sequential reading just steps ahead; anything else searches.
+ **/
+{
+	int lo, hi, mid;
+
+	if (cursor + 1 < n_chunks && chunks[cursor + 1].offset <= offset
+	    && (cursor + 2 >= n_chunks || chunks[cursor + 2].offset > offset))
+		return ++cursor;
+	if (cursor < n_chunks && chunks[cursor].offset <= offset
+	    && (cursor + 1 >= n_chunks || chunks[cursor + 1].offset > offset))
+		return cursor;
+
+	lo = 0;
+	hi = n_chunks - 1;
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (chunks[mid].offset <= offset)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return cursor = lo;
+}
+
+
+
+int cmd_from_TmpIndex(FILE * td)
+/**
+ ** Read the next command for a windowed reader. Chunks outside the
+ ** window are skipped; if they change pen or line attributes, only
+ ** their vectors are dropped. Reading resumes at the next visible
+ ** chunk with a MOVE_TO to its start (see pt_from_TmpIndex()).
+ ** Fills, curves and labels count as vectors.
+ **/
+{
+	const Chunk *c;
+	HPGL_Text text;
+	long offset;
+	int cmd, n;
+
+	for (;;) {
+		offset = ftell(td);
+		if (offset == 0L)	/* Rewound for another pass     */
+			hidden = skipping = FALSE;
+		if (n_chunks > 0 && offset >= chunks[0].offset) {
+			c = chunks + find_chunk(offset);
+			if (offset == c->offset) {
+				if (!in_window(c)) {
+					hidden = TRUE;
+					if (!c->state) {
+						if (c + 1 < chunks + n_chunks)
+							fseek(td, c[1].offset,
+							      SEEK_SET);
+						else
+							fseek(td, 0L, SEEK_END);
+						continue;
+					}
+					skipping = TRUE;
+				} else {
+					skipping = FALSE;
+					if (hidden) {
+						hidden = FALSE;
+						moved = TRUE;
+						move_pt = c->ref;
+						move_joins = c->joins;
+						return MOVE_TO;
+					}
+				}
+			}
+		}
+
+		cmd = fgetc(td);
+		move_joins = 0;
+		if (!skipping)
+			return cmd;
+		switch (cmd) {
+		case MOVE_TO:
+		case DRAW_TO:
+		case PLOT_AT:
+			fseek(td, (long) sizeof(HPGL_Pt), SEEK_CUR);
+			break;
+		case FILL_POLY:
+			if (fread((void *) &n, sizeof(n), 1, td) != 1)
+				return EOF;
+			fseek(td, (long) n * (long) sizeof(HPGL_Pt), SEEK_CUR);
+			break;
+		case ARC:
+			fseek(td, (long) sizeof(HPGL_Arc), SEEK_CUR);
+			break;
+		case CUBIC:
+			fseek(td, 3L * (long) sizeof(HPGL_Pt), SEEK_CUR);
+			break;
+		case TEXT:
+			if (fread((void *) &text, sizeof(text), 1, td) != 1)
+				return EOF;
+			fseek(td, (long) text.n, SEEK_CUR);
+			break;
+		case NOP:
+			break;
+		default:	/* Pen & line attributes, EOF   */
+			return cmd;
+		}
+	}
+}
+
+
+
+int pt_from_TmpIndex(HPGL_Pt * p)
+/**
+ ** Supply the point of a MOVE_TO made up by cmd_from_TmpIndex()
+ **/
+{
+	if (!moved)
+		return FALSE;
+	*p = move_pt;
+	moved = FALSE;
+	return TRUE;
+}
+
+
+
+int joins_from_TmpIndex(void)
+/**
+ ** Vectors drawn in a row up to the last MOVE_TO: Non-zero only for
+ ** one made up by cmd_from_TmpIndex() in the middle of a polyline.
+ ** The rasterizer then continues counting, so that mitres are drawn
+ ** exactly as in a plot of the complete file.
+ **/
+{
+	return move_joins;
+}
@@ -0,0 +1,67 @@
+/*
+   Distributed by Free Software Foundation, Inc.
+
+This file is part of HP2xx.
+
+HP2xx is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY.  No author or distributor accepts responsibility
+to anyone for the consequences of using it or for whether it serves any
+particular purpose or works at all, unless he says so in writing.  Refer
+to the GNU General Public License, Version 2 or later, for full details.
+
+Everyone is granted permission to copy, modify and redistribute
+HP2xx, but only under the conditions described in the GNU General Public
+License.  A copy of this license is supposed to have been
+given to you along with HP2xx so you can know your rights and
+responsibilities.  It should be in a file named COPYING.  Among other
+things, the copyright notice and this notice must be preserved on all
+copies.
+
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+*/
+
+#ifndef __TMPINDEX_H
+#define __TMPINDEX_H
+
+#define	CHUNK_CMDS	64	/* Max. number of commands per chunk    */
+
+/**
+ ** A chunk is a run of consecutive commands of the temp. file,
+ ** together with everything needed to replay it in isolation.
+ **/
+
+typedef struct {
+	long offset;		/* Temp. file position of first command */
+	long n_cmds;		/* Number of commands in this chunk     */
+	HPGL_Pt ref;		/* Pen position before first command    */
+	int pen_no;		/* Pen selected before first command    */
+	int joins;		/* Vectors drawn in a row up to ref     */
+	int drawn;		/* Chunk draws something at all         */
+	int state;		/* Chunk contains SET_PEN or DEF_xx     */
+	float xmin, ymin, xmax, ymax;	/* Bounding box of all vectors  */
+	PEN_W maxwidth;		/* Widest pen used within the chunk     */
+} Chunk;
+
+extern Chunk *chunks;
+extern int n_chunks;
+extern long *state_cmds;	/* Positions of DEF_xx commands */
+extern int n_state_cmds;
+
+void reset_TmpIndex(void);
+void free_TmpIndex(void);
+void cmd_to_TmpIndex(PlotCmd cmd, FILE * td);
+void pt_to_TmpIndex(const HPGL_Pt * p, FILE * td);
+void poly_to_TmpIndex(const HPGL_Pt * p, int n, FILE * td);
+void curve_to_TmpIndex(const HPGL_Pt * p, int n, const HPGL_Pt * end,
+		       FILE * td);
+void pen_to_TmpIndex(int pen, FILE * td);
+
+void set_TmpIndex_window(double xmin, double ymin, double xmax,
+			 double ymax, double margin);
+void clear_TmpIndex_window(void);
+int TmpIndex_windowed(void);
+int cmd_from_TmpIndex(FILE * td);
+int pt_from_TmpIndex(HPGL_Pt * p);
+int joins_from_TmpIndex(void);
+
+#endif /* __TMPINDEX_H */
@@ -41,6 +41,13 @@ copies.
  ** 93/11/15  V 1.11a HWW  EPS syntax corrections (courtesy N. H. F. Beebe)
  ** 94/02/15  V 1.20a HWW  Adapted to changes in hp2xx.h
  ** 01/12/04          MK   Added missing colon to BeginProcSet (Bengt-Arne Fjellner)
+ ** 26/10/19               Solid fills as filled paths (FILL_POLY)
+ ** 26/10/19               Arcs and Bezier curves as such (ARC, CUBIC)
+ ** 26/10/19               Line types as dash patterns (DEF_LT)
+ ** 26/10/19               Labels as text in a Type 3 stick font (TEXT)
+ ** 26/10/19               Line attributes set only after changes; moves
+ **                        start subpaths instead of new paths; relative
+ **                        coordinates in 1/100 mm, formatted by ps_fix()
  **/
 
 #include <stdio.h>
@@ -52,13 +59,28 @@ copies.
 #include "hp2xx.h"
 #include "pendef.h"
 #include "lindef.h"
+#include "chardraw.h"
 
 
 /*#define	A4_height	297*//* in [mm]      */
 
 
 
-static int linecount = 0;
+#define	PS_PATH_MAX	1000	/* Segments per path (Level 1: 1500 points) */
+#define	PS_COLS		72	/* Line length of the output             */
+
+/**
+ ** Path state: The current position of the pen, in 1/100 mm, and how
+ ** the current point of the PostScript path relates to it
+ **/
+#define	CP_NONE		0	/* No current point, or elsewhere         */
+#define	CP_NEAR		1	/* Near (after arcs): No relative moves   */
+#define	CP_EXACT	2	/* Exactly the current position           */
+
+static long cx, cy;		/* Current position                      */
+static int cp;			/* CP_NONE, CP_NEAR or CP_EXACT          */
+static int path_len;		/* Segments in the path not stroked yet  */
+static int col;			/* Output column                         */
 static float xcoord2mm, ycoord2mm;
 static float xmin, ymin;
 
@@ -67,56 +89,189 @@ static PEN_W lastwidth;
 static int lastcap;
 static int lastjoin;
 static int lastlimit;
+static LineDash lastdash;
 static BYTE lastred, lastgreen, lastblue;
+static int text_defined;	/* Label procedures written          */
+static char fonts_defined[256];	/* Stick fonts written as PS fonts   */
 
-void ps_set_linewidth(PEN_W, HPGL_Pt *, FILE *);
-void ps_set_linecap(LineEnds type, PEN_W pensize, HPGL_Pt * ppt,
-		    FILE * fd);
+void ps_set_linewidth(PEN_W, FILE *);
+void ps_set_linecap(LineEnds type, PEN_W pensize, FILE * fd);
 void ps_set_linejoin(LineJoins type, LineLimit limit, PEN_W pensize,
-		     HPGL_Pt * ppt, FILE * fd);
-void ps_set_color(PEN_C pencolor, HPGL_Pt * ppt, FILE * fd);
+		     FILE * fd);
+void ps_set_color(PEN_C pencolor, FILE * fd);
+void ps_set_dash(const LineDash * pd, FILE * fd);
 void ps_init(const GEN_PAR *, const OUT_PAR *, FILE *, PEN_W);
 void ps_end(FILE *);
-void ps_stroke_and_move_to(HPGL_Pt *, FILE *);
-void ps_line_to(HPGL_Pt *, char, FILE *);
-void ps_draw_dot(HPGL_Pt * ppt, double radius, FILE * fd);
+void ps_stroke(FILE *);
+void ps_move_to(const HPGL_Pt *);
+void ps_line_to(const HPGL_Pt *, FILE *);
+void ps_draw_dot(const HPGL_Pt * ppt, double radius, FILE * fd);
+void ps_fill_polygon(const HPGL_Pt * p, int n, FILE * fd);
+void ps_arc(const HPGL_Arc * pa, FILE * fd);
+void ps_curve_to(const HPGL_Pt * p, FILE * fd);
+void ps_text(const HPGL_Text * pt, const char *s, FILE * fd);
 char *Getdate(void);
 
 
 
+/**
+ ** Coordinates: HP-GL units --> 1/100 mm, rounded
+ **/
+static long ps_x(double x)
+{
+	return (long) floor((x - xmin) * xcoord2mm * 100.0 + 0.5);
+}
+
+static long ps_y(double y)
+{
+	return (long) floor((y - ymin) * ycoord2mm * 100.0 + 0.5);
+}
+
+static long ps_hundredths(double mm)
+{
+	return (long) floor(mm * 100.0 + 0.5);
+}
+
+
+/**
+ ** Fixed point formatter: v / 100 in the shortest form, e.g.
+ ** "12", "-1.5" or ".25". Returns the end of the string.
+ **/
+static char *ps_fix(char *s, long v)
+{
+	char digits[24];
+	unsigned long u;
+	int n = 0, frac;
+
+	if (v < 0) {
+		*s++ = '-';
+		u = (unsigned long) (-v);
+	} else
+		u = (unsigned long) v;
+	frac = (int) (u % 100);
+	u /= 100;
+	if (u > 0 || frac == 0) {
+		do
+			digits[n++] = (char) ('0' + u % 10);
+		while ((u /= 10) > 0);
+		while (n > 0)
+			*s++ = digits[--n];
+	}
+	if (frac) {
+		*s++ = '.';
+		*s++ = (char) ('0' + frac / 10);
+		if (frac % 10)
+			*s++ = (char) ('0' + frac % 10);
+	}
+	*s = '\0';
+	return s;
+}
+
+
+/**
+ ** Write a token (e.g. "1.5 2 L"), breaking lines before PS_COLS
+ **/
+static void ps_put(const char *s, int len, FILE * fd)
+{
+	if (col > 0 && col + len >= PS_COLS) {
+		putc('\n', fd);
+		col = 0;
+	} else if (col > 0) {
+		putc(' ', fd);
+		col++;
+	}
+	fwrite(s, 1, (size_t) len, fd);
+	col += len;
+}
+
+
+/**
+ ** Write "x y op" (coordinates in 1/100 mm)
+ **/
+static void ps_op(long x, long y, char op, FILE * fd)
+{
+	char buf[64], *p;
+
+	p = ps_fix(buf, x);
+	*p++ = ' ';
+	p = ps_fix(p, y);
+	*p++ = ' ';
+	*p++ = op;
+	ps_put(buf, (int) (p - buf), fd);
+}
+
+
 /**
  ** Close graphics file
  **/
 void ps_end(FILE * fd)
 {
-	fprintf(fd, " S\neop\n");
+	ps_stroke(fd);
+	fprintf(fd, "eop\n");
 	fprintf(fd, "@end\n");
 	fprintf(fd, "%%%%PageTrailer\n");
 	fprintf(fd, "%%%%Trailer\n");
 	fprintf(fd, "%%%%EOF\n");
-	linecount = 0;
 }
 
 
 
 /**
- ** Flush old path and move
+ ** Stroke the path so far, if any, and end the output line.
+ ** Afterwards there is no current point.
+ **/
+void ps_stroke(FILE * fd)
+{
+	if (path_len > 0)
+		ps_put("S", 1, fd);
+	if (col > 0)
+		putc('\n', fd);
+	col = path_len = 0;
+	cp = CP_NONE;
+}
+
+
+
+/**
+ ** Move the pen. Nothing is written: The next line starts a new
+ ** subpath of the same path (PostScript restarts dash patterns for
+ ** every subpath, so this looks like a new path).
+ **/
+void ps_move_to(const HPGL_Pt * ppt)
+{
+	long x = ps_x(ppt->x), y = ps_y(ppt->y);
+
+	if (x != cx || y != cy)
+		cp = CP_NONE;
+	cx = x;
+	cy = y;
+}
+
+
+
+/**
+ ** Make the current position the current point of the path
  **/
-void ps_stroke_and_move_to(HPGL_Pt * ppt, FILE * fd)
+static void ps_start_path(FILE * fd)
 {
-	fprintf(fd, " S\n%6.2f %6.2f M",	/* S: Start a new path  */
-		(ppt->x - xmin) * xcoord2mm, (ppt->y - ymin) * ycoord2mm);
-	linecount = 0;
+	if (path_len >= PS_PATH_MAX)
+		ps_stroke(fd);	/* Keep paths within interpreter limits */
+	if (cp == CP_NONE) {
+		ps_op(cx, cy, 'M', fd);
+		cp = CP_EXACT;
+	}
 }
 
+
+
 /**
  ** Set line width
  **/
-void ps_set_linewidth(PEN_W width, HPGL_Pt * ppt, FILE * fd)
+void ps_set_linewidth(PEN_W width, FILE * fd)
 {
 	if ((fabs(width - lastwidth) >= 0.01) && (width >= 0.05)) {
-		ps_stroke_and_move_to(ppt, fd);	/* MUST start a new path!      */
-		fprintf(fd, " %6.3f W\n", width);
+		ps_stroke(fd);	/* MUST start a new path!      */
+		fprintf(fd, "%.3f W\n", width);
 		lastwidth = width;
 	}
 	return;
@@ -125,7 +280,7 @@ void ps_set_linewidth(PEN_W width, HPGL_Pt * ppt, FILE * fd)
 /**
  ** Set line ends
  **/
-void ps_set_linecap(LineEnds type, PEN_W pensize, HPGL_Pt * ppt, FILE * fd)
+void ps_set_linecap(LineEnds type, PEN_W pensize, FILE * fd)
 {
 	int newcap;
 
@@ -150,10 +305,12 @@ void ps_set_linecap(LineEnds type, PEN_W pensize, HPGL_Pt * ppt, FILE * fd)
 	} else {
 		newcap = 1;
 	}
+	if (newcap == 0 && line_dash_has_dots(&CurrentLineDash))
+		newcap = 1;	/* Else dots of a dash pattern vanish */
 
 	if (newcap != lastcap) {
-		ps_stroke_and_move_to(ppt, fd);	/* MUST start a new path! */
-		fprintf(fd, " %d setlinecap\n", newcap);
+		ps_stroke(fd);	/* MUST start a new path! */
+		fprintf(fd, "%d setlinecap\n", newcap);
 		lastcap = newcap;
 	}
 
@@ -164,7 +321,7 @@ void ps_set_linecap(LineEnds type, PEN_W pensize, HPGL_Pt * ppt, FILE * fd)
  ** Set line Joins
  **/
 void ps_set_linejoin(LineJoins type, LineLimit limit, PEN_W pensize,
-		     HPGL_Pt * ppt, FILE * fd)
+		     FILE * fd)
 {
 	int newjoin;
 	int newlimit = lastlimit;
@@ -201,32 +358,53 @@ void ps_set_linejoin(LineJoins type, LineLimit limit, PEN_W pensize,
 	}
 
 	if (newjoin != lastjoin) {
-		ps_stroke_and_move_to(ppt, fd);	/* MUST start a new path! */
-		fprintf(fd, " %d setlinejoin\n", newjoin);
+		ps_stroke(fd);	/* MUST start a new path! */
+		fprintf(fd, "%d setlinejoin\n", newjoin);
 		lastjoin = newjoin;
 	}
 
 	if (newlimit != lastlimit) {
-		ps_stroke_and_move_to(ppt, fd);	/* MUST start a new path! */
-		fprintf(fd, " %d setmiterlimit\n", newlimit);
+		ps_stroke(fd);	/* MUST start a new path! */
+		fprintf(fd, "%d setmiterlimit\n", newlimit);
 		lastlimit = newlimit;
 	}
 
 }
 
 
+/**
+ ** Set dash pattern
+ **/
+void ps_set_dash(const LineDash * pd, FILE * fd)
+{
+	int i;
+
+	if (pd->n == lastdash.n && (pd->n == 0 ||
+				    memcmp(pd->len, lastdash.len,
+					   pd->n * sizeof(pd->len[0])) == 0))
+		return;
+
+	ps_stroke(fd);		/* MUST start a new path! */
+	fprintf(fd, "[");
+	for (i = 0; i < pd->n; i++)
+		fprintf(fd, i ? " %.3f" : "%.3f", pd->len[i] * xcoord2mm);
+	fprintf(fd, "] 0 setdash\n");
+	lastdash = *pd;
+}
+
+
 /**
  ** Set RGB color
  **/
-void ps_set_color(PEN_C pencolor, HPGL_Pt * ppt, FILE * fd)
+void ps_set_color(PEN_C pencolor, FILE * fd)
 {
 	if ((pt.clut[pencolor][0] != lastred) ||
 	    (pt.clut[pencolor][1] != lastgreen)
 	    || (pt.clut[pencolor][2] != lastblue)) {
 
 
-		ps_stroke_and_move_to(ppt, fd);	/* MUST start a new path!       */
-		fprintf(fd, " %6.3f %6.3f %6.3f C\n",
+		ps_stroke(fd);	/* MUST start a new path!       */
+		fprintf(fd, "%.3f %.3f %.3f C\n",
 			(double) pt.clut[pencolor][0] / 255.0,
 			(double) pt.clut[pencolor][1] / 255.0,
 			(double) pt.clut[pencolor][2] / 255.0);
@@ -239,24 +417,216 @@ void ps_set_color(PEN_C pencolor, HPGL_Pt * ppt, FILE * fd)
 	}
 }
 
-void ps_line_to(HPGL_Pt * ppt, char mode, FILE * fd)
+/**
+ ** All attributes of lines, after any of them may have changed
+ **/
+static void ps_set_state(PEN_W pensize, int pen_no, FILE * fd)
 {
-	if (linecount > 3) {
-		putc('\n', fd);
-		linecount = 0;
-	} else
-		putc(' ', fd);
+	ps_set_linewidth(pensize, fd);
+	ps_set_linecap(CurrentLineAttr.End, pensize, fd);
+	ps_set_linejoin(CurrentLineAttr.Join, CurrentLineAttr.Limit,
+			pensize, fd);
+	ps_set_dash(&CurrentLineDash, fd);
+	ps_set_color(pt.color[pen_no], fd);
+}
+
+
+/**
+ ** Line from the current position; relative if the current point
+ ** is exactly known
+ **/
+void ps_line_to(const HPGL_Pt * ppt, FILE * fd)
+{
+	long x = ps_x(ppt->x), y = ps_y(ppt->y);
+
+	ps_start_path(fd);
+	if (cp == CP_EXACT)
+		ps_op(x - cx, y - cy, 'L', fd);
+	else
+		ps_op(x, y, 'D', fd);
+	cx = x;
+	cy = y;
+	cp = CP_EXACT;
+	path_len++;
+}
+
+
+/**
+ ** Dot (filled circle) at ppt. Strokes the path first, since
+ ** filling ends it.
+ **/
+void ps_draw_dot(const HPGL_Pt * ppt, double radius, FILE * fd)
+{
+	char buf[64], *p;
+
+	ps_stroke(fd);
+	ps_move_to(ppt);
+	p = ps_fix(buf, cx);
+	*p++ = ' ';
+	p = ps_fix(p, cy);
+	*p++ = ' ';
+	p = ps_fix(p, ps_hundredths(radius));
+	*p++ = ' ';
+	*p++ = 'P';
+	ps_put(buf, (int) (p - buf), fd);
+}
+
 
-	fprintf(fd, "%6.2f %6.2f %c",
-		(ppt->x - xmin) * xcoord2mm, (ppt->y - ymin) * ycoord2mm,
-		mode);
-	linecount++;
+/**
+ ** Fill a polygon given as list of edges (point pairs), even-odd rule.
+ ** Afterwards, there is no current point.
+ **/
+void ps_fill_polygon(const HPGL_Pt * p, int n, FILE * fd)
+{
+	long x, y, x0 = 0, y0 = 0;
+	int i, start;
+
+	ps_stroke(fd);
+	for (i = 0; i + 1 < n; i += 2) {
+		start = (i == 0 || p[i].x != p[i - 1].x
+			 || p[i].y != p[i - 1].y);
+		if (start) {
+			x0 = ps_x(p[i].x);
+			y0 = ps_y(p[i].y);
+			ps_op(x0, y0, 'M', fd);
+		}
+		x = ps_x(p[i + 1].x);
+		y = ps_y(p[i + 1].y);
+		ps_op(x - x0, y - y0, 'L', fd);
+		x0 = x;
+		y0 = y;
+	}
+	ps_put("F", 1, fd);
+	ps_stroke(fd);		/* Path is empty now: Just ends the line */
 }
 
-void ps_draw_dot(HPGL_Pt * ppt, double radius, FILE * fd)
+
+/**
+ ** Continue the path with an arc (A: counter-clockwise, N: clockwise)
+ **/
+void ps_arc(const HPGL_Arc * pa, FILE * fd)
+{
+	char buf[128], *p;
+	double dx, dy, a1;
+
+	ps_start_path(fd);
+	dx = (pa->end.x - pa->center.x) * xcoord2mm;
+	dy = (pa->end.y - pa->center.y) * ycoord2mm;
+	a1 = atan2(dy, dx) * 180.0 / M_PI;
+	p = ps_fix(buf, ps_x(pa->center.x));
+	*p++ = ' ';
+	p = ps_fix(p, ps_y(pa->center.y));
+	*p++ = ' ';
+	p = ps_fix(p, ps_hundredths(sqrt(dx * dx + dy * dy)));
+	*p++ = ' ';
+	p = ps_fix(p, ps_hundredths(a1 - pa->sweep * 180.0 / M_PI));
+	*p++ = ' ';
+	p = ps_fix(p, ps_hundredths(a1));
+	*p++ = ' ';
+	*p++ = pa->sweep > 0 ? 'A' : 'N';
+	ps_put(buf, (int) (p - buf), fd);
+	path_len++;
+
+	/* The arc ends close to, but not exactly at the rounded end */
+	cx = ps_x(pa->end.x);
+	cy = ps_y(pa->end.y);
+	cp = CP_NEAR;
+}
+
+
+/**
+ ** Continue the path with a Bezier curve (control points, end point)
+ **/
+void ps_curve_to(const HPGL_Pt * p, FILE * fd)
 {
-	fprintf(fd, " currentpoint newpath %0.2f 0 360 arc fill\n",
-		radius);
+	char buf[160], *q = buf;
+	int i;
+
+	ps_start_path(fd);
+	for (i = 0; i < 3; i++) {
+		q = ps_fix(q, ps_x(p[i].x));
+		*q++ = ' ';
+		q = ps_fix(q, ps_y(p[i].y));
+		*q++ = ' ';
+	}
+	*q++ = 'B';
+	ps_put(buf, (int) (q - buf), fd);
+	path_len++;
+	cx = ps_x(p[2].x);
+	cy = ps_y(p[2].y);
+	cp = CP_EXACT;
+}
+
+
+/**
+ ** Define stick font no. font as Type 3 font /HPStick<font>, bound to
+ ** SF<font>. Glyphs are stroked with the current pen width, so they
+ ** look like the vectors they replace; their names are those of
+ ** StandardEncoding to keep the text searchable.
+ **/
+static void ps_define_font(int font, FILE * fd)
+{
+	const HPGL_Pt *p;
+	const char *draw;
+	int c, i, n;
+
+	fprintf(fd, "/HPStick%d 10 dict dup begin\n", font);
+	fprintf(fd, "/FontType 3 def\n/FontMatrix [1 0 0 1 0 0] def\n");
+	fprintf(fd, "/FontBBox [-1 -4 6 11] def\n");
+	fprintf(fd, "/Encoding StandardEncoding def\n");
+	fprintf(fd, "/m {moveto} def\n/l {lineto} def\n");
+	fprintf(fd, "/CharProcs 100 dict def\nCharProcs begin\n/space {} def\n");
+	for (c = '!'; c <= '~'; c++) {
+		n = stick_glyph(font, c, &p, &draw);
+		fprintf(fd, "StandardEncoding %d get {", c);
+		if (n > 0 && draw[0])	/* Drawn from the char. origin  */
+			fprintf(fd, "0 0 m ");
+		for (i = 0; i < n; i++)
+			fprintf(fd, "%s%g %g %c", i ? " " : "", p[i].x,
+				p[i].y, draw[i] ? 'l' : 'm');
+		fprintf(fd, "} def\n");
+	}
+	fprintf(fd, "end\n");
+	fprintf(fd, "/BuildGlyph {exch begin CharProcs exch\n");
+	fprintf(fd, "   2 copy known not {pop /space} if get\n");
+	fprintf(fd, "   0 0 setcharwidth newpath exec PSDict /TM get setmatrix\n");
+	fprintf(fd, "   1 setlinecap 1 setlinejoin stroke end} def\n");
+	fprintf(fd, "/BuildChar {1 index /Encoding get exch get\n");
+	fprintf(fd, "   1 index /BuildGlyph get exec} def\n");
+	fprintf(fd, "end definefont pop\n");
+	fprintf(fd, "/SF%d /HPStick%d findfont def\n", font, font);
+	fonts_defined[font & 0xff] = TRUE;
+}
+
+
+/**
+ ** Show a label: T expects string, char. advance, text matrix & font.
+ ** Afterwards, the current position is the label origin.
+ **/
+void ps_text(const HPGL_Text * pt, const char *s, FILE * fd)
+{
+	ps_stroke(fd);
+	if (!text_defined) {
+		fprintf(fd, "/TM matrix def\n");
+		fprintf(fd, "/T {gsave setfont TM currentmatrix pop concat\n");
+		fprintf(fd, "   [] 0 setdash 0 0 moveto 0 3 -1 roll ashow grestore} def\n");
+		text_defined = TRUE;
+	}
+	if (!fonts_defined[pt->font & 0xff])
+		ps_define_font(pt->font, fd);
+
+	putc('(', fd);
+	for (; *s; s++) {
+		if (*s == '(' || *s == ')' || *s == '\\')
+			putc('\\', fd);
+		putc(*s, fd);
+	}
+	fprintf(fd, ") %.6g [%.6g %.6g %.6g %.6g %.6g %.6g] SF%d T\n",
+		pt->adv, pt->m[0] * xcoord2mm, pt->m[1] * ycoord2mm,
+		pt->m[2] * xcoord2mm, pt->m[3] * ycoord2mm,
+		(pt->org.x - xmin) * xcoord2mm,
+		(pt->org.y - ymin) * ycoord2mm, pt->font);
+	ps_move_to(&pt->org);
 }
 
 
@@ -293,7 +663,13 @@ void ps_init(const GEN_PAR * pg, const OUT_PAR * po, FILE * fd,
 
 	lastwidth = -1.0;
 	lastcap = lastjoin = lastlimit = -1;
+	lastdash.n = CurrentLineDash.n = 0;
 	lastred = lastgreen = lastblue = -1;
+	cx = cy = 0;
+	cp = CP_NONE;
+	path_len = col = 0;
+	text_defined = FALSE;
+	memset(fonts_defined, 0, sizeof(fonts_defined));
 
 	hmxpenw = pg->maxpensize / 2.0;	/* Half max. pen width, in mm   */
 
@@ -394,9 +770,15 @@ void ps_init(const GEN_PAR * pg, const OUT_PAR * po, FILE * fd,
 		po->yoff + hmxpenw);
 	fprintf(fd, "    %6.3f setlinewidth\n", pensize);
 	fprintf(fd, "   } def\n");
+	fprintf(fd, "/A {arc} def\n");
+	fprintf(fd, "/B {curveto} def\n");
 	fprintf(fd, "/C {setrgbcolor} def\n");
 	fprintf(fd, "/D {lineto} def\n");
+	fprintf(fd, "/F {eofill} def\n");
+	fprintf(fd, "/L {rlineto} def\n");
 	fprintf(fd, "/M {moveto} def\n");
+	fprintf(fd, "/N {arcn} def\n");
+	fprintf(fd, "/P {0 360 arc fill} def\n");
 	fprintf(fd, "/S {stroke} def\n");
 	fprintf(fd, "/W {setlinewidth} def\n");
 	fprintf(fd, "/Z {stroke newpath} def\n");
@@ -427,9 +809,12 @@ void ps_init(const GEN_PAR * pg, const OUT_PAR * po, FILE * fd,
 int to_eps(const GEN_PAR * pg, const OUT_PAR * po)
 {
 	PlotCmd cmd;
-	HPGL_Pt pt1 = { 0, 0 };
+	HPGL_Pt pt1 = { 0, 0 }, *poly, cp[3];
+	HPGL_Arc arc;
+	HPGL_Text text;
+	char *s;
 	FILE *md;
-	int pen_no = 0, err;
+	int pen_no = 0, n, err, dirty = TRUE;
 	PEN_W pensize;
 
 	err = 0;
@@ -452,7 +837,7 @@ int to_eps(const GEN_PAR * pg, const OUT_PAR * po)
 	ps_init(pg, po, md, pensize);
 
 	if (pensize > 0.05)
-		fprintf(md, " %6.3f W\n", pensize);
+		fprintf(md, "%.3f W\n", pensize);
 
 	/* Factor for transformation of HP coordinates to mm  */
 
@@ -476,6 +861,7 @@ int to_eps(const GEN_PAR * pg, const OUT_PAR * po)
 				goto EPS_exit;
 			}
 			pensize = pt.width[pen_no];
+			dirty = TRUE;
 			break;
 		case DEF_PW:
 			if (!load_pen_width_table(pg->td)) {
@@ -484,6 +870,7 @@ int to_eps(const GEN_PAR * pg, const OUT_PAR * po)
 				goto EPS_exit;
 			}
 			pensize = pt.width[pen_no];
+			dirty = TRUE;
 			break;
 		case DEF_PC:
 			err = load_pen_color_table(pg->td);
@@ -492,6 +879,7 @@ int to_eps(const GEN_PAR * pg, const OUT_PAR * po)
 				err = ERROR;
 				goto EPS_exit;
 			}
+			dirty = TRUE;
 			break;
 		case DEF_LA:
 			if (load_line_attr(pg->td) < 0) {
@@ -499,48 +887,68 @@ int to_eps(const GEN_PAR * pg, const OUT_PAR * po)
 				err = ERROR;
 				goto EPS_exit;
 			}
+			dirty = TRUE;
+			break;
+		case DEF_LT:
+			if (load_line_dash(pg->td) < 0) {
+				PError("Unexpected end of temp. file");
+				err = ERROR;
+				goto EPS_exit;
+			}
+			dirty = TRUE;
 			break;
 		case MOVE_TO:
-			ps_set_linewidth(pensize, &pt1, md);
-			ps_set_linecap(CurrentLineAttr.End, pensize, &pt1,
-				       md);
-			ps_set_linejoin(CurrentLineAttr.Join,
-					CurrentLineAttr.Limit, pensize,
-					&pt1, md);
-			ps_set_color(pt.color[pen_no], &pt1, md);
-
 			HPGL_Pt_from_tmpfile(&pt1);
-			if (pensize > 0.05)
-				ps_stroke_and_move_to(&pt1, md);
+			ps_move_to(&pt1);
 			break;
 		case DRAW_TO:
-			ps_set_linewidth(pensize, &pt1, md);
-			ps_set_linecap(CurrentLineAttr.End, pensize, &pt1,
-				       md);
-			ps_set_linejoin(CurrentLineAttr.Join,
-					CurrentLineAttr.Limit, pensize,
-					&pt1, md);
-			ps_set_color(pt.color[pen_no], &pt1, md);
-
-			HPGL_Pt_from_tmpfile(&pt1);
-			if (pensize > 0.05)
-				ps_line_to(&pt1, 'D', md);
-			break;
 		case PLOT_AT:
-			ps_set_linewidth(pensize, &pt1, md);
-			ps_set_linecap(CurrentLineAttr.End, pensize, &pt1,
-				       md);
-			ps_set_linejoin(CurrentLineAttr.Join,
-					CurrentLineAttr.Limit, pensize,
-					&pt1, md);
-			ps_set_color(pt.color[pen_no], &pt1, md);
-
-			HPGL_Pt_from_tmpfile(&pt1);
-			if (pensize > 0.05) {
-				ps_line_to(&pt1, 'M', md);
-				ps_line_to(&pt1, 'D', md);	/* not sure whether this is needed */
-				ps_draw_dot(&pt1, pensize / 2, md);
+		case ARC:
+		case CUBIC:
+			if (dirty) {
+				ps_set_state(pensize, pen_no, md);
+				dirty = FALSE;
+			}
+			switch (cmd) {
+			case DRAW_TO:
+				HPGL_Pt_from_tmpfile(&pt1);
+				if (pensize > 0.05)
+					ps_line_to(&pt1, md);
+				break;
+			case PLOT_AT:
+				HPGL_Pt_from_tmpfile(&pt1);
+				if (pensize > 0.05)
+					ps_draw_dot(&pt1, pensize / 2, md);
+				break;
+			case ARC:
+				Arc_from_tmpfile(&arc);
+				if (pensize > 0.05)
+					ps_arc(&arc, md);
+				pt1 = arc.end;
+				break;
+			default:
+				Cubic_from_tmpfile(cp);
+				if (pensize > 0.05)
+					ps_curve_to(cp, md);
+				pt1 = cp[2];
+				break;
 			}
+			ps_move_to(&pt1);	/* Thin pens: Just follow */
+			break;
+		case FILL_POLY:
+			ps_set_color(pt.color[pen_no], md);
+			n = Polygon_from_tmpfile(&poly);
+			ps_fill_polygon(poly, n, md);
+			break;
+		case TEXT:
+			ps_set_linewidth(pensize, md);
+			ps_set_color(pt.color[pen_no], md);
+
+			s = Text_from_tmpfile(&text);
+			pt1 = text.org;
+			if (pensize > 0.05)
+				ps_text(&text, s, md);
+			ps_move_to(&pt1);
 			break;
 		default:
 			Eprintf("Illegal cmd in temp. file!");
@@ -27,6 +27,7 @@ copies.
  **             derived from to_pcl.c
  **
  ** 00/02/27          MK initial version based on to_pcl.c
+ ** 26/10/19          Compression by RLE_packbits() of rle.c
  **/
 
 #include <stdio.h>
@@ -35,6 +36,7 @@ copies.
 #include "bresnham.h"
 #include "hp2xx.h"
 #include "pendef.h"
+#include "rle.h"
 
 #define	ESCP2_FIRST 	1	/* Bit mask!    */
 #define	ESCP2_LAST 	2	/* Bit mask!    */
@@ -54,138 +56,18 @@ static Byte *p_K, *p_C, *p_M, *p_Y;	/* Buffer ptrs (CMYK bits) */
 
 
 /**
- ** Data & functions for (RLE) compression:
+ ** Buffer for (RLE) compression, see RLE_packbits():
  **
  ** Note: Usually, the buffer p_B receives less data than the
  **	  original (i.e., < nb). However, "temporary" increases
  **	  are possible. To allow for them, we allocate a few extra bytes.
  **	  If the buffer eventually really grows, we won't use compression!
- **	  "n_B" keeps track of the amount of extra buffer space left.
  **/
-#define	B_EXTRASPACE	16
 static Byte *p_B;		/* Buffer for compression  */
-static int n_B;			/* Counter for extra space */
 
 
 
 
-static int RLE_n_repeats(Byte * p1, int nb)
-/**
- **	There are "nb" bytes in buffer "p1"
- **	Return number of identical bytes in a sequence (0, 2 ... nb)
- **/
-{
-	int i;
-	Byte *p2;
-
-	p2 = p1 + 1;
-	if (nb < 2 || *p2 != *p1)
-		return 0;
-	for (i = 1; i < nb && *p1 == *p2; p1++, p2++)
-		i++;
-	return i;
-}
-
-
-
-static int RLE_n_irregs(Byte * p1, int nb)
-/**
- **	There are "nb" bytes in buffer "p1"
- **	Return number of irregular (non-identical) bytes
- **	   in a sequence (0, 1, 2 ... nb)
- **/
-{
-	int i;
-	Byte *p2;
-
-	if (nb < 2)
-		return nb;	/* 0 or 1 */
-	p2 = p1 + 1;
-	for (i = 1; i < nb && *p1 != *p2; p1++, p2++)
-		i++;
-	return (i == nb) ? nb : i - 1;
-}
-
-
-
-static int RLE_compress(Byte * src, Byte * dst, int nb)
-{
-  /**
-   ** Either there is a block of repetitions or non-repeating bytes
-   ** at the buffer start. If repetitions, compress them. If not,
-   ** buffer them and compress next block of repetitions.
-   **/
-	int i, l, count = 0;
-
-	l = RLE_n_repeats(src, nb);	/* l == 0 or  l >= 2    */
-	while (l > 128) {
-		*dst++ = (-127);	/* 128 repetitions      */
-		*dst++ = *src;
-		count += 2;
-		l -= 128;
-		nb -= 128;
-		src += 128;
-		n_B += 126;	/* 128 bytes coded as 2 */
-
-	}
-	if (l > 0) {
-		*dst++ = (Byte) (1 - l);	/* l repetitions        */
-		*dst++ = *src;
-		count += 2;
-		src += l;
-		nb -= l;
-		n_B += (l - 2);	/* l bytes coded as 2   */
-	}
-
-	if (nb < 0)
-		return -1;	/* should never happen  */
-	if (nb == 0)
-		return count;	/* "count" bytes buffered */
-
-
-	/* Irregular sequence */
-
-	l = RLE_n_irregs(src, nb);	/* l == 0 or  l >= 2    */
-	while (l > 128) {
-		n_B -= 1;
-		if (n_B < 0)
-			return -1;	/* Buffer overflow!     */
-
-		*dst++ = 127;	/* 128 repetitions      */
-		for (i = 0; i < 128; i++)
-			*dst++ = *src++;
-		count += 129;
-		l -= 128;
-		nb -= 128;
-
-	}
-	if (l > 0) {
-		n_B -= 1;
-		if (n_B < 0)
-			return -1;	/* Buffer overflow!     */
-
-		*dst++ = (Byte) (l - 1);	/* l repetitions        */
-		for (i = 0; i < l; i++)
-			*dst++ = *src++;
-		count += (l + 1);
-		nb -= l;
-	}
-
-	if (nb < 0)
-		return -1;	/* should never happen          */
-
-	if (nb == 0) {		/* At end-of-buffer: evaluate     */
-		if (n_B > B_EXTRASPACE)	/* Regular exit: Return             */
-			return count;	/*   number of compressed bytes */
-		else
-			return -1;	/* Nothing gained !             */
-	}
-	i = RLE_compress(src, dst, nb);	/* Recursion for rest   */
-	return (i == -1) ? -1 : i + count;
-}
-
-
-
 /**
  ** ESCP2 data compression method #2 (RLE)
  **
@@ -200,8 +82,7 @@ static int compress_buf_RLE(Byte * buf, int nb)
 	if (p_B == NULL)	/* No buffer for compression!       */
 		return -1;
 
-	n_B = B_EXTRASPACE;	/* Init. extra space counter    */
-	return RLE_compress(buf, p_B, nb);	/* Recursive function!  */
+	return RLE_packbits(buf, nb, p_B);
 }
 
 
@@ -459,8 +340,7 @@ int PicBuf_to_ESCP2(const GEN_PAR * pg, const OUT_PAR * po)
   /**
    ** Optional memory; for compression
    **/
-	n_B = B_EXTRASPACE;
-	p_B = calloc((size_t) (po->picbuf->nb + n_B), sizeof(Byte));
+	p_B = calloc((size_t) (po->picbuf->nb + RLE_EXTRASPACE), sizeof(Byte));
 
 
 	if (*po->outfile != '-') {
@@ -50,6 +50,9 @@ copies.
  ** 92/05/19  V 1.02c HWW  Abort if color mode
  ** 92/11/08  V 1.02d HWW  File opening changed to standard
  ** 94/02/14  V 1.10a HWW  Adapted to changes in hp2xx.h
+ ** 26/10/19              Horizontal runs found by rle.c
+ ** 26/10/19              Vertical repetitions found by row hashes;
+ **                        row pointers fetched once per row
  **
  ** NOTE by HWW: This file is maintained by NM (due to lack of time,
  **              only occasionally). Recent changes done by myself
@@ -63,149 +66,51 @@ copies.
 #include <string.h>
 #include "bresnham.h"
 #include "hp2xx.h"
+#include "rle.h"
 
 
 
-static Byte get_byte_IMG(int row_c, int pos, const PicBuf * picbuf)
-/* yields one byte which should be analyzed */
-{
-	int row_nr;		/* "real" row number    */
-	RowBuf *row;		/* pointer to one row   */
-	Byte get_byte;		/* byte to be returned  */
-
-	row_nr = picbuf->nr - (row_c + 1);
-	row = get_RowBuf(picbuf, row_nr);
-	get_byte = (Byte) row->buf[pos];
-
-	return (get_byte);
-}
-
-
-/* ---------------------------------------------------------------- */
-
-
-static int vert_rep_IMG(int row_c, const PicBuf * picbuf)
+static int vert_rep_IMG(int row_c, const PicBuf * picbuf,
+			const unsigned long *row_hash)
 /* determines number of vertical repetitions of a row */
 {
-	int vert_rep = 0;	/* vertical repetition factor   */
-
-	int Img_w = picbuf->nb;	/* number of bytes/rows         */
-	int Img_h = picbuf->nr;	/* number of rows               */
-
-	int pos;		/* position in row              */
-
-	Byte org_byte;		/* byte in original row         */
-	Byte cmp_byte;		/* byte in compared row         */
-
-	int cmp_row_c = row_c + 1;	/* row number of compared row   */
-
-
-	while (cmp_row_c < Img_h) {
-		/* following row(s) available   */
-
-		for (pos = 0; pos < Img_w; pos++) {
-			org_byte = get_byte_IMG(row_c, pos, picbuf);
-			cmp_byte = get_byte_IMG(cmp_row_c, pos, picbuf);
-
-			if (org_byte != cmp_byte)
-				/* found first difference!  */
-				return vert_rep;
-		}
-
-		cmp_row_c++;
-		vert_rep++;
-
-		if (vert_rep >= 254)
-			break;
-
-	}
-
-	return vert_rep;
+	return RLE_same_rows(picbuf, row_hash, picbuf->nr - (row_c + 1), -1,
+			     254);
 }
 
 
 /* ---------------------------------------------------------------- */
 
 
-static int empty_SR_IMG(int row_c, int pos, const PicBuf * picbuf)
+static int empty_SR_IMG(const Byte * row, int pos, int Img_w)
 /* determines number of empty solid runs starting at actual position    */
 {
-	int empty_SR_c = 0;	/* counts empty solid runs  */
-	int cmp_pos;		/* it's position            */
-
-	int Img_w = picbuf->nb;	/* number of bytes/row  */
-
-
-	for (cmp_pos = pos; cmp_pos < Img_w; cmp_pos++) {
-		if (get_byte_IMG(row_c, cmp_pos, picbuf) != (Byte) 0)
-			break;
-		empty_SR_c++;
-		if (empty_SR_c >= 127)
-			break;
-	}
-	return empty_SR_c;
+	return RLE_span(row + pos, MIN(Img_w - pos, 127), (Byte) 0);
 }
 
 
 /* ---------------------------------------------------------------- */
 
 
-static int full_SR_IMG(int row_c, int pos, const PicBuf * picbuf)
+static int full_SR_IMG(const Byte * row, int pos, int Img_w)
 /* determines number of full solid runs starting at actual position */
 {
-	int full_SR_c = 0;	/* counts full solid runs   */
-	int cmp_pos;		/* it's position            */
-
-	int Img_w = picbuf->nb;	/* number of bytes/row  */
-
-	for (cmp_pos = pos; cmp_pos < Img_w; cmp_pos++) {
-		if (get_byte_IMG(row_c, cmp_pos, picbuf) != (Byte) 255)
-			break;
-		full_SR_c++;
-		if (full_SR_c >= 127)
-			break;
-	}
-	return full_SR_c;
+	return RLE_span(row + pos, MIN(Img_w - pos, 127), (Byte) 255);
 }
 
 
 /* ---------------------------------------------------------------- */
 
 
-static int PR_IMG(int row_c, int pos, const PicBuf * picbuf)
+static int PR_IMG(const Byte * row, int pos, int Img_w)
 /* determines number of pattern runs starting at actual position    */
+/* (repetitions of the 2 bytes there, which count themselves not)   */
 {
-	int PR_c = 0;		/* counts full solid runs           */
-	Byte first_byte;	/* first byte of pattern (2 bytes)  */
-	Byte second_byte;	/* second byte of pattern           */
-	Byte cmp_1st_byte;	/* 1st byte for comparision         */
-	Byte cmp_2nd_byte;	/* 2nd byte for comparision         */
-	int cmp_pos;		/* actual position                  */
-
-	int Img_w = picbuf->nb;	/* number of bytes/row  */
-
-	if (pos + 3 < Img_w) {
-		/* actual position is not end of the row    */
-		first_byte = get_byte_IMG(row_c, pos, picbuf);
-		second_byte = get_byte_IMG(row_c, pos + 1, picbuf);
-
-		for (cmp_pos = pos + 2; cmp_pos + 1 < Img_w; cmp_pos += 2) {
-			cmp_1st_byte =
-			    get_byte_IMG(row_c, cmp_pos, picbuf);
-			cmp_2nd_byte =
-			    get_byte_IMG(row_c, cmp_pos + 1, picbuf);
-
-			if (cmp_1st_byte != first_byte
-			    || cmp_2nd_byte != second_byte)
-				break;
-			PR_c++;
-			if (PR_c >= 254)
-				break;
-		}
-		return PR_c;
-	} else
+	if (pos + 3 >= Img_w)
 		/* actual position to close to the end of the row   */
 		return 0;
+	return RLE_match(row + pos, row + pos + 2,
+			 MIN(Img_w - pos - 2, 2 * 254)) / 2;
 }
 
 
@@ -321,13 +226,14 @@ int PicBuf_to_IMG(const GEN_PAR * pg, const OUT_PAR * po)
 	int Dpi_y = po->dpi_y;
 
 	int vert_rep;		/* vertical repetitions             */
+	unsigned long *row_hash = NULL;	/* hash of each row     */
+	const Byte *row;	/* bytes of actual row              */
 
 	Byte act_byte;		/* actual byte                      */
 
 	int act_pos;		/* actual byte-position in the row  */
 	int first_pos = 0;	/* first pos. of bit string         */
 	int last_pos = 0;	/* last pos. of bit string          */
-	int i_pos;		/* loop index                       */
 
 	int open_BS;		/* was a bit string opened?     */
 
@@ -459,8 +365,11 @@ int PicBuf_to_IMG(const GEN_PAR * pg, const OUT_PAR * po)
 
     /**
      **  Loop over all lines
+     **  (rows are hashed first; without memory for the hashes,
+     **  vertical repetitions are found by comparing rows directly)
      **/
 
+	row_hash = RLE_hash_rows(pbuf);
 	for (row_c = 0; row_c < Img_h; row_c++) {
 		/*      */
 		/* ...  */
@@ -476,7 +385,7 @@ int PicBuf_to_IMG(const GEN_PAR * pg, const OUT_PAR * po)
 		/*                                  */
 		/* Determine vertical repetition    */
 		/*                                  */
-		if ((vert_rep = vert_rep_IMG(row_c, pbuf)) > 0) {
+		if ((vert_rep = vert_rep_IMG(row_c, pbuf, row_hash)) > 0) {
 			row_c += vert_rep;
 			if (!pg->quiet) {
 				if ((int)
@@ -495,6 +404,8 @@ int PicBuf_to_IMG(const GEN_PAR * pg, const OUT_PAR * po)
 	 **  Analyse actual row in detail
 	 **/
 
+		row = get_RowBuf(pbuf, Img_h - (row_c + 1))->buf;
+
 		/* prepare bit string switch        */
 
 		open_BS = FALSE;
@@ -511,13 +422,11 @@ int PicBuf_to_IMG(const GEN_PAR * pg, const OUT_PAR * po)
 				/* bit string was opened before */
 
 				if ((empty_SR_len =
-				     empty_SR_IMG(row_c, act_pos,
-						  pbuf)) > 3
+				     empty_SR_IMG(row, act_pos, Img_w)) > 3
 				    || (full_SR_len =
-					full_SR_IMG(row_c, act_pos,
-						    pbuf)) > 3
+					full_SR_IMG(row, act_pos, Img_w)) > 3
 				    || (PR_len =
-					PR_IMG(row_c, act_pos, pbuf)) > 2
+					PR_IMG(row, act_pos, Img_w)) > 2
 				    || act_pos >= Img_w - 1
 				    || last_pos - first_pos + 1 >= 254) {
 					/* it's worth to stop the bit string    */
@@ -533,16 +442,13 @@ int PicBuf_to_IMG(const GEN_PAR * pg, const OUT_PAR * po)
 					     write_BS_IMG((Byte) BS_len,
 							  fd)) != 0)
 						goto IMG_exit;
-					for (i_pos = first_pos;
-					     i_pos <= last_pos; i_pos++) {
-						act_byte =
-						    get_byte_IMG(row_c,
-								 i_pos,
-								 pbuf);
-						if ((err =
-						     write_byte_IMG
-						     (act_byte, fd)) != 0)
-							goto IMG_exit;
+					if (fwrite(row + first_pos, 1,
+						   (size_t) BS_len, fd) !=
+					    (size_t) BS_len) {
+						PError
+						    ("\nhp2xx --- writing IMG file:");
+						err = ERROR;
+						goto IMG_exit;
 					}
 
 				} else {
@@ -555,8 +461,7 @@ int PicBuf_to_IMG(const GEN_PAR * pg, const OUT_PAR * po)
 				/* no bit string open   */
 
 				if ((empty_SR_len =
-				     empty_SR_IMG(row_c, act_pos,
-						  pbuf)) > 0) {
+				     empty_SR_IMG(row, act_pos, Img_w)) > 0) {
 					act_pos += empty_SR_len;
 					if ((err =
 					     write_empty_SR_IMG((Byte)
@@ -566,8 +471,7 @@ int PicBuf_to_IMG(const GEN_PAR * pg, const OUT_PAR * po)
 
 				} else
 				    if ((full_SR_len =
-					 full_SR_IMG(row_c, act_pos,
-						     pbuf)) > 0) {
+					 full_SR_IMG(row, act_pos, Img_w)) > 0) {
 					act_pos += full_SR_len;
 					if ((err =
 					     write_full_SR_IMG((Byte)
@@ -577,18 +481,12 @@ int PicBuf_to_IMG(const GEN_PAR * pg, const OUT_PAR * po)
 
 				} else
 				    if ((PR_len =
-					 PR_IMG(row_c, act_pos,
-						pbuf)) > 0) {
+					 PR_IMG(row, act_pos, Img_w)) > 0) {
 					if ((err =
 					     write_PR_IMG((Byte)
 							  (PR_len + 1),
-							  get_byte_IMG
-							  (row_c, act_pos,
-							   pbuf),
-							  get_byte_IMG
-							  (row_c,
-							   act_pos + 1,
-							   pbuf),
+							  row[act_pos],
+							  row[act_pos + 1],
 							  fd)) != 0)
 						goto IMG_exit;
 					act_pos += (PR_len + 1) * 2;
@@ -612,6 +510,7 @@ int PicBuf_to_IMG(const GEN_PAR * pg, const OUT_PAR * po)
 	Eprintf("\no close\n");
 
       IMG_exit:
+	free(row_hash);
 	if (fd != NULL && fd != stdout)
 		if (fclose(fd) != 0) {
 			PError("\nhp2xx -- closing IMG:");
@@ -24,6 +24,7 @@ to_jpg.c - JPEG image converter part of hp2xx
 
 2002/04/07 MK derived from to_tif.c based on libjpeg's example.c and 
               libjpeg.doc
+2026/10/19    colour rows via RowBuf_to_RGB()
 *******************************************************************/
 
 #include <stdio.h>
@@ -93,6 +94,12 @@ int PicBuf_to_JPG(const GEN_PAR * pg, const OUT_PAR * po)
 	for (y = 0; y < W; ++y) {
 		if ((row = get_RowBuf(po->picbuf, (W - 1) - y)) == NULL)
 			break;
+		if (D > 1) {
+			RowBuf_to_RGB(row, po->picbuf, jpgbuf);
+			row_pointer[0] = &jpgbuf[0];
+			(void) jpeg_write_scanlines(&cinfo, row_pointer, 1);
+			continue;
+		}
 		memset(jpgbuf, 0, (size_t) S);
 		i = 0;
 		for (x = 0; x < H; ++x) {
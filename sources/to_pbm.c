@@ -8,38 +8,132 @@
  ** 94/02/10  V 2.00  IJMP Add colour/use binary mode
  **			   (IJMP = Ian_MacPhedran@engr.usask.ca)
  ** 94/02/14  V 2.10  HWW  Adapted to changes in hp2xx.h
+ ** 26/10/19              P6: whole rows via RowBuf_to_RGB()
+ ** 26/10/19              Modes pgm & pam. Rows are converted into a
+ **                       band buffer, written by one fwrite() per band
  **/
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "bresnham.h"
 #include "hp2xx.h"
 #include "pendef.h"
-#define GGE >>=
-#define MAXOUTPUTROWS 70
+#define MAXOUTPUTROWS 70	/* Line length of ASCII formats */
+#define PNM_BAND (64 * 1024)	/* Bytes per fwrite()           */
+
+
+typedef enum { PNM_PBM, PNM_PGM, PNM_PPM, PNM_PAM } PNM_type;
+
+#ifdef PBMascii
+static const int ascii = TRUE;	/* P1, P2, P3 (PAM is binary only) */
+#else
+static const int ascii = FALSE;
+#endif				/* PBMascii */
+
+
+
+static Byte *samples_to_ascii(const Byte * s, int n, Byte * out)
+/**
+ ** Decimal samples, lines no longer than MAXOUTPUTROWS.
+ ** Needs at most 4 * n + 1 bytes.
+ **/
+{
+	int i, col, v;
+
+	for (i = col = 0; i < n; i++) {
+		v = s[i];
+		if (col > MAXOUTPUTROWS - 4) {
+			*out++ = '\n';
+			col = 0;
+		} else if (i > 0) {
+			*out++ = ' ';
+			col++;
+		}
+		if (v >= 100) {
+			*out++ = (Byte) ('0' + v / 100);
+			col++;
+		}
+		if (v >= 10) {
+			*out++ = (Byte) ('0' + v / 10 % 10);
+			col++;
+		}
+		*out++ = (Byte) ('0' + v % 10);
+		col++;
+	}
+	*out++ = '\n';
+	return out;
+}
+
+
+
+static Byte *row_to_PNM(const RowBuf * row, const PicBuf * pb,
+			PNM_type type, Byte * smp, Byte * out)
+/**
+ ** Convert one row, append it to out and return the new end
+ **/
+{
+	const Byte *s;
+	Byte *d;
+	int x, n;
+
+	switch (type) {
+	case PNM_PBM:		/* Picture buffer bits as they are */
+		if (!ascii) {
+			memcpy(out, row->buf, (size_t) pb->nb);
+			return out + pb->nb;
+		}
+		n = pb->nb * 8;
+		for (x = 0; x < n; x++)
+			smp[x] = (row->buf[x >> 3] >> (7 - (x & 7))) & 1;
+		break;
+	case PNM_PAM:
+		if (pb->depth == 1) {	/* BLACKANDWHITE: 0 is black */
+			for (x = 0; x < pb->nc; x++)
+				*out++ = (row->buf[x >> 3] &
+					  (0x80 >> (x & 7))) ? 0 : 1;
+			return out;
+		}
+		RowBuf_to_RGB(row, pb, out);
+		return out + 3 * pb->nc;
+	case PNM_PPM:
+		if (!ascii) {
+			RowBuf_to_RGB(row, pb, out);
+			return out + 3 * pb->nc;
+		}
+		RowBuf_to_RGB(row, pb, smp);
+		n = 3 * pb->nc;
+		break;
+	case PNM_PGM:		/* ITU-R BT.601 luma, as ppmtopgm */
+		RowBuf_to_RGB(row, pb, smp);
+		d = ascii ? smp : out;
+		for (x = 0, s = smp; x < pb->nc; x++, s += 3)
+			d[x] = (Byte) ((299 * s[0] + 587 * s[1] +
+					114 * s[2] + 500) / 1000);
+		if (!ascii)
+			return out + pb->nc;
+		n = pb->nc;
+		break;
+	default:
+		return out;
+	}
+	return samples_to_ascii(smp, n, out);
+}
 
 
 
 int PicBuf_to_PBM(const GEN_PAR * pg, const OUT_PAR * po)
+/**
+ ** Modes pbm (PPM for color pictures), pgm and pam
+ **/
 {
-	FILE *fd;
-	int row_c, byte_c, x;
+	FILE *fd = NULL;
+	int row_c, n_smp, err;
+	size_t row_max, band_size;
 	const RowBuf *row;
 	const PicBuf *pb;
-#if 0
-#ifdef PBMascii
-	int bit, row_count = 0;
-	char *ppm[] = { "1 1 1", "0 0 0", "1 0 0", "0 1 0",
-		"0 0 1", "0 1 1", "1 0 1", "1 1 0"
-	};
-#else
-	int ppm[][3] =
-	    { {255, 255, 255}, {0, 0, 0}, {255, 0, 0}, {0, 255, 0},
-	{0, 0, 255}, {0, 255, 255}, {255, 0, 255}, {255, 255, 0}
-	};
-#endif				/*PBMascii */
-#endif				/* used ? */
-	int colour;
+	PNM_type type;
+	Byte *band = NULL, *smp = NULL, *p;
 
 	if (pg == NULL || po == NULL)
 		return ERROR;
@@ -47,8 +141,22 @@ int PicBuf_to_PBM(const GEN_PAR * pg, const OUT_PAR * po)
 	if (pb == NULL)
 		return ERROR;
 
+	switch (pg->xx_mode) {
+	case XX_PGM:
+		type = PNM_PGM;
+		break;
+	case XX_PAM:
+		type = PNM_PAM;
+		break;
+	default:
+		type = (pb->depth > 1) ? PNM_PPM : PNM_PBM;
+		break;
+	}
+
 	if (!pg->quiet)
-		Eprintf("\nWriting PBM output: %s\n", po->outfile);
+		Eprintf("\nWriting %s output: %s\n",
+			(type == PNM_PBM) ? "PBM" : (type == PNM_PGM) ? "PGM" :
+			(type == PNM_PPM) ? "PPM" : "PAM", po->outfile);
 	if (*po->outfile != '-') {
 
 #ifdef VAX
@@ -62,117 +170,66 @@ int PicBuf_to_PBM(const GEN_PAR * pg, const OUT_PAR * po)
 	} else
 		fd = stdout;
 
-	if (pb->depth > 1) {
-#ifdef PBMascii
-		if (fprintf(fd, "P3\n") == EOF)
-			goto ERROR_EXIT;
-		if (fprintf(fd, "%d %d\n1\n", pb->nc, pb->nr) == EOF)
-			goto ERROR_EXIT;
-#else
-		if (fprintf(fd, "P6\n") == EOF)
-			goto ERROR_EXIT;
-		if (fprintf(fd, "%d %d\n255\n", pb->nc, pb->nr) == EOF)
-			goto ERROR_EXIT;
-#endif				/* PBMascii */
+	switch (type) {
+	case PNM_PBM:
+		err = fprintf(fd, "P%c\n%d %d\n", ascii ? '1' : '4',
+			      pb->nb * 8, pb->nr);
+		break;
+	case PNM_PGM:
+		err = fprintf(fd, "P%c\n%d %d\n255\n", ascii ? '2' : '5',
+			      pb->nc, pb->nr);
+		break;
+	case PNM_PPM:
+		err = fprintf(fd, "P%c\n%d %d\n255\n", ascii ? '3' : '6',
+			      pb->nc, pb->nr);
+		break;
+	default:
+		err = fprintf(fd,
+			      "P7\nWIDTH %d\nHEIGHT %d\nDEPTH %d\nMAXVAL %d\n"
+			      "TUPLTYPE %s\nENDHDR\n", pb->nc, pb->nr,
+			      (pb->depth == 1) ? 1 : 3,
+			      (pb->depth == 1) ? 1 : 255,
+			      (pb->depth == 1) ? "BLACKANDWHITE" : "RGB");
+		break;
+	}
+	if (err == EOF)
+		goto ERROR_EXIT;
 
-		for (row_c = 0; row_c < pb->nr; row_c++) {
-			row = get_RowBuf(pb, pb->nr - row_c - 1);
-			if (row == NULL)
-				continue;
+  /**
+   ** Space for the largest row a format may produce, and
+   ** for as many rows as fit into one band
+   **/
+	n_smp = MAX(pb->nb * 8, 3 * pb->nc);
+	row_max = 4 * (size_t) n_smp + 1;
+	band_size = MAX(row_max, (PNM_BAND / row_max) * row_max);
+	band = (Byte *) malloc(band_size);
+	smp = (Byte *) malloc((size_t) n_smp);
+	if (band == NULL || smp == NULL) {
+		Eprintf("\nNo memory for PBM band buffer\n");
+		goto ERROR_EXIT_2;
+	}
 
-			for (x = 0; x < pb->nc; x++) {
-				colour = index_from_RowBuf(row, x, pb);
-#ifdef PBMascii
-				if (fprintf(fd, "%s", ppm[colour]) == EOF)
-					goto ERROR_EXIT;
-#else
-/*	    if (fprintf(fd,"%c%c%c",ppm[colour][0],ppm[colour][1],
-		ppm[colour][2]) == EOF) goto ERROR_EXIT;
-*/
-				if (fprintf
-				    (fd, "%c%c%c", pt.clut[colour][0],
-				     pt.clut[colour][1],
-				     pt.clut[colour][2]) == EOF)
-					goto ERROR_EXIT;
-#endif				/* PBMascii */
-#ifdef PBMascii
-				row_count++;
-				if (row_count >= MAXOUTPUTROWS) {
-					row_count = 0;
-					if (putc('\n', fd) == EOF)
-						goto ERROR_EXIT;
-				} else {
-					if (putc(' ', fd) == EOF)
-						goto ERROR_EXIT;
-				}
-#endif				/* PBMascii */
-			}
-			if ((!pg->quiet) && (row_c % 10 == 0))
-				/* For the impatients among us ...   */
-				Eprintf(".");
-#ifdef PBMascii
-			row_count = 0;
-			putc('\n', fd);
-#endif				/* PBMascii */
+	for (row_c = 0, p = band; row_c < pb->nr; row_c++) {
+		if ((size_t) (band + band_size - p) < row_max) {
+			if (fwrite(band, 1, (size_t) (p - band), fd) !=
+			    (size_t) (p - band))
+				goto ERROR_EXIT;
+			p = band;
 		}
-	} else {
-#ifdef PBMascii
-		if (fprintf(fd, "P1\n") == EOF)
-#else
-		if (fprintf(fd, "P4\n") == EOF)
-#endif				/* PBMascii */
-			goto ERROR_EXIT;
-		if (fprintf(fd, "%d %d\n", (pb->nb) * 8, pb->nr) == EOF)
-			goto ERROR_EXIT;
+		row = get_RowBuf(pb, pb->nr - row_c - 1);
+		if (row == NULL)
+			continue;
+		p = row_to_PNM(row, pb, type, smp, p);
 
-		for (row_c = 0; row_c < pb->nr; row_c++) {
-			row = get_RowBuf(pb, pb->nr - row_c - 1);
-			if (row == NULL)
-				continue;
-
-			for (byte_c = x = 0; byte_c < pb->nb; byte_c++)
-#ifdef PBMascii
-			{
-				for (bit = 128; bit; bit GGE 1, x++)
-					if (bit & row->buf[byte_c]) {
-						if (putc('1', fd) == EOF)
-							goto ERROR_EXIT;
-						row_count++;
-						if (row_count >=
-						    MAXOUTPUTROWS) {
-							row_count = 0;
-							if (putc('\n', fd)
-							    == EOF)
-								goto ERROR_EXIT;
-						}
-					} else {
-						putc('0', fd);
-						row_count++;
-						if (row_count >=
-						    MAXOUTPUTROWS) {
-							row_count = 0;
-							if (putc('\n', fd)
-							    == EOF)
-								goto ERROR_EXIT;
-						}
-					}
-			}
-#else
-			{
-				if (putc(row->buf[byte_c], fd) == EOF)
-					goto ERROR_EXIT;
-			}
-#endif				/* PBMascii */
-			if ((!pg->quiet) && (row_c % 10 == 0))
-				/* For the impatients among us ...   */
-				Eprintf(".");
-#ifdef PBMascii
-			row_count = 0;
-			putc('\n', fd);
-#endif				/* PBMascii */
-		}
+		if ((!pg->quiet) && (row_c % 10 == 0))
+			/* For the impatients among us ...   */
+			Eprintf(".");
 	}
+	if (fwrite(band, 1, (size_t) (p - band), fd) != (size_t) (p - band))
+		goto ERROR_EXIT;
 	fflush(fd);
+	free(smp);
+	free(band);
 
 	if (!pg->quiet)
 		Eprintf("\n");
@@ -182,6 +239,10 @@ int PicBuf_to_PBM(const GEN_PAR * pg, const OUT_PAR * po)
 
       ERROR_EXIT:
 	PError("write_PBM");
-/*ERROR_EXIT_2:*/
+      ERROR_EXIT_2:
+	free(smp);
+	free(band);
+	if (fd != NULL && fd != stdout)
+		fclose(fd);
 	return ERROR;
 }
@@ -49,19 +49,27 @@ copies.
  ** 94/02/14  V 1.20a HWW  Adapted to changes in hp2xx.h
  ** 97/12/1           MK   add initialization code for A3 paper size
  ** 99/05/10         RS/MK autoselect A4/A3/A2 paper, reduce margins
+ ** 26/10/19                Delta row compression (method #3); per row
+ **                        and plane, the shortest of methods 0, 2, 3
+ ** 26/10/19                Table driven KCMY separation
+ ** 26/10/19                Compression by RLE_packbits() of rle.c
  **/
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "bresnham.h"
 #include "pendef.h"
 #include "hp2xx.h"
+#include "rle.h"
 
 
 
 #define	PCL_FIRST 	1	/* Bit mask!    */
 #define	PCL_LAST 	2	/* Bit mask!    */
 
+#define	PCL_PLANES	4	/* Max. number of color planes per row */
+
 
 /**
  ** Used for compression ON/off switch:
@@ -74,178 +82,131 @@ static int Deskjet_specials = FALSE;
  **/
 static Byte *p_K, *p_C, *p_M, *p_Y;	/* Buffer ptrs (CMYK bits) */
 
+/**
+ ** KCMY separation table: For the i-th byte of the pixels of one plane
+ ** byte (i < depth) and each of its 256 values, the bits it contributes
+ ** to the K, C, M and Y planes, packed as  K << 24 | C << 16 | M << 8 | Y
+ **/
+static unsigned long *p_T;
+
 
 
 /**
- ** Data & functions for (TIFF) compression:
+ ** Buffer for (TIFF) compression, see RLE_packbits():
  **
  ** Note: Usually, the buffer p_B receives less data than the
  **	  original (i.e., < nb). However, "temporary" increases
  **	  are possible. To allow for them, we allocate a few extra bytes.
  **	  If the buffer eventually really grows, we won't use compression!
- **	  "n_B" keeps track of the amount of extra buffer space left.
  **/
-#define	B_EXTRASPACE	16
 static Byte *p_B;		/* Buffer for compression  */
-static int n_B;			/* Counter for extra space */
-
-
 
-
-static int TIFF_n_repeats(Byte * p1, int nb)
 /**
- **	There are "nb" bytes in buffer "p1"
- **	Return number of identical bytes in a sequence (0, 2 ... nb)
+ ** Data for delta row compression: The printer keeps a seed row per
+ ** color plane, i.e. the previous row of that plane as transferred
+ ** (all zero at the start of raster graphics).
  **/
-{
-	int i;
-	Byte *p2;
-
-	p2 = p1 + 1;
-	if (nb < 2 || *p2 != *p1)
-		return 0;
-	for (i = 1; i < nb && *p1 == *p2; p1++, p2++)
-		i++;
-	return i;
-}
+static Byte *p_D;		/* Buffer for delta row compression */
+static Byte *p_S[PCL_PLANES];	/* Seed rows                        */
+
 
 
 
-static int TIFF_n_irregs(Byte * p1, int nb)
 /**
- **	There are "nb" bytes in buffer "p1"
- **	Return number of irregular (non-identical) bytes
- **	   in a sequence (0, 1, 2 ... nb)
+ ** PCL data compression method #2 (TIFF)
+ **
+ ** Compress data in buf; leave compressed data there.
+ ** Return number of valid bytes in buf of OK.
+ ** Return -1 if no compression done.
  **/
-{
-	int i;
-	Byte *p2;
-
-	if (nb < 2)
-		return nb;	/* 0 or 1 */
-	p2 = p1 + 1;
-	for (i = 1; i < nb && *p1 != *p2; p1++, p2++)
-		i++;
-	return (i == nb) ? nb : i - 1;
-}
-
 
-
-static int TIFF_compress(Byte * src, Byte * dst, int nb)
+static int compress_buf_TIFF(Byte * buf, int nb)
 {
-  /**
-   ** Either there is a block of repetitions or non-repeating bytes
-   ** at the buffer start. If repetitions, compress them. If not,
-   ** buffer them and compress next block of repetitions.
-   **/
-	int i, l, count = 0;
-
-	l = TIFF_n_repeats(src, nb);	/* l == 0 or  l >= 2    */
-	while (l > 128) {
-		*dst++ = (-127);	/* 128 repetitions      */
-		*dst++ = *src;
-		count += 2;
-		l -= 128;
-		nb -= 128;
-		src += 128;
-		n_B += 126;	/* 128 bytes coded as 2 */
-
-	}
-	if (l > 0) {
-		*dst++ = (Byte) (1 - l);	/* l repetitions        */
-		*dst++ = *src;
-		count += 2;
-		src += l;
-		nb -= l;
-		n_B += (l - 2);	/* l bytes coded as 2   */
-	}
-
-	if (nb < 0)
-		return -1;	/* should never happen  */
-	if (nb == 0)
-		return count;	/* "count" bytes buffered */
-
-
-	/* Irregular sequence */
-
-	l = TIFF_n_irregs(src, nb);	/* l == 0 or  l >= 2    */
-	while (l > 128) {
-		n_B -= 1;
-		if (n_B < 0)
-			return -1;	/* Buffer overflow!     */
-
-		*dst++ = 127;	/* 128 repetitions      */
-		for (i = 0; i < 128; i++)
-			*dst++ = *src++;
-		count += 129;
-		l -= 128;
-		nb -= 128;
-
-	}
-	if (l > 0) {
-		n_B -= 1;
-		if (n_B < 0)
-			return -1;	/* Buffer overflow!     */
-
-		*dst++ = (Byte) (l - 1);	/* l repetitions        */
-		for (i = 0; i < l; i++)
-			*dst++ = *src++;
-		count += (l + 1);
-		nb -= l;
-	}
+	if (Deskjet_specials == FALSE)
+		return -1;	/* Plain PLC L3 does not support compression! */
 
-	if (nb < 0)
-		return -1;	/* should never happen          */
+	if (p_B == NULL)	/* No buffer for compression!       */
+		return -1;
 
-	if (nb == 0) {		/* At end-of-buffer: evaluate     */
-		if (n_B > B_EXTRASPACE)	/* Regular exit: Return             */
-			return count;	/*   number of compressed bytes */
-		else
-			return -1;	/* Nothing gained !             */
-	}
-	i = TIFF_compress(src, dst, nb);	/* Recursion for rest   */
-	return (i == -1) ? -1 : i + count;
+	return RLE_packbits(buf, nb, p_B);
 }
 
 
 
+
 /**
- ** PCL data compression method #2 (TIFF)
+ ** PCL data compression method #3 (delta row)
  **
- ** Compress data in buf; leave compressed data there.
- ** Return number of valid bytes in buf of OK.
+ ** Code only the bytes of buf differing from the seed row, in runs
+ ** of up to 8 bytes. Each run is preceded by a command byte: 3 bits
+ ** run length - 1, 5 bits offset from the end of the previous run.
+ ** Offsets of 31 or more continue in extra bytes, 255 meaning "more".
+ ** An empty row repeats the seed row.
+ **
+ ** Leave compressed data in p_D.
+ ** Return number of valid bytes in p_D if shorter than nb.
  ** Return -1 if no compression done.
  **/
 
-static int compress_buf_TIFF(Byte * buf, int nb)
+static int compress_buf_delta(const Byte * buf, const Byte * seed, int nb)
 {
-	if (Deskjet_specials == FALSE)
-		return -1;	/* Plain PLC L3 does not support compression! */
+	int i, n, offset, need, count = 0, last = 0;
+	Byte *dst = p_D;
 
-	if (p_B == NULL)	/* No buffer for compression!       */
+	if (Deskjet_specials == FALSE || p_D == NULL || seed == NULL)
 		return -1;
 
-	n_B = B_EXTRASPACE;	/* Init. extra space counter    */
-	return TIFF_compress(buf, p_B, nb);	/* Recursive function!  */
+	for (i = 0; i < nb;) {
+		if (buf[i] == seed[i]) {
+			i++;
+			continue;
+		}
+		for (n = 1; n < 8 && i + n < nb && buf[i + n] != seed[i + n];
+		     n++);
+		offset = i - last;
+		need = 1 + n + ((offset >= 31) ? 1 + (offset - 31) / 255 : 0);
+		if (count + need >= nb)
+			return -1;	/* Nothing gained !             */
+		count += need;
+
+		*dst++ = (Byte) (((n - 1) << 5) | MIN(offset, 31));
+		if (offset >= 31) {
+			for (offset -= 31; offset >= 255; offset -= 255)
+				*dst++ = 255;
+			*dst++ = (Byte) offset;
+		}
+		memcpy(dst, buf + i, (size_t) n);
+		dst += n;
+		i += n;
+		last = i;
+	}
+	return count;
 }
 
 
 
 
-static void Buf_to_PCL(Byte * buf, int nb, int mode, FILE * fd)
+static void Buf_to_PCL(Byte * buf, int nb, int plane, int mode, FILE * fd)
 /**
- ** Output the raw bit stream
- **   (This should be an ideal place for data compression)
+ ** Output the bit stream of one color plane, coded with the
+ ** shortest of compression methods 0 (none), 2 (TIFF), 3 (delta row)
  **/
 {
 	int ncb;		/* Number of compressed bytes   */
+	int ndb;		/* Number of delta row bytes    */
 	Byte *p;		/* Buffer pointer               */
+	Byte *seed = p_S[plane];
 
 	if (mode & PCL_FIRST)
 		fprintf(fd, "\033*b");
 
 	ncb = compress_buf_TIFF(buf, nb);
-	if (ncb == -1) {
+	ndb = compress_buf_delta(buf, seed, nb);
+	if (ndb != -1 && (ncb == -1 || ndb < ncb)) {
+		ncb = ndb;
+		p = p_D;	/* Use delta row buffer         */
+		fprintf(fd, "3m");	/* Compression method 3 (delta) */
+	} else if (ncb == -1) {
 		ncb = nb;
 		p = buf;	/* Use original buffer & length */
 		fprintf(fd, "0m");	/* No compression               */
@@ -253,6 +214,8 @@ static void Buf_to_PCL(Byte * buf, int nb, int mode, FILE * fd)
 		p = p_B;	/* Use compression buffer       */
 		fprintf(fd, "2m");	/* Compression method 2 (TIFF)  */
 	}
+	if (seed != NULL)	/* Any method updates the seed row */
+		memcpy(seed, buf, (size_t) nb);
 
 	if (mode & PCL_LAST)
 		fprintf(fd, "%dW", ncb);
@@ -270,13 +233,84 @@ static void Buf_to_PCL(Byte * buf, int nb, int mode, FILE * fd)
 static void KCMY_Buf_to_PCL(int nb, int is_KCMY, FILE * fd)
 {
 	if (is_KCMY) {
-		Buf_to_PCL(p_K, nb, PCL_FIRST, fd);
-		Buf_to_PCL(p_C, nb, 0, fd);
+		Buf_to_PCL(p_K, nb, 0, PCL_FIRST, fd);
+		Buf_to_PCL(p_C, nb, 1, 0, fd);
 	} else			/* is only CMY:     */
-		Buf_to_PCL(p_C, nb, PCL_FIRST, fd);
+		Buf_to_PCL(p_C, nb, 0, PCL_FIRST, fd);
 
-	Buf_to_PCL(p_M, nb, 0, fd);
-	Buf_to_PCL(p_Y, nb, PCL_LAST, fd);
+	Buf_to_PCL(p_M, nb, is_KCMY ? 2 : 1, 0, fd);
+	Buf_to_PCL(p_Y, nb, is_KCMY ? 3 : 2, PCL_LAST, fd);
+}
+
+
+
+
+static unsigned long KCMY_of_index(int color_index, Byte mask)
+/**
+ ** Plane bits of one pixel of the given color at the mask position:
+ ** black is black, any other color sets C, M, Y where the mask bit
+ ** of its R, G, B component is 0 (i.e. full intensity = no ink)
+ **/
+{
+	const BYTE *rgb = pt.clut[color_index];
+
+	if (color_index == xxBackground)
+		return 0L;
+	if (rgb[0] + rgb[1] + rgb[2] == 0)
+		return (unsigned long) mask << 24;
+	return ((unsigned long) (mask & ~rgb[0]) << 16) |
+	    ((unsigned long) (mask & ~rgb[1]) << 8) |
+	    (unsigned long) (mask & ~rgb[2]);
+}
+
+
+
+
+static int make_KCMY_table(int depth)
+/**
+ ** Fill p_T for a picture buffer of 4 (two pixels per byte) or
+ ** 8 bits per pixel, using the current color lookup table
+ **/
+{
+	int i, v, j, ppb = 8 / depth;
+	unsigned long w;
+
+	p_T = malloc((size_t) depth * 256 * sizeof(unsigned long));
+	if (p_T == NULL)
+		return ERROR;
+
+	for (i = 0; i < depth; i++)
+		for (v = 0; v < 256; v++) {
+			for (j = 0, w = 0L; j < ppb; j++)
+				w |= KCMY_of_index((ppb == 1) ? v :
+						   (j == 0) ? v >> 4 : v & 0x0F,
+						   (Byte) (0x80 >> (i * ppb + j)));
+			p_T[i * 256 + v] = w;
+		}
+	return 0;
+}
+
+
+
+
+static void RowBuf_to_KCMY(const Byte * src, int nb, int depth)
+/**
+ ** Separate a row of color indices into the K, C, M, Y planes,
+ ** one byte of all four planes at a time
+ **/
+{
+	const unsigned long *t;
+	unsigned long w;
+	int x, i;
+
+	for (x = 0; x < nb; x++) {
+		for (i = 0, w = 0L, t = p_T; i < depth; i++, t += 256)
+			w |= t[*src++];
+		p_K[x] = (Byte) (w >> 24);
+		p_C[x] = (Byte) (w >> 16);
+		p_M[x] = (Byte) (w >> 8);
+		p_Y[x] = (Byte) w;
+	}
 }
 
 
@@ -497,8 +531,7 @@ int PicBuf_to_PCL(const GEN_PAR * pg, const OUT_PAR * po)
 {
 	FILE *fd = stdout;
 	RowBuf *row;
-	int row_c, i, x, color_index, offset, err;
-	Byte mask;
+	int row_c, i, err;
 
 	err = 0;
 	if (!pg->quiet)
@@ -519,7 +552,7 @@ int PicBuf_to_PCL(const GEN_PAR * pg, const OUT_PAR * po)
 		p_M = calloc((size_t) po->picbuf->nb, sizeof(Byte));
 		p_Y = calloc((size_t) po->picbuf->nb, sizeof(Byte));
 		if (p_K == NULL || p_C == NULL || p_M == NULL
-		    || p_Y == NULL) {
+		    || p_Y == NULL || make_KCMY_table(po->picbuf->depth)) {
 			Eprintf
 			    ("\nCannot 'calloc' CMYK memory -- sorry, use B/W!\n");
 			goto PCL_exit;
@@ -528,8 +561,10 @@ int PicBuf_to_PCL(const GEN_PAR * pg, const OUT_PAR * po)
   /**
    ** Optional memory; for compression
    **/
-	n_B = B_EXTRASPACE;
-	p_B = calloc((size_t) (po->picbuf->nb + n_B), sizeof(Byte));
+	p_B = calloc((size_t) (po->picbuf->nb + RLE_EXTRASPACE), sizeof(Byte));
+	p_D = calloc((size_t) po->picbuf->nb, sizeof(Byte));
+	for (i = 0; i < PCL_PLANES; i++)
+		p_S[i] = calloc((size_t) po->picbuf->nb, sizeof(Byte));
 
 
 	if (*po->outfile != '-') {
@@ -563,78 +598,11 @@ int PicBuf_to_PCL(const GEN_PAR * pg, const OUT_PAR * po)
 		row = get_RowBuf(po->picbuf, row_c);
 
 		if (po->picbuf->depth == 1)
-			Buf_to_PCL(row->buf, po->picbuf->nb,
+			Buf_to_PCL(row->buf, po->picbuf->nb, 0,
 				   PCL_FIRST | PCL_LAST, fd);
 		else {
-			for (x = 0; x < po->picbuf->nb; x++)
-				p_K[x] = p_C[x] = p_M[x] = p_Y[x] = 0;
-
-			for (x = offset = 0; x < (po->picbuf->nb << 3);
-			     x++, offset = (x >> 3)) {
-				color_index =
-				    index_from_RowBuf(row, x, po->picbuf);
-
-				if (color_index == xxBackground)
-					continue;
-				else {
-					mask = 0x80;
-					if ((i = x & 0x07) != 0)
-						mask >>= i;
-
-					if (pt.clut[color_index][0] +
-					    pt.clut[color_index][1] +
-					    pt.clut[color_index][2] == 0) {
-						*(p_K + offset) |= mask;
-					} else {
-						*(p_C + offset) |=
-						    (mask ^
-						     (pt.
-						      clut[color_index][0]
-						      & mask));
-						*(p_M + offset) |=
-						    (mask ^
-						     (pt.
-						      clut[color_index][1]
-						      & mask));
-						*(p_Y + offset) |=
-						    (mask ^
-						     (pt.
-						      clut[color_index][2]
-						      & mask));
-					}
-/*					
-				switch (color_index)
-				{
-				  case xxForeground:
-					*(p_K + offset) |= mask;
-					break;
-				  case xxRed:
-					*(p_M + offset) |= mask;
-					*(p_Y + offset) |= mask;
-					break;
-				  case xxGreen:
-					*(p_C + offset) |= mask;
-					*(p_Y + offset) |= mask;
-					break;
-				  case xxBlue:
-					*(p_C + offset) |= mask;
-					*(p_M + offset) |= mask;
-					break;
-				  case xxCyan:
-					*(p_C + offset) |= mask;
-					break;
-				  case xxMagenta:
-					*(p_M + offset) |= mask;
-					break;
-				  case xxYellow:
-					*(p_Y + offset) |= mask;
-					break;
-				  default:
-					break;
-				}
-*/
-				}
-			}
+			RowBuf_to_KCMY(row->buf, po->picbuf->nb,
+				       po->picbuf->depth);
 
 			switch (po->specials) {
 			case 3:
@@ -646,7 +614,7 @@ int PicBuf_to_PCL(const GEN_PAR * pg, const OUT_PAR * po)
 				break;
 			default:
 				KCMY_to_K(po->picbuf->nb);
-				Buf_to_PCL(p_K, po->picbuf->nb,
+				Buf_to_PCL(p_K, po->picbuf->nb, 0,
 					   PCL_FIRST | PCL_LAST, fd);
 				break;
 			}
@@ -670,10 +638,21 @@ int PicBuf_to_PCL(const GEN_PAR * pg, const OUT_PAR * po)
 		free(p_C);
 	if (p_K != NULL)
 		free(p_K);
+	if (p_T != NULL)
+		free(p_T);
 
 	if (p_B != NULL)
 		free(p_B);
+	if (p_D != NULL)
+		free(p_D);
+	for (i = 0; i < PCL_PLANES; i++) {
+		if (p_S[i] != NULL)
+			free(p_S[i]);
+		p_S[i] = NULL;
+	}
 
 	p_K = p_C = p_M = p_Y = NULL;
+	p_T = NULL;
+	p_B = p_D = NULL;
 	return err;
 }
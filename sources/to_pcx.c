@@ -52,6 +52,7 @@ copies.
  **
  ** 00/03/05    3.4a  MK   Write PCX version 5 truecolor files in color mode,
  **                        corrected(?) version 2 palette for b/w mode 
+ ** 26/10/19              Runs found by RLE_run() of rle.c
  **/
 
 
@@ -60,11 +61,7 @@ copies.
 #include "bresnham.h"
 #include "pendef.h"
 #include "hp2xx.h"
-
-
-typedef enum { PCX_INIT, PCX_NORMAL, PCX_EXIT } PCXmode;
-
-
+#include "rle.h"
 
 
 static void RLEcode_to_file(int c, int repeat, FILE * fd)
@@ -89,44 +86,6 @@ static void RLEcode_to_file(int c, int repeat, FILE * fd)
 
 
 
-static void byte_to_PCX(Byte b, PCXmode mode, FILE * fd)
-{
-	static Byte last_b;
-	static int rept;
-
-	switch (mode) {
-	case PCX_NORMAL:
-		if (b == last_b) {
-			if (++rept == 63) {
-				RLEcode_to_file(last_b, rept, fd);
-				rept = 0;
-			}
-		} else {
-			if (rept)
-				RLEcode_to_file(last_b, rept, fd);
-			rept = 1;
-			last_b = b;
-		}
-		break;
-
-	case PCX_INIT:
-		rept = 0;
-		last_b = -2;	/* Init to impossible value     */
-		break;
-
-	case PCX_EXIT:
-		if (rept) {
-			RLEcode_to_file(last_b, rept, fd);
-			rept = 0;
-		}
-		break;
-	}
-}
-
-
-
-
-
 typedef struct {
 	char creator, version, encoding, bits;
 	short xmin, ymin, xmax, ymax, hres, vres;
@@ -297,13 +256,18 @@ static int start_PCX(const OUT_PAR * po, const GEN_PAR * pg, FILE * fd)
 
 
 static void Buf_to_PCX(Byte * pb, int nb, FILE * fd)
+/**
+ ** Runs of inverted bytes, at most 63 per code; none crosses a row
+ **/
 {
-	int x;
+	int x, l;
 
-	byte_to_PCX(0, PCX_INIT, fd);
-	for (x = 0; x < nb; x++)
-		byte_to_PCX(~*pb++, PCX_NORMAL, fd);
-	byte_to_PCX(0, PCX_EXIT, fd);	/* Flush        */
+	for (x = 0; x < nb; x += l) {
+		l = RLE_run(pb + x, nb - x);
+		for (; l > 63; l -= 63, x += 63)
+			RLEcode_to_file((Byte) ~pb[x], 63, fd);
+		RLEcode_to_file((Byte) ~pb[x], l, fd);
+	}
 }
 
 
@@ -336,22 +300,6 @@ int PicBuf_to_PCX(const GEN_PAR * pg, const OUT_PAR * po)
 		err = ERROR;
 		goto PCX_exit;
 	}
-#if 0
-	/* Backward since highest index is lowest line on screen! */
-	for (row_c = po->picbuf->nr - 1; row_c >= 0; row_c--) {
-		if ((!pg->quiet) && (row_c % 10 == 0))
-			/* For the impatient among us ...     */
-			Eprintf(".");
-		row = get_RowBuf(po->picbuf, row_c);
-		byte_to_PCX(0, PCX_INIT, fd);
-		pb = row->buf;
-/*	for (np=0; np < picbuf->depth; np++)*/
-		for (np = 0; np < h.planes; np++)
-			for (x = 0; x < po->picbuf->nb; x++)
-				byte_to_PCX(~*pb++, PCX_NORMAL, fd);
-		byte_to_PCX(0, PCX_EXIT, fd);	/* Flush        */
-	}
-#endif
 
   /**
    ** Allocate buffers for temporary conversion
@@ -380,7 +328,6 @@ int PicBuf_to_PCX(const GEN_PAR * pg, const OUT_PAR * po)
 			Eprintf(".");
 /*fprintf(stderr,"coverting row %d (%d bytes)\n",row_c,po->picbuf->nb);*/
 		row = get_RowBuf(po->picbuf, row_c);
-		byte_to_PCX(0, PCX_INIT, fd);
 
 		if (po->picbuf->depth == 1)
 			Buf_to_PCX(row->buf, po->picbuf->nb, fd);
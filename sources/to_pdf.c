@@ -25,6 +25,12 @@ copies.
 /** to_pdf.c:   Converter to Adobe Portable Document (PDF) Format using pdflib
  ** 
  ** 01/06/19  V 1.00 MK   derived from to_eps.c
+ ** 26/10/19               Arcs and Bezier curves as such (ARC, CUBIC)
+ ** 26/10/19               Line types as dash patterns (DEF_LT)
+ ** 26/10/19               Labels as text in Courier (TEXT)
+ ** 26/10/19               One document for all pages of a spool, and of
+ **                        all input files written to the same -f name;
+ **                        compressed content streams (-L), one font
  **/
 
 #include <stdio.h>
@@ -39,7 +45,6 @@ copies.
 #include "lindef.h"
 
 
-static int linecount = 0;
 static float xcoord2mm, ycoord2mm;
 static float xmin, ymin;
 
@@ -48,7 +53,16 @@ static PEN_W lastwidth;
 static int lastcap;
 static int lastjoin;
 static int lastlimit;
+static LineDash lastdash;
 static Byte lastred, lastgreen, lastblue;
+static int textfont;		/* Shared by all pages of the document */
+
+/**
+ ** The document stays open while pages come in, see pdf_close()
+ **/
+static PDF *pdf_doc = NULL;
+static char *pdf_name = NULL;
+static int pdf_page;
 
 int to_pdf(const GEN_PAR *, const OUT_PAR *);
 void pdf_init(const GEN_PAR *, const OUT_PAR *, PDF *, PEN_W);
@@ -57,21 +71,72 @@ void pdf_set_linecap(LineEnds type, double pensize, PDF * fd);
 void pdf_set_linejoin(LineJoins type, LineLimit limit, double pensize,
 		      PDF * fd);
 void pdf_set_color(PEN_C pencolor, PDF * fd);
+void pdf_set_dash(const LineDash * pd, PDF * fd);
+void pdf_text(const HPGL_Text * pt, const char *s, PDF * fd);
 void pdf_end(PDF *);
 
 #define PAGEMODE if (openpath==1) { PDF_stroke(md); openpath=0; }
 
 
 /**
- ** Close graphics file
+ ** Open the document, with one set of resources for all pages
+ **/
+static PDF *pdf_open(const GEN_PAR * pg, const OUT_PAR * po)
+{
+	PDF *fd;
+
+	PDF_boot();
+	fd = PDF_new();
+	pdf_name = (char *) malloc(strlen(po->outfile) + 1);
+	if (fd == NULL || pdf_name == NULL) {
+		Eprintf("\nNo memory for PDF document\n");
+		goto ERROR_EXIT;
+	}
+	if (PDF_open_file(fd, po->outfile) == -1) {
+		PError("hp2xx (pdf)");
+		goto ERROR_EXIT;
+	}
+	strcpy(pdf_name, po->outfile);
+	PDF_set_value(fd, "compress", (float) po->png_level);
+	PDF_set_info(fd, "Creator", "hp2xx " VERS_NO);
+	textfont = -1;
+	pdf_page = 0;
+	return fd;
+
+      ERROR_EXIT:
+	if (fd != NULL)
+		PDF_delete(fd);
+	PDF_shutdown();
+	free(pdf_name);
+	pdf_name = NULL;
+	return NULL;
+}
+
+
+/**
+ ** End of page
  **/
 void pdf_end(PDF * fd)
 {
 	PDF_end_page(fd);
-	PDF_close(fd);
-	PDF_delete(fd);
+}
+
+
+/**
+ ** End of document: After the last page, or if the file name changes
+ **/
+void pdf_close(const GEN_PAR * pg)
+{
+	if (pdf_doc == NULL)
+		return;
+	PDF_close(pdf_doc);
+	PDF_delete(pdf_doc);
 	PDF_shutdown();
-	linecount = 0;
+	pdf_doc = NULL;
+	if (!pg->quiet && pdf_page > 1)
+		Eprintf("\n%d pages written into one PDF file\n", pdf_page);
+	free(pdf_name);
+	pdf_name = NULL;
 }
 
 
@@ -123,6 +188,8 @@ void pdf_set_linecap(LineEnds type, double pensize, PDF * fd)
 	} else {
 		newcap = 1;
 	}
+	if (newcap == 0 && line_dash_has_dots(&CurrentLineDash))
+		newcap = 1;	/* Else dots of a dash pattern vanish */
 
 	if (newcap != lastcap) {
 		PDF_setlinecap(fd, newcap);
@@ -184,6 +251,30 @@ void pdf_set_linejoin(LineJoins type, LineLimit limit, double pensize,
 }
 
 
+/**
+ ** Set dash pattern
+ **/
+void pdf_set_dash(const LineDash * pd, PDF * fd)
+{
+	float len[LT_ELEMENTS + 1];
+	int i;
+
+	if (pd->n == lastdash.n && (pd->n == 0 ||
+				    memcmp(pd->len, lastdash.len,
+					   pd->n * sizeof(pd->len[0])) == 0))
+		return;
+
+	if (pd->n == 0)
+		PDF_setdash(fd, 0.0, 0.0);	/* Solid line */
+	else {
+		for (i = 0; i < pd->n; i++)
+			len[i] = pd->len[i] * xcoord2mm;
+		PDF_setpolydash(fd, len, pd->n);
+	}
+	lastdash = *pd;
+}
+
+
 /**
  ** Set RGB color
  **/
@@ -207,6 +298,26 @@ void pdf_set_color(PEN_C pencolor, PDF * fd)
 }
 
 
+/**
+ ** Show a label in Courier, spaced like the stick font it replaces
+ **/
+void pdf_text(const HPGL_Text * pt, const char *s, PDF * fd)
+{
+	if (textfont < 0)
+		textfont = PDF_findfont(fd, "Courier", "winansi", 0);
+	PDF_save(fd);
+	PDF_concat(fd, pt->m[0] * xcoord2mm, pt->m[1] * ycoord2mm,
+		   pt->m[2] * xcoord2mm, pt->m[3] * ycoord2mm,
+		   (pt->org.x - xmin) * xcoord2mm,
+		   (pt->org.y - ymin) * ycoord2mm);
+	PDF_setfont(fd, textfont, TEXT_EM);
+	PDF_set_value(fd, "charspacing", pt->adv - 0.6 * TEXT_EM);
+	PDF_show_xy(fd, s, 0.0, 0.0);
+	PDF_restore(fd);
+}
+
+
+
 /**
  ** basic PDF definitions
  **/
@@ -219,6 +330,7 @@ void pdf_init(const GEN_PAR * pg, const OUT_PAR * po, PDF * fd,
 
 	lastwidth = -1.0;
 	lastcap = lastjoin = lastlimit = -1;
+	lastdash.n = CurrentLineDash.n = 0;
 	lastred = lastgreen = lastblue = -1;
 
 	hmxpenw = pg->maxpensize / 20.0;	/* Half max. pen width, in mm   */
@@ -248,27 +360,31 @@ int to_pdf(const GEN_PAR * pg, const OUT_PAR * po)
 {
 	PlotCmd cmd;
 	PDF *md;
-	HPGL_Pt pt1 = { 0, 0 };
+	HPGL_Pt pt1 = { 0, 0 }, cp[3];
+	HPGL_Arc arc;
+	HPGL_Text text;
+	char *s;
+	double dx, dy, a1;
 	int pen_no = 0, err;
 	int openpath;
 	PEN_W pensize;
 
-	PDF_boot();
-
 	err = 0;
+	if (pdf_doc != NULL && strcmp(pdf_name, po->outfile) != 0)
+		pdf_close(pg);	/* Next output file */
 	if (!pg->quiet)
-		Eprintf("\n\n- Writing PDF code to \"%s\"\n",
-			*po->outfile == '-' ? "stdout" : po->outfile);
+		Eprintf("\n\n- Writing PDF code to \"%s\", page %d\n",
+			*po->outfile == '-' ? "stdout" : po->outfile,
+			pdf_doc == NULL ? 1 : pdf_page + 1);
 
-	/* Init. of PDF file: */
+	/* Init. of PDF file, unless pages come before */
 
-	md = PDF_new();
-	if (PDF_open_file(md, po->outfile) == -1) {
-		PError("hp2xx (pdf)");
+	if (pdf_doc == NULL && (pdf_doc = pdf_open(pg, po)) == NULL)
 		return ERROR;
-	}
+	md = pdf_doc;
+	pdf_page++;
 
-	/* header */
+	/* Page */
 
 	pensize = pt.width[DEFAULT_PEN_NO];	/* Default pen    */
 	pdf_init(pg, po, md, pensize);
@@ -289,18 +405,19 @@ int to_pdf(const GEN_PAR * pg, const OUT_PAR * po)
 	double pre_x = 0;
 	double pre_y = 0;
 	while ((cmd = PlotCmd_from_tmpfile()) != CMD_EOF) {
-		//printf("command : %d\n", cmd);
 		// ignore draw to after DEF_PC, fix "[2100] : Function must not be called in 'path' scope" error
-		if (pre_cmd == DEF_PC && cmd == DRAW_TO)
+		// same for a pattern changed within a polyline (DEF_LT)
+		if ((pre_cmd == DEF_PC || pre_cmd == DEF_LT)
+		    && (cmd == DRAW_TO || cmd == ARC || cmd == CUBIC))
 		{
 			pensize = pt.width[pen_no];
 			PAGEMODE;
 			pdf_set_linewidth((double)pensize, md);
 			pdf_set_linecap(CurrentLineAttr.End, (double)pensize, md);
 			pdf_set_linejoin(CurrentLineAttr.Join, CurrentLineAttr.Limit, (double)pensize, md);
+			pdf_set_dash(&CurrentLineDash, md);
 			pdf_set_color(pt.color[pen_no], md);
 			PDF_moveto(md, pre_x, pre_y);
-			printf("Find DRAW_TO after DEF_PC, add MOVE_TO\n");
 		}
 		switch (cmd) {
 		case NOP:
@@ -346,6 +463,15 @@ int to_pdf(const GEN_PAR * pg, const OUT_PAR * po)
 			pre_cmd = cmd;
 			break;
 
+		case DEF_LT:
+			if (load_line_dash(pg->td) < 0) {
+				PError("Unexpected end of temp. file");
+				err = ERROR;
+				goto PDF_exit;
+			}
+			pre_cmd = cmd;
+			break;
+
 		case MOVE_TO:
 			pensize = pt.width[pen_no];
 			PAGEMODE;
@@ -355,6 +481,7 @@ int to_pdf(const GEN_PAR * pg, const OUT_PAR * po)
 			pdf_set_linejoin(CurrentLineAttr.Join,
 					 CurrentLineAttr.Limit,
 					 (double) pensize, md);
+			pdf_set_dash(&CurrentLineDash, md);
 			pdf_set_color(pt.color[pen_no], md);
 
 			HPGL_Pt_from_tmpfile(&pt1);
@@ -383,6 +510,54 @@ int to_pdf(const GEN_PAR * pg, const OUT_PAR * po)
 			pre_cmd = cmd;
 			break;
 
+		case ARC:
+		case CUBIC:
+			pensize = pt.width[pen_no];
+			pdf_set_linewidth((double) pensize, md);
+			pdf_set_linecap(CurrentLineAttr.End,
+					(double) pensize, md);
+			pdf_set_linejoin(CurrentLineAttr.Join,
+					 CurrentLineAttr.Limit,
+					 (double) pensize, md);
+			pdf_set_color(pt.color[pen_no], md);
+
+			if (cmd == ARC) {
+				Arc_from_tmpfile(&arc);
+				dx = (arc.end.x - arc.center.x) * xcoord2mm;
+				dy = (arc.end.y - arc.center.y) * ycoord2mm;
+				a1 = atan2(dy, dx) * 180.0 / M_PI;
+				if (arc.sweep > 0)
+					PDF_arc(md,
+						(arc.center.x - xmin) * xcoord2mm,
+						(arc.center.y - ymin) * ycoord2mm,
+						sqrt(dx * dx + dy * dy),
+						a1 - arc.sweep * 180.0 / M_PI,
+						a1);
+				else
+					PDF_arcn(md,
+						 (arc.center.x - xmin) * xcoord2mm,
+						 (arc.center.y - ymin) * ycoord2mm,
+						 sqrt(dx * dx + dy * dy),
+						 a1 - arc.sweep * 180.0 / M_PI,
+						 a1);
+				pt1 = arc.end;
+			} else {
+				Cubic_from_tmpfile(cp);
+				PDF_curveto(md,
+					    (cp[0].x - xmin) * xcoord2mm,
+					    (cp[0].y - ymin) * ycoord2mm,
+					    (cp[1].x - xmin) * xcoord2mm,
+					    (cp[1].y - ymin) * ycoord2mm,
+					    (cp[2].x - xmin) * xcoord2mm,
+					    (cp[2].y - ymin) * ycoord2mm);
+				pt1 = cp[2];
+			}
+			pre_x = (pt1.x - xmin) * xcoord2mm;
+			pre_y = (pt1.y - ymin) * ycoord2mm;
+			openpath = 1;
+			pre_cmd = cmd;
+			break;
+
 		case PLOT_AT:
 			pensize = pt.width[pen_no];
 
@@ -400,6 +575,20 @@ int to_pdf(const GEN_PAR * pg, const OUT_PAR * po)
 			pre_cmd = cmd;
 			break;
 
+		case TEXT:
+			pensize = pt.width[pen_no];
+			pdf_set_color(pt.color[pen_no], md);
+
+			s = Text_from_tmpfile(&text);
+			PAGEMODE;
+			if (pensize > 0.05)
+				pdf_text(&text, s, md);
+			pt1 = text.org;
+			pre_x = (pt1.x - xmin) * xcoord2mm;
+			pre_y = (pt1.y - ymin) * ycoord2mm;
+			pre_cmd = cmd;
+			break;
+
 		default:
 			Eprintf("Illegal cmd in temp. file!");
 			err = ERROR;
@@ -407,11 +596,11 @@ int to_pdf(const GEN_PAR * pg, const OUT_PAR * po)
 		}
 	}
 
-	/* Finish up */
-	PAGEMODE;
-	pdf_end(md);
+	/* Finish up: Also after errors, to keep the document consistent */
 
       PDF_exit:
+	PAGEMODE;
+	pdf_end(md);
 	if (!pg->quiet)
 		Eprintf("\n");
 	return err;
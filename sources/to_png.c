@@ -19,39 +19,73 @@
  **
  ** 97/11/26 V 1.0   MS   Rewrite to libpng 0.96 using Tom Boutell's pixel 
  **                       drawing primitives
+ ** 26/10/19              True color PNG from direct color buffers
+ ** 26/10/19              Rows streamed from the picture buffer, no more
+ **                       pdImage copy; 1 bit grayscale / 4 bit palette
+ ** 26/10/19              Compression settings -L -U -E -j
  **                       
  **/
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "bresnham.h"
 #include "hp2xx.h"
 #include "to_png.h"
 #include "pendef.h"
-#define GGE >>=
-#define MAXOUTPUTROWS 70
 
-#define PDNCOL 256
 
-int pdImageColorAllocate(pdImagePtr, int, int, int);
+typedef struct {
+	const PicBuf *pb;
+	int quiet;
+} PNGRows;
 
-int PicBuf_to_PNG(const GEN_PAR * pg, const OUT_PAR * po)
+
+static void rgb_row(int row_c, unsigned char *rgb, void *data)
 {
-	FILE *fd;
-	int row_c, /*byte_c, */ x;
+	const PicBuf *pb = (const PicBuf *) data;
 	const RowBuf *row;
-	const PicBuf *pb;
-	int ppm[][3] = { {255, 255, 255}, {0, 0, 0} };
-/*, {255,0,0}, {0,255,0},
-		{0,0,255},{0,255,255},{255,0,255},{255,255,0}};
-*/
-	int colour;
 
+	if ((row = get_RowBuf(pb, pb->nr - row_c - 1)) != NULL)
+		RowBuf_to_RGB(row, pb, rgb);
+}
+
+
+static void index_row(int row_c, unsigned char *out, void *data)
 /**
- ** gifdraw-parts
+ ** Indexed buffers already hold their pixels packed the PNG way:
+ ** depth 4 two per byte, high nibble first, depth 8 one per byte.
+ ** Mono rows (set bit = ink) become 1-bit grayscale (0 = black).
  **/
-	pdImagePtr im;
-	int pdcol;
+{
+	const PNGRows *pr = (const PNGRows *) data;
+	const PicBuf *pb = pr->pb;
+	const RowBuf *row;
+	int i, n;
+
+	n = (pb->nc * pb->depth + 7) / 8;
+	if ((row = get_RowBuf(pb, pb->nr - row_c - 1)) == NULL)
+		memset(out, (pb->depth == 1) ? 0xFF : xxBackground,
+		       (size_t) n);
+	else if (pb->depth == 1)
+		for (i = 0; i < n; i++)
+			out[i] = (unsigned char) ~row->buf[i];
+	else
+		memcpy(out, row->buf, (size_t) n);
+
+	if ((!pr->quiet) && (row_c % 10 == 0))
+		/* For the impatients among us ...   */
+		Eprintf(".");
+}
+
+
+int PicBuf_to_PNG(const GEN_PAR * pg, const OUT_PAR * po)
+{
+	FILE *fd;
+	PNGRows pr;
+	pdCompression pc;
+	const PicBuf *pb;
+	int err;
 
 	if (pg == NULL || po == NULL)
 		return ERROR;
@@ -77,190 +111,38 @@ int PicBuf_to_PNG(const GEN_PAR * pg, const OUT_PAR * po)
 		fd = stdout;
 
 /**
- ** create image structure
- **/
-	im = pdImageCreate(pb->nc, pb->nr);
-
-	if (pb->depth > 1) {
-/** 
- ** allocate some colors ( ?? eight colors supported by hp2xx ?? )
- **/
-		for (colour = 0; colour < PDNCOL; colour++)
-/*  pdcol = pdImageColorAllocate(im, ppm[colour][0], ppm[colour][1], 
-				    ppm[colour][2]);
-*/
-			pdcol =
-			    pdImageColorAllocate(im, pt.clut[colour][0],
-						 pt.clut[colour][1],
-						 pt.clut[colour][2]);
-		for (row_c = 0; row_c < pb->nr; row_c++) {
-			row = get_RowBuf(pb, pb->nr - row_c - 1);
-			if (row == NULL)
-				continue;
-
-			for (x = 0; x < pb->nc; x++) {
-				colour = index_from_RowBuf(row, x, pb);
-				pdImageSetPixel(im, x, row_c, colour);
-			}
-			if ((!pg->quiet) && (row_c % 10 == 0))
-				/* For the impatients among us ...   */
-				Eprintf(".");
-		}
-	} else {
-/** 
- ** allocate two colors ( ?? eight colors supported by hp2xx ?? )
+ ** Rows go straight from the buffer to libpng, at the buffer's depth:
+ ** true color, 8 or 4 bit palette, or 1 bit grayscale
  **/
-		for (colour = 0; colour < 2; colour++)
-			pdcol =
-			    pdImageColorAllocate(im, ppm[colour][0],
-						 ppm[colour][1],
-						 ppm[colour][2]);
-
-		for (row_c = 0; row_c < pb->nr; row_c++) {
-			row = get_RowBuf(pb, pb->nr - row_c - 1);
-			if (row == NULL)
-				continue;
-
-			for (x = 0; x < pb->nc; x++) {
-				colour = index_from_RowBuf(row, x, pb);
-				pdImageSetPixel(im, x, row_c, colour);
-			}
-
-			if ((!pg->quiet) && (row_c % 10 == 0))
-				/* For the impatients among us ...   */
-				Eprintf(".");
-		}
-	}
-
-	pdImagePNG(im, fd);
-
-	pdImageDestroy(im);
+	pr.pb = pb;
+	pr.quiet = pg->quiet;
+	pc.level = po->png_level;
+	pc.strategy = po->png_strategy;
+	pc.filters = po->png_filter;
+	pc.threads = po->threads;
+	if (pb->depth == 32)
+		err = pdRGBImagePNG(pb->nc, pb->nr, rgb_row, (void *) pb,
+				    &pc, fd);
+	else if (pb->depth > 1)
+		err = pdIndexImagePNG(pb->nc, pb->nr, pb->depth,
+				      (const unsigned char (*)[3]) pt.clut,
+				      1 << pb->depth, index_row,
+				      (void *) &pr, &pc, fd);
+	else
+		err = pdIndexImagePNG(pb->nc, pb->nr, 1, NULL, 0, index_row,
+				      (void *) &pr, &pc, fd);
 
 	fflush(fd);
+	if (err)
+		Eprintf("\nError writing PNG output: %s\n", po->outfile);
 
 	if (!pg->quiet)
 		Eprintf("\n");
 	if (fd != stdout)
 		fclose(fd);
-	return 0;
+	return err ? ERROR : 0;
 
       ERROR_EXIT:
 	PError("write_PNG");
 	return ERROR;
 }
-
-/**
- ** PNG image support routines, derived from:
- **/
-
-/* gd.c: implementation of the gifdraw module. Version 0.9.
-
-        Written by Tom Boutell, 5/94-6/94.
-        Copyright 1994, Cold Spring Harbor Labs.
-        Permission granted to use this code in any fashion provided
-        that this notice is retained and any alterations are
-        labeled as such. It is requested, but not required, that
-        you share extensions to this module with us so that we
-        can incorporate them into new versions. */
-/**
- ** PNG: use sy rows of sx pixels (instead of sx columns of sy pixels)
- **/
-
-pdImagePtr pdImageCreate(sx, sy)
-int sx;
-int sy;
-{
-	int i;
-	pdImagePtr im;
-	im = (pdImage *) malloc(sizeof(pdImage));
-	im->pixels =
-	    (unsigned char **) malloc(sizeof(unsigned char *) * sy);
-	for (i = 0; (i < sy); i++) {
-		im->pixels[i] = (unsigned char *) calloc((size_t) sx,
-							 sizeof(unsigned
-								char));
-	}
-	im->sx = sx;
-	im->sy = sy;
-	im->colorsTotal = 0;
-	im->transparent = (-1);
-	return im;
-}
-
-void pdImageDestroy(im)
-pdImagePtr im;
-{
-	int i;
-	for (i = 0; (i < im->sy); i++) {
-		free(im->pixels[i]);
-	}
-	free(im->pixels);
-	free(im);
-}
-
-int pdImageColorAllocate(im, r, g, b)
-pdImagePtr im;
-int r;
-int g;
-int b;
-{
-	int i;
-	int ct = (-1);
-	for (i = 0; (i < (im->colorsTotal)); i++) {
-		if (im->open[i]) {
-			ct = i;
-			break;
-		}
-	}
-	if (ct == (-1)) {
-		ct = im->colorsTotal;
-		if (ct == pdMaxColors) {
-			return -1;
-		}
-		im->colorsTotal++;
-	}
-	im->red[ct] = r;
-	im->green[ct] = g;
-	im->blue[ct] = b;
-	im->open[ct] = 0;
-	return ct;
-}
-
-void pdImageColorTransparent(im, color)
-pdImagePtr im;
-unsigned char color;
-{
-	im->transparent = color;
-}
-
-void pdImageSetPixel(im, x, y, color)
-pdImagePtr im;
-int x;
-int y;
-unsigned char color;
-{
-	if (pdImageBoundsSafe(im, x, y)) {
-		im->pixels[y][x] = color;
-	}
-}
-
-int pdImageGetPixel(im, x, y)
-pdImagePtr im;
-int x;
-int y;
-{
-	if (pdImageBoundsSafe(im, x, y)) {
-		return im->pixels[y][x];
-	} else {
-		return 0;
-	}
-}
-
-int pdImageBoundsSafe(im, x, y)
-pdImagePtr im;
-int x;
-int y;
-{
-	return (!(((y < 0) || (y >= im->sy)) ||
-		  ((x < 0) || (x >= im->sx))));
-}
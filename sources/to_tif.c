@@ -1,58 +1,286 @@
 /* Created by M.Liberi from to_pcx.c */
+
+/**
+ ** to_tif.c: TIFF converter part of project "hp2xx"
+ **
+ ** 26/10/19              All pages of a spool go into one multi-page
+ **                       file, see TIF_close(); LZW, horizontal
+ **                       predictor, Deflate strips compressed in parallel
+ **/
+
 #include <stdio.h>
 #include <stdlib.h>
-//#include <unistd.h>
+#ifdef UNIX
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
 #include <string.h>
 #include "bresnham.h"
 #include "pendef.h"
 #include "hp2xx.h"
 #include "tiffio.h"
+#ifdef THREADS
+#include <pthread.h>
+#include <zlib.h>
+#endif
 
-int PicBuf_to_TIF(const GEN_PAR * pg, const OUT_PAR * po)
+
+#define	TIF_STRIP	(64 * 1024)	/* Bytes per strip for LZW & Deflate */
+
+
+/**
+ ** The output file stays open while the pages of a spool come in;
+ ** each page is a directory (subfile) of its own.
+ **/
+static TIFF *tif_w = NULL;
+static int tif_page;
+static char tif_tmp[L_tmpnam > 16 ? L_tmpnam : 16] = "";	/* For stdout */
+
+
+
+static TIFF *open_TIF(const OUT_PAR * po)
 {
-	TIFF *w = NULL;
+	TIFF *w;
 #ifdef UNIX
-	int tifftmp, tiffstdout = 0;
+	struct stat st;
+	int fd;
 #endif
-	RowBuf *row = NULL;
-	int x, y, W, H, D, B, S;
-	float XDPI, YDPI;
-	Byte *tifbuf;
-	unsigned short r[256], g[256], b[256];
-	char tmp[16] = "/tmp/hpXXXXXX";
 
-	if (!pg->quiet)
-		Eprintf("\nWriting TIFF output\n");
-	if (*po->outfile == '-') {
-#ifndef UNIX
-		if (!(tmpnam(tmp))) {
-			PError("hp2xx -- error creating temp file");
-			return 1;
-		}
-		if ((w = TIFFOpen(tmp, "w")) == NULL) {
-			PError("hp2xx -- opening TIFF temp file");
-			return ERROR;
-		}
+	if (*po->outfile != '-') {
+		if ((w = TIFFOpen(po->outfile, "w")) == NULL)
+			PError("hp2xx -- opening output file");
+		return w;
+	}
+#ifdef UNIX
+	/* stdout redirected to a file: No need for a copy */
+	fflush(stdout);
+	if (fstat(fileno(stdout), &st) == 0 && S_ISREG(st.st_mode) &&
+	    lseek(fileno(stdout), 0L, SEEK_CUR) == 0L) {
+		if ((w = TIFFFdOpen(dup(fileno(stdout)), "stdout", "w")) ==
+		    NULL)
+			PError("hp2xx -- opening TIFF output on stdout");
+		return w;
+	}
+	strcpy(tif_tmp, "/tmp/hpXXXXXX");
+	if ((fd = /*@-unrecog@ */ mkstemp(tif_tmp)) < 0) {
+		PError("hp2xx -- error creating temp file");
+		*tif_tmp = '\0';
+		return NULL;
+	}
+	if ((w = TIFFFdOpen(fd, tif_tmp, "w")) == NULL)
+		PError("hp2xx -- opening TIFF temp file");
 #else
-		if ((tifftmp = /*@-unrecog@ */ mkstemp(tmp)) < 0) {
-			PError("hp2xx -- error creating temp file");
-			return 1;
+	if (!(tmpnam(tif_tmp))) {
+		PError("hp2xx -- error creating temp file");
+		*tif_tmp = '\0';
+		return NULL;
+	}
+	if ((w = TIFFOpen(tif_tmp, "w")) == NULL)
+		PError("hp2xx -- opening TIFF temp file");
+#endif
+	return w;
+}
+
+
+
+void TIF_close(const GEN_PAR * pg)
+/**
+ ** End of spool: Close the file, and copy it to stdout if staged
+ **/
+{
+	char buf[BUFSIZ];
+	FILE *r;
+	size_t n;
+
+	if (tif_w == NULL)
+		return;
+	TIFFClose(tif_w);
+	tif_w = NULL;
+	if (!pg->quiet && tif_page > 1)
+		Eprintf("\n%d pages written into one TIFF file\n", tif_page);
+	tif_page = 0;
+
+	if (*tif_tmp == '\0')
+		return;
+	if ((r = fopen(tif_tmp, "rb")) == NULL)
+		PError("fopen");
+	else {
+		while ((n = fread(buf, 1, sizeof(buf), r)) > 0)
+			fwrite(buf, 1, n, stdout);
+		fclose(r);
+	}
+	remove(tif_tmp);
+	*tif_tmp = '\0';
+}
+
+
+
+static void row_to_TIF(const PicBuf * pb, int y, int D, int S, Byte * buf)
+/**
+ ** Scanline y (counted from the top) in TIFF layout
+ **/
+{
+	const RowBuf *row;
+	int x;
+
+	memset(buf, 0, (size_t) S);
+	if ((row = get_RowBuf(pb, (pb->nr - 1) - y)) == NULL)
+		return;
+	if (D == 32) {
+		RowBuf_to_RGB(row, pb, buf);
+		return;
+	}
+	if (D == pb->depth && D != 4) {	/* Same layout: 1 or 8 bit */
+		memcpy(buf, row->buf, (size_t) S);
+		if (D == 1 && (pb->nc & 7))
+			buf[S - 1] &= (Byte) (0xFF << (8 - (pb->nc & 7)));
+		return;
+	}
+	for (x = 0; x < pb->nc; ++x) {
+		Byte C = (Byte) index_from_RowBuf(row, x, pb);
+		if (D == 1) {
+			if (C != xxBackground)
+				buf[x / 8] |= 1 << (7 - x % 8);
+		} else
+			buf[x] = C;
+	}
+}
+
+
+
+#ifdef THREADS
+
+/**
+ ** Deflate strips are independent zlib streams: Several of them are
+ ** compressed at a time on threads of their own, then written out
+ ** raw and in order.
+ **/
+
+typedef struct {
+	Byte *raw;		/* Rows of the strip, after prediction */
+	uLong raw_len;
+	Byte *out;		/* zlib stream                         */
+	uLongf out_len;
+	int err;
+	int threaded;		/* Runs on a thread of its own        */
+} StripJob;
+
+
+
+static void *deflate_strip(void *arg)
+{
+	StripJob *job = (StripJob *) arg;
+
+	job->err = 1;
+	job->out_len = compressBound(job->raw_len);
+	if ((job->out = malloc((size_t) job->out_len)) == NULL)
+		return NULL;
+	if (compress2(job->out, &job->out_len, job->raw, job->raw_len,
+		      Z_DEFAULT_COMPRESSION) == Z_OK)
+		job->err = 0;
+	return NULL;
+}
+
+
+
+static int write_strips_parallel(TIFF * w, const PicBuf * pb, int D, int S,
+				 int rps, int predict, int threads)
+{
+	StripJob *job;
+	pthread_t *tid;
+	Byte *raw, *p;
+	int n_strips, s, n, i, j, y, err = 0;
+	int spp = (D == 32) ? 3 : 1;
+
+	n_strips = (pb->nr + rps - 1) / rps;
+	raw = malloc((size_t) threads * rps * S);
+	job = (StripJob *) calloc((size_t) threads, sizeof(StripJob));
+	tid = (pthread_t *) malloc(threads * sizeof(pthread_t));
+	if (raw == NULL || job == NULL || tid == NULL) {
+		Eprintf("malloc error!\n");
+		err = ERROR;
+		goto TIF_par_exit;
+	}
+
+	for (s = 0; s < n_strips && !err; s += n) {
+		for (n = 0; n < threads && s + n < n_strips; n++) {
+			job[n].raw = raw + (size_t) n * rps * S;
+			for (y = (s + n) * rps, p = job[n].raw;
+			     y < pb->nr && y < (s + n + 1) * rps;
+			     y++, p += S) {
+				row_to_TIF(pb, y, D, S, p);
+				if (predict)	/* Horizontal differencing */
+					for (j = S - 1; j >= spp; j--)
+						p[j] -= p[j - spp];
+			}
+			job[n].raw_len = (uLong) (p - job[n].raw);
+			job[n].out = NULL;
 		}
-		tiffstdout = dup(tifftmp);
-		if ((w = TIFFFdOpen(tifftmp, tmp, "w")) == NULL) {
-			PError("hp2xx -- opening TIFF temp file");
-			return ERROR;
+
+		/* The last job runs here, or any one without a thread */
+		for (i = 0; i < n; i++) {
+			job[i].threaded = (i < n - 1 &&
+					   pthread_create(&tid[i], NULL,
+							  deflate_strip,
+							  &job[i]) == 0);
+			if (!job[i].threaded)
+				deflate_strip(&job[i]);
 		}
+		for (i = 0; i < n; i++)
+			if (job[i].threaded)
+				pthread_join(tid[i], NULL);
+
+		for (i = 0; i < n; i++) {
+			if (!err && (job[i].err ||
+				     TIFFWriteRawStrip(w, (tstrip_t) (s + i),
+						       job[i].out,
+						       (tsize_t) job[i].out_len)
+				     < 0)) {
+				PError("TIFFWriteRawStrip");
+				err = ERROR;
+			}
+			free(job[i].out);
+		}
+	}
+
+      TIF_par_exit:
+	free(tid);
+	free(job);
+	free(raw);
+	return err;
+}
+
+#endif				/* THREADS */
+
+
+
+int PicBuf_to_TIF(const GEN_PAR * pg, const OUT_PAR * po)
+/**
+ ** Add the picture as next page to the output file
+ **/
+{
+	TIFF *w;
+	int x, y, W, H, D, S, rps, comp, predict, err = 0;
+#ifdef THREADS
+	int threads = po->threads;
 #endif
-	} else if ((w = TIFFOpen(po->outfile, "w")) == NULL) {
-		PError("hp2xx -- opening output file");
+	float XDPI, YDPI;
+	Byte *tifbuf;
+	unsigned short r[256], g[256], b[256];
+
+	if (!pg->quiet)
+		Eprintf("\nWriting TIFF output, page %d\n", tif_page + 1);
+	if (tif_w == NULL && (tif_w = open_TIF(po)) == NULL)
 		return ERROR;
-	}
+	w = tif_w;
+
 	W = po->picbuf->nr;
 	H = po->picbuf->nc;
 	D = po->picbuf->depth;
-	B = po->picbuf->nb;
 
+	TIFFSetField(w, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+	TIFFSetField(w, TIFFTAG_PAGENUMBER, tif_page, 0);
 	TIFFSetField(w, TIFFTAG_IMAGEWIDTH, H);
 	TIFFSetField(w, TIFFTAG_IMAGELENGTH, W);
 
@@ -65,43 +293,41 @@ int PicBuf_to_TIF(const GEN_PAR * pg, const OUT_PAR * po)
 	switch (po->specials) {
 	case 0:		/* no compression */
 	case 1:
-		TIFFSetField(w, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+		comp = COMPRESSION_NONE;
 		break;
 	case 2:		/* Run Length Encoding */
-		TIFFSetField(w, TIFFTAG_COMPRESSION, COMPRESSION_CCITTRLE);
+		comp = COMPRESSION_CCITTRLE;
 		D = 1;
 		break;
 	case 3:		/* Group 3 Fax monochrome */
-		TIFFSetField(w, TIFFTAG_COMPRESSION,
-			     COMPRESSION_CCITTFAX3);
+		comp = COMPRESSION_CCITTFAX3;
 		D = 1;
 		break;
 	case 4:		/* Group 4 Fax monochrome */
-		TIFFSetField(w, TIFFTAG_COMPRESSION,
-			     COMPRESSION_CCITTFAX4);
+		comp = COMPRESSION_CCITTFAX4;
 		D = 1;
 		break;
-	case 5:		/* LZW is patented by Unisys - only license holders should use next line */
-		/*  TIFFSetField(w, TIFFTAG_COMPRESSION, COMPRESSION_LZW); */
+	case 5:		/* LZW (the Unisys patent has expired) */
+		comp = COMPRESSION_LZW;
 		break;
 	case 6:		/* JPEG formats */
-		TIFFSetField(w, TIFFTAG_COMPRESSION, COMPRESSION_OJPEG);
+		comp = COMPRESSION_OJPEG;
 		break;
 	case 7:
-		TIFFSetField(w, TIFFTAG_COMPRESSION, COMPRESSION_JPEG);
+		comp = COMPRESSION_JPEG;
 		break;
 	case 8:
-		TIFFSetField(w, TIFFTAG_COMPRESSION, COMPRESSION_DEFLATE);
+		comp = COMPRESSION_DEFLATE;
+		break;
+	case 9:		/* For archiving: G4 if monochrome, else LZW */
+		comp = (D == 1) ? COMPRESSION_CCITTFAX4 : COMPRESSION_LZW;
 		break;
 	default:
 		Eprintf("\nCompression Format - not supported yet\n");
+		comp = COMPRESSION_NONE;
 		break;
 	}
-
-	if (po->specials > 0)
-		TIFFSetField(w, TIFFTAG_ROWSPERSTRIP, -1);
-	else
-		TIFFSetField(w, TIFFTAG_ROWSPERSTRIP, 1);
+	TIFFSetField(w, TIFFTAG_COMPRESSION, comp);
 
 	if (D == 1) {
 		if (pt.clut[0][0] + pt.clut[0][1] + pt.clut[0][2] > 0)
@@ -111,6 +337,9 @@ int PicBuf_to_TIF(const GEN_PAR * pg, const OUT_PAR * po)
 			TIFFSetField(w, TIFFTAG_PHOTOMETRIC,
 				     PHOTOMETRIC_MINISBLACK);
 		TIFFSetField(w, TIFFTAG_BITSPERSAMPLE, 1);
+	} else if (D == 32) {
+		TIFFSetField(w, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+		TIFFSetField(w, TIFFTAG_BITSPERSAMPLE, 8);
 	} else {
 		for (x = 0; x < pg->maxpens; ++x)
 			r[x] = pt.clut[x][0] << 8 | pt.clut[x][0],
@@ -121,11 +350,25 @@ int PicBuf_to_TIF(const GEN_PAR * pg, const OUT_PAR * po)
 		TIFFSetField(w, TIFFTAG_COLORMAP, r, g, b);
 	}
 	TIFFSetField(w, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-	TIFFSetField(w, TIFFTAG_SAMPLESPERPIXEL, 1);
+	TIFFSetField(w, TIFFTAG_SAMPLESPERPIXEL, (D == 32) ? 3 : 1);
 /*  TIFFSetField(w, TIFFTAG_ORIENTATION, ORIENTATION_BOTRIGHT);*/
 	/* write out with normal orientation - many readers don't honour the orientation flag */
 
+	/* Differencing neighbours pays off for 8 bit samples */
+	predict = (D != 1 && (comp == COMPRESSION_LZW ||
+			      comp == COMPRESSION_DEFLATE));
+	if (predict)
+		TIFFSetField(w, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+
 	S = (int) TIFFScanlineSize(w);
+	if (comp == COMPRESSION_LZW || comp == COMPRESSION_DEFLATE)
+		rps = MAX(1, TIF_STRIP / S);
+	else if (po->specials > 0)
+		rps = W;	/* One strip */
+	else
+		rps = 1;
+	TIFFSetField(w, TIFFTAG_ROWSPERSTRIP, rps);
+
 	if (!pg->quiet) {
 		Eprintf
 		    ("XDPI=%f,YDPI=%f,W=%d, H=%d, D=%d, scanlinesize=%d\n",
@@ -136,56 +379,37 @@ int PicBuf_to_TIF(const GEN_PAR * pg, const OUT_PAR * po)
 		 */
 	}
 
-	if ((tifbuf = malloc((size_t) S)) == NULL) {
-		Eprintf("malloc error!\n");
-		TIFFClose(w);
-		return 1;
-	}
-
-	for (y = 0; y < W; ++y) {
-		if ((row = get_RowBuf(po->picbuf, (W - 1) - y)) == NULL)
-			break;
-		memset(tifbuf, 0, (size_t) S);
-		for (x = 0; x < H; ++x) {
-			Byte C =
-			    (Byte) index_from_RowBuf(row, x, po->picbuf);
-			if (D == 1)
-				switch (C) {
-				case xxBackground:
-					break;
-				default:
-					tifbuf[x / 8] |= 1 << (7 - x % 8);
-			} else
-				tifbuf[x] = C;
+#ifdef THREADS
+#ifdef _SC_NPROCESSORS_ONLN
+	if (threads == 0)
+		threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (comp == COMPRESSION_DEFLATE && threads > 1 && W > rps)
+		err = write_strips_parallel(w, po->picbuf, D, S, rps,
+					    predict, threads);
+	else
+#endif
+	{
+		if ((tifbuf = malloc((size_t) S)) == NULL) {
+			Eprintf("malloc error!\n");
+			return ERROR;
 		}
-		if (TIFFWriteScanline(w, tifbuf, (uint32) y, 0) < 0) {
-			PError("TIFFWriteScanline");
-			break;
+		for (y = 0; y < W; ++y) {
+			row_to_TIF(po->picbuf, y, D, S, tifbuf);
+			if (TIFFWriteScanline(w, tifbuf, (uint32) y, 0) < 0) {
+				PError("TIFFWriteScanline");
+				err = ERROR;
+				break;
+			}
 		}
+		free(tifbuf);
 	}
 
-	free(tifbuf);
-	TIFFClose(w);
-	if (*po->outfile == '-') {
-		int c;
-#ifndef UNIX
-		FILE *r;
-
-		if (!(r = fopen(tmp, "rb"))) {
-			PError("fopen");
-			return ERROR;
-		}
-		while ((c = fgetc(r)) != EOF)
-			fputc(c, stdout);
-		fclose(r);
-		unlink(tmp);
-#else
-		(void) lseek(tiffstdout, 0, SEEK_SET);
-		while (read(tiffstdout, &c, 1) > 0)
-			fputc(c, stdout);
-		close(tiffstdout);
-		unlink(tmp);
-#endif
+	/* Finish this page; the next one starts a new directory */
+	if (!TIFFWriteDirectory(w)) {
+		Eprintf("\nError writing TIFF directory\n");
+		err = ERROR;
 	}
-	return 0;
+	tif_page++;
+	return err;
 }
@@ -0,0 +1,322 @@
+/*
+   Distributed by Free Software Foundation, Inc.
+
+This file is part of HP2xx.
+
+HP2xx is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY.  No author or distributor accepts responsibility
+to anyone for the consequences of using it or for whether it serves any
+particular purpose or works at all, unless he says so in writing.  Refer
+to the GNU General Public License, Version 2 or later, for full details.
+
+Everyone is granted permission to copy, modify and redistribute
+HP2xx, but only under the conditions described in the GNU General Public
+License.  A copy of this license is supposed to have been
+given to you along with HP2xx so you can know your rights and
+responsibilities.  It should be in a file named COPYING.  Among other
+things, the copyright notice and this notice must be preserved on all
+copies.
+
+- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+*/
+
+/** to_tiles.c: Tile pyramid ("XYZ" web map layout) of PNG files
+ **
+ ** The output file name is taken as a directory. It receives one
+ ** sub-directory per zoom level z, holding TILE_SIZE x TILE_SIZE
+ ** PNG tiles as  z/x/y.png  (y counted from the top). The highest
+ ** zoom level matches the resolution given by -d / -D, each lower
+ ** level halves it, down to a single tile.
+ **
+ ** There is no full-size picture buffer: Each tile is rasterized
+ ** into its own small buffer. The spatial index built while parsing
+ ** (see tmpindex.c) yields the parts of the command stream which
+ ** may touch a tile. Tiles not touched by any vector are not written.
+ **
+ ** 26/10/19  V 1.00       Originating
+ ** 26/10/19  V 1.01       Use the temp. file index of the parser
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#if defined(_WIN32) || defined(__MINGW32__)
+#include <direct.h>
+#define	make_dir(name)	_mkdir(name)
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#define	make_dir(name)	mkdir(name, 0777)
+#endif
+#include "bresnham.h"
+#include "hp2xx.h"
+#include "pendef.h"
+#include "lindef.h"
+#include "tmpindex.h"
+
+
+#define	TILE_SIZE	256	/* Edge length of a tile in pixels     */
+
+
+typedef struct {
+	int *id;		/* Indices of chunks touching this tile */
+	int n, size;
+} TileBin;
+
+
+static PEN start_pt;		/* Pen & line state at begin of temp. file */
+static LineAttr start_la;
+
+
+
+static void load_state_cmd(const GEN_PAR * pg, long offset)
+{
+	fseek(pg->td, offset, SEEK_SET);
+	switch (PlotCmd_from_tmpfile()) {
+	case DEF_PW:
+		load_pen_width_table(pg->td);
+		break;
+	case DEF_PC:
+		load_pen_color_table(pg->td);
+		break;
+	case DEF_LA:
+		load_line_attr(pg->td);
+		break;
+	default:
+		break;
+	}
+}
+
+
+
+static int add_to_bin(TileBin * bin, int id)
+{
+	int *p;
+
+	if (bin->n == bin->size) {
+		bin->size = bin->size ? 2 * bin->size : 16;
+		if ((p = (int *) realloc(bin->id,
+					 bin->size * sizeof(int))) == NULL)
+			return ERROR;
+		bin->id = p;
+	}
+	bin->id[bin->n++] = id;
+	return 0;
+}
+
+
+
+static int make_dirs(const char *path)
+/**
+ ** Create a directory unless it exists already
+ **/
+{
+	if (make_dir(path) && errno != EEXIST) {
+		PError(path);
+		return ERROR;
+	}
+	return 0;
+}
+
+
+
+static int is_blank(const PicBuf * pb)
+{
+	const RowBuf *row;
+	int i, j;
+
+	for (i = 0; i < pb->nr; i++) {
+		row = get_RowBuf(pb, i);
+		for (j = 0; j < pb->nb * pb->depth; j++)
+			if (row->buf[j])
+				return FALSE;
+	}
+	return TRUE;
+}
+
+
+
+static void clear_PicBuf(const PicBuf * pb)
+{
+	int i;
+
+	for (i = 0; i < pb->nr; i++)
+		memset(get_RowBuf(pb, i)->buf, 0,
+		       (size_t) (pb->nb * pb->depth));
+}
+
+
+
+static int
+level_to_tiles(const GEN_PAR * pg, const OUT_PAR * po, int z, int maxzoom,
+	       PicBuf * tile, long *p_written)
+/**
+ ** Rasterize and write all non-empty tiles of zoom level z
+ **/
+{
+	OUT_PAR lpo;
+	GEN_PAR tpg;
+	TileBin *bins, *bin;
+	const Chunk *c;
+	char name[1024];
+	double scale;
+	int n_rows, n_cols, nx, ny, tx, ty, tx0, tx1, ty0, ty1;
+	int i, j, s, lw, margin, err = 0;
+	long x0, x1, y0, y1;
+
+	scale = ldexp(1.0, z - maxzoom);
+	lpo = *po;
+	lpo.HP_to_xdots *= scale;
+	lpo.HP_to_ydots *= scale;
+	lpo.picbuf = tile;
+	size_PicBuf(pg, &lpo, &n_rows, &n_cols);
+
+	/* Pensize correction as done by size_PicBuf() */
+	margin = (1 + (int) ceil(pg->maxpensize * lpo.HP_to_xdots / 0.025)) / 2;
+	nx = (n_cols + TILE_SIZE - 1) / TILE_SIZE;
+	ny = (n_rows + TILE_SIZE - 1) / TILE_SIZE;
+	if ((bins = (TileBin *) calloc((size_t) nx * ny,
+				       sizeof(TileBin))) == NULL) {
+		Eprintf("\nNo memory for %d x %d tile bins\n", nx, ny);
+		return ERROR;
+	}
+
+  /**
+   ** Sort chunks into the bins of all tiles their bounding boxes touch.
+   ** Picture rows count upwards, tile rows downwards from the top.
+   **/
+	for (i = 0, c = chunks; i < n_chunks; i++, c++) {
+		if (!c->drawn)
+			continue;
+		lw = 2 + (int) ceil(MAX(c->maxwidth, pg->maxpensize) *
+				    lpo.HP_to_xdots / 0.025);
+		x0 = (long) ((c->xmin - po->xmin) * lpo.HP_to_xdots) +
+		    margin - lw;
+		x1 = (long) ((c->xmax - po->xmin) * lpo.HP_to_xdots) +
+		    margin + lw;
+		y0 = (long) ((c->ymin - po->ymin) * lpo.HP_to_ydots) +
+		    margin - lw;
+		y1 = (long) ((c->ymax - po->ymin) * lpo.HP_to_ydots) +
+		    margin + lw;
+		tx0 = (int) MAX(0L, x0 / TILE_SIZE);
+		tx1 = (int) MIN((long) nx - 1, x1 / TILE_SIZE);
+		ty0 = (int) MAX(0L, (n_rows - 1 - y1) / TILE_SIZE);
+		ty1 = (int) MIN((long) ny - 1, (n_rows - 1 - y0) / TILE_SIZE);
+		for (ty = ty0; ty <= ty1; ty++)
+			for (tx = tx0; tx <= tx1; tx++)
+				if (add_to_bin(&bins[ty * nx + tx], i)) {
+					Eprintf("\nNo memory for tile bins\n");
+					err = ERROR;
+					goto LEVEL_exit;
+				}
+	}
+
+	if (!pg->quiet)
+		Eprintf("\nZoom level %d: %d x %d pixels, %d x %d tiles ",
+			z, n_cols, n_rows, nx, ny);
+
+	sprintf(name, "%s/%d", po->outfile, z);
+	if (make_dirs(name)) {
+		err = ERROR;
+		goto LEVEL_exit;
+	}
+
+	tpg = *pg;
+	tpg.quiet = TRUE;
+	for (tx = 0; tx < nx; tx++) {
+		sprintf(name, "%s/%d/%d", po->outfile, z, tx);
+		for (ty = 0, s = FALSE; ty < ny; ty++) {
+			bin = &bins[ty * nx + tx];
+			if (bin->n == 0)
+				continue;
+
+			clear_PicBuf(tile);
+			window_PicBuf(tx * TILE_SIZE,
+				      n_rows - (ty + 1) * TILE_SIZE);
+			pt = start_pt;
+			CurrentLineAttr = start_la;
+			for (i = 0, j = 0; i < bin->n; i++) {
+				c = chunks + bin->id[i];
+				for (; j < n_state_cmds
+				     && state_cmds[j] < c->offset; j++)
+					load_state_cmd(pg, state_cmds[j]);
+				fseek(pg->td, c->offset, SEEK_SET);
+				cmds_to_PicBuf(pg, &lpo, &c->ref, c->pen_no,
+					       (i > 0 && bin->id[i - 1] ==
+						bin->id[i] - 1) ? -1 :
+					       c->joins, c->n_cmds);
+			}
+			if (is_blank(tile))
+				continue;
+
+			if (!s && make_dirs(name)) {
+				err = ERROR;
+				goto LEVEL_exit;
+			}
+			s = TRUE;
+			sprintf(name + strlen(name), "/%d.png", ty);
+			lpo.outfile = name;
+			if (PicBuf_to_PNG(&tpg, &lpo)) {
+				err = ERROR;
+				goto LEVEL_exit;
+			}
+			*strrchr(name, '/') = '\0';
+			(*p_written)++;
+		}
+		if ((!pg->quiet) && (tx % 10 == 0))
+			Eprintf(".");
+	}
+
+      LEVEL_exit:
+	for (i = 0; i < nx * ny; i++)
+		free(bins[i].id);
+	free(bins);
+	return err;
+}
+
+
+
+int to_tiles(const GEN_PAR * pg, const OUT_PAR * po)
+{
+	PicBuf *tile;
+	long written = 0;
+	int n_rows, n_cols, maxzoom, z, i, err = 0;
+
+	if (*po->outfile == '-') {
+		Eprintf("\nTiles mode needs a directory name, not stdout\n");
+		return ERROR;
+	}
+	if (!pg->quiet)
+		Eprintf("\nWriting PNG tiles below: %s\n", po->outfile);
+
+	if (make_dirs(po->outfile))
+		return ERROR;
+
+	/* Chunks are replayed out of order: no window filtering here */
+	clear_TmpIndex_window();
+	start_pt = pt;
+	start_la = CurrentLineAttr;
+
+	size_PicBuf(pg, po, &n_rows, &n_cols);
+	for (maxzoom = 0; (TILE_SIZE << maxzoom) < MAX(n_rows, n_cols);
+	     maxzoom++);
+
+	if ((tile = allocate_PicBuf(pg, TILE_SIZE, TILE_SIZE)) == NULL)
+		return ERROR;
+	for (z = maxzoom; z >= 0 && !err; z--)
+		err = level_to_tiles(pg, po, z, maxzoom, tile, &written);
+	free_PicBuf(tile);
+
+	/* Leave pen & line state as a full pass would */
+	pt = start_pt;
+	CurrentLineAttr = start_la;
+	for (i = 0; i < n_state_cmds; i++)
+		load_state_cmd(pg, state_cmds[i]);
+
+	if (!pg->quiet)
+		Eprintf("\n%ld tiles written, %d chunks indexed\n",
+			written, n_chunks);
+	return err;
+}
@@ -49,6 +49,11 @@ copies.
  ** 03/02/26          MK   Simple HPGL now writes %f instead of %g - 
  **                        HPGL does not tolerate exponent notation
  ** 03/02/24          GV   Added figure limits and pen/color mapping to DXF
+ ** 26/10/19               SVG: solid fills as filled paths (FILL_POLY)
+ ** 26/10/19               SVG, DXF: arcs and Bezier curves (ARC, CUBIC)
+ ** 26/10/19               SVG: line types as stroke-dasharray (DEF_LT)
+ ** 26/10/19               SVG: labels as text elements (TEXT)
+ ** 26/10/19               DXF: Bezier curves as polylines
  **/
 
 #include <stdio.h>
@@ -70,11 +75,161 @@ copies.
 
 
 
+static void dxf_map_pen(int specials, int pen_no, PEN_W pensize,
+			int *p_no, PEN_W * p_size)
+/**
+ ** DXF: map pen no. or width to a color number
+ **/
+{
+	switch (specials) {
+	case 1:		/* pen number is color number           */
+		*p_no = pen_no;
+		*p_size = pensize;
+		break;
+	case 2:		/* pen width translates to color number */
+		*p_no = (int) floor(pensize * 10.);
+		*p_size = pensize;
+		if (*p_no < 1)
+			*p_no = 1;
+		break;
+	case 3:		/* as above, upper limit at 0.4 == 4 */
+		*p_no = (int) floor(pensize * 10.);
+		if (*p_no < 1)
+			*p_no = 1;
+		if (*p_no > 1)
+			*p_no = 4;
+		*p_size = pensize;
+		break;
+	default:		/* old behaviour - no mapping */
+		*p_no = 1;
+		*p_size = .1;
+	}
+}
+
+
+
+static const char *svg_dash(const LineDash * pd, double coord2pt)
+/**
+ ** Stroke style of a dash pattern, appended to the style of a group
+ **/
+{
+	static char buf[40 + 12 * (LT_ELEMENTS + 1)];
+	int i, n;
+
+	if (pd->n == 0)
+		return "";
+	n = sprintf(buf, "; stroke-dasharray:");
+	for (i = 0; i < pd->n; i++)
+		n += sprintf(buf + n, i ? ",%.3f" : "%.3f",
+			     pd->len[i] * coord2pt);
+	if (line_dash_has_dots(pd))	/* Else dots vanish */
+		sprintf(buf + n, "; stroke-linecap:round");
+	return buf;
+}
+
+
+
+static int cubic_steps(const HPGL_Pt * p0, const HPGL_Pt * p, double tol)
+/**
+ ** Number of vectors approximating a Bezier curve within tol
+ ** (in HP-GL units), from the second differences of its control points
+ **/
+{
+	double d1, d2;
+	int n;
+
+	d1 = fabs(p0->x - 2 * p[0].x + p[1].x) +
+	    fabs(p0->y - 2 * p[0].y + p[1].y);
+	d2 = fabs(p[0].x - 2 * p[1].x + p[2].x) +
+	    fabs(p[0].y - 2 * p[1].y + p[2].y);
+	n = (int) ceil(sqrt(0.75 * MAX(d1, d2) / tol));
+	return MAX(1, MIN(n, 1000));
+}
+
+
+
+static void svg_text(FILE * md, const HPGL_Text * pt, const char *s,
+		     const BYTE * rgb, const OUT_PAR * po, double xcoord2mm,
+		     double ycoord2mm)
+/**
+ ** SVG: a label as text element. Its own y axis points down, hence
+ ** the changed signs of the matrix.
+ **/
+{
+	int i;
+
+	fprintf(md, "<text xml:space=\"preserve\" transform=\"matrix("
+		"%.6g %.6g %.6g %.6g %.6g %.6g)\" x=\"",
+		pt->m[0] * xcoord2mm, -pt->m[1] * ycoord2mm,
+		-pt->m[2] * xcoord2mm, pt->m[3] * ycoord2mm,
+		(pt->org.x - po->xmin) * xcoord2mm,
+		(po->ymax - pt->org.y - po->ymin) * ycoord2mm);
+	for (i = 0; i < pt->n; i++)
+		fprintf(md, "%s%.6g", i ? " " : "", i * pt->adv);
+	fprintf(md, "\" y=\"0\" style=\"font-family:Courier,monospace; "
+		"font-size:%gpx; fill:rgb(%d,%d,%d); stroke:none\">",
+		TEXT_EM, rgb[0], rgb[1], rgb[2]);
+	for (; *s; s++)
+		switch (*s) {
+		case '&':
+			fprintf(md, "&amp;");
+			break;
+		case '<':
+			fprintf(md, "&lt;");
+			break;
+		case '>':
+			fprintf(md, "&gt;");
+			break;
+		default:
+			putc(*s, md);
+			break;
+		}
+	fprintf(md, "</text>\n");
+}
+
+
+
+static int svg_arc(FILE * md, const HPGL_Arc * pa, const OUT_PAR * po,
+		   double xcoord2mm, double ycoord2mm)
+/**
+ ** SVG: continue the path with an arc. Arcs beyond 180 degrees are
+ ** split in halves, so the large-arc flag is never needed. The y
+ ** axis points down in SVG, which reverses the sense of rotation.
+ **/
+{
+	double dx, dy, r, c, s, x, y;
+	int n = 0;
+
+	dx = pa->end.x - pa->center.x;
+	dy = pa->end.y - pa->center.y;
+	r = sqrt(dx * dx + dy * dy);
+	if (fabs(pa->sweep) > M_PI) {
+		c = cos(pa->sweep / 2.0);
+		s = sin(pa->sweep / 2.0);
+		x = pa->center.x + dx * c + dy * s;	/* Rotated back */
+		y = pa->center.y - dx * s + dy * c;
+		n += fprintf(md, "	A %4.3f, %4.3f 0 0 %d %4.3f, %4.3f \n",
+			     r * xcoord2mm, r * ycoord2mm, pa->sweep < 0,
+			     (x - po->xmin) * xcoord2mm,
+			     (po->ymax - y - po->ymin) * ycoord2mm);
+	}
+	n += fprintf(md, "	A %4.3f, %4.3f 0 0 %d %4.3f, %4.3f \n",
+		     r * xcoord2mm, r * ycoord2mm, pa->sweep < 0,
+		     (pa->end.x - po->xmin) * xcoord2mm,
+		     (po->ymax - pa->end.y - po->ymin) * ycoord2mm);
+	return n;
+}
+
+
+
 int to_mftex(const GEN_PAR * pg, const OUT_PAR * po, int mode)
 {
 
 	PlotCmd cmd;
-	HPGL_Pt pt1;
+	HPGL_Pt pt1, *poly, cp[3], q;
+	HPGL_Arc arc;
+	HPGL_Text text;
+	double r, a0, a1, t;
 	float xcoord2mm, ycoord2mm;
 	FILE *md = NULL;
 	PEN_W pensize;
@@ -82,10 +237,10 @@ int to_mftex(const GEN_PAR * pg, const OUT_PAR * po, int mode)
 	int mapped_pen_no;
 	PEN_W mapped_pen_size;	/* for DXF */
 	int toolz = 0;
-	int np = 1, err = 0;
+	int np = 1, err = 0, i, n;
 	char *ftype = "", *scale_cmd = "", *pen_cmd = "",
 	    *poly_start = "", *poly_next = "", *poly_last = "", *poly_end =
-	    "", *draw_dot = "", *exit_cmd = "";
+	    "", *draw_dot = "", *exit_cmd = "", *label;
 #ifdef ATARI
 	int i;
 	FILE *csfile;
@@ -200,7 +355,7 @@ int to_mftex(const GEN_PAR * pg, const OUT_PAR * po, int mode)
 		scale_cmd =
 		    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\" ?>\n<svg width=\"100%%\" height=\"100%%\" viewBox=\"0 0 %4.3f %4.3f\" xmlns=\"http://www.w3.org/2000/svg\"><g>\n";
 		pen_cmd =
-		    "</g><g style=\"stroke:rgb(%d,%d,%d); fill:none; stroke-width:%4.3fmm\" >\n";
+		    "</g><g style=\"stroke:rgb(%d,%d,%d); fill:none; stroke-width:%4.3fmm%s\" >\n";
 		poly_start = "<path d=\"M %4.3f, %4.3f \n";
 		poly_next = "	L %4.3f, %4.3f \n";
 		poly_last = "	L %4.3f, %4.3f \n\" />\n";
@@ -350,6 +505,7 @@ int to_mftex(const GEN_PAR * pg, const OUT_PAR * po, int mode)
 
 	pen_no = DEFAULT_PEN_NO;
 	pensize = pt.width[pen_no];
+	CurrentLineDash.n = 0;
 
 	if (pensize != 0)
 		switch (mode) {
@@ -362,7 +518,7 @@ int to_mftex(const GEN_PAR * pg, const OUT_PAR * po, int mode)
 		case 7:
 			break;
 		case 8:
-			fprintf(md, pen_cmd, 0, 0, 0, 10 * pensize);
+			fprintf(md, pen_cmd, 0, 0, 0, 10 * pensize, "");
 			break;
 		case 9:
 			Eprintf("\nWARNING: Pensize Ignored!\n");
@@ -419,7 +575,9 @@ int to_mftex(const GEN_PAR * pg, const OUT_PAR * po, int mode)
 						pt.clut[pencolor][0],
 						pt.clut[pencolor][1],
 						pt.clut[pencolor][2],
-						pensize);
+						pensize,
+						svg_dash(&CurrentLineDash,
+							 xcoord2mm));
 					break;
 				case 9:
 					fprintf(md, pen_cmd, pen_no);	/* Tool No */
@@ -503,31 +661,9 @@ int to_mftex(const GEN_PAR * pg, const OUT_PAR * po, int mode)
 						     ycoord2mm, np++);
 				break;
 			} else if (mode == 7) {	/* DXF, mapping pen no. or width to color */
-				switch (po->specials) {
-				case 1:	/* pen number is color number           */
-					mapped_pen_no = pen_no;
-					mapped_pen_size = pensize;
-					break;
-				case 2:	/* pen width translates to color number */
-					mapped_pen_no =
-					    (int) floor(pensize * 10.);
-					mapped_pen_size = pensize;
-					if (mapped_pen_no < 1)
-						mapped_pen_no = 1;
-					break;
-				case 3:	/* as above, upper limit at 0.4 == 4 */
-					mapped_pen_no =
-					    (int) floor(pensize * 10.);
-					if (mapped_pen_no < 1)
-						mapped_pen_no = 1;
-					if (mapped_pen_no > 1)
-						mapped_pen_no = 4;
-					mapped_pen_size = pensize;
-					break;
-				default:	/* old behaviour - no mapping */
-					mapped_pen_no = 1;
-					mapped_pen_size = .1;
-				}
+				dxf_map_pen(po->specials, pen_no, pensize,
+					    &mapped_pen_no,
+					    &mapped_pen_size);
 				chars_out = fprintf(md, poly_start,
 						    mapped_pen_no,
 						    mapped_pen_size,
@@ -597,6 +733,13 @@ int to_mftex(const GEN_PAR * pg, const OUT_PAR * po, int mode)
 			}
 #endif
 
+			if (mode == 8 && !chars_out && pensize != 0.)
+				/* Path closed by DEF_LT or PLOT_AT */
+				chars_out = fprintf(md, poly_start,
+						    (pt1.x -
+						     po->xmin) * xcoord2mm,
+						    (pt1.y -
+						     po->ymin) * ycoord2mm);
 			HPGL_Pt_from_tmpfile(&pt1);
 			if (mode == 8)
 				pt1.y = po->ymax - pt1.y;
@@ -605,8 +748,9 @@ int to_mftex(const GEN_PAR * pg, const OUT_PAR * po, int mode)
 				break;
 
 
-			if (chars_out > max_chars_out)
-				/* prevent overlong lines */
+			if (chars_out > max_chars_out
+			    && CurrentLineDash.n == 0)
+				/* prevent overlong lines, unless dashed */
 			{
 				fprintf(md, poly_last,
 					(pt1.x - po->xmin) * xcoord2mm,
@@ -672,6 +816,175 @@ int to_mftex(const GEN_PAR * pg, const OUT_PAR * po, int mode)
 				goto MF_exit;
 			}
 			break;
+		case DEF_LT:	/* Only written for SVG */
+			if (load_line_dash(pg->td) < 0) {
+				PError("Unexpected end of temp. file");
+				err = ERROR;
+				goto MF_exit;
+			}
+			if (mode != 8 || pensize == 0.)
+				break;
+			if (chars_out) {	/* Finish up old polygon */
+				fprintf(md, poly_end);
+				chars_out = 0;
+			}
+			pencolor = (int) pt.color[pen_no];
+			fprintf(md, pen_cmd, pt.clut[pencolor][0],
+				pt.clut[pencolor][1], pt.clut[pencolor][2],
+				pensize, svg_dash(&CurrentLineDash, xcoord2mm));
+			break;
+		case FILL_POLY:	/* Only written for SVG */
+			n = Polygon_from_tmpfile(&poly);
+			if (mode != 8)
+				break;
+			if (chars_out)	/* Finish up old polygon */
+				fprintf(md, poly_end);
+			pencolor = (int) pt.color[pen_no];
+			fprintf(md, "<path style=\"fill:rgb(%d,%d,%d); "
+				"stroke:none; fill-rule:evenodd\" d=\"",
+				pt.clut[pencolor][0], pt.clut[pencolor][1],
+				pt.clut[pencolor][2]);
+			for (i = 0; i + 1 < n; i += 2) {
+				if (i == 0 || poly[i].x != poly[i - 1].x
+				    || poly[i].y != poly[i - 1].y)
+					fprintf(md, "%sM %4.3f, %4.3f ",
+						i ? "Z\n" : "",
+						(poly[i].x - po->xmin) *
+						xcoord2mm,
+						(po->ymax - poly[i].y -
+						 po->ymin) * ycoord2mm);
+				fprintf(md, "L %4.3f, %4.3f ",
+					(poly[i + 1].x - po->xmin) * xcoord2mm,
+					(po->ymax - poly[i + 1].y -
+					 po->ymin) * ycoord2mm);
+			}
+			fprintf(md, "Z\" />\n");
+			if (chars_out)	/* Continue the open polyline */
+				chars_out = fprintf(md, poly_start,
+						    (pt1.x -
+						     po->xmin) * xcoord2mm,
+						    (pt1.y -
+						     po->ymin) * ycoord2mm);
+			break;
+		case ARC:	/* Only written for DXF and SVG */
+			Arc_from_tmpfile(&arc);
+			if (mode == 7) {
+				dxf_map_pen(po->specials, pen_no, pensize,
+					    &mapped_pen_no,
+					    &mapped_pen_size);
+				a0 = arc.end.x - arc.center.x;
+				a1 = arc.end.y - arc.center.y;
+				r = sqrt(a0 * a0 + a1 * a1) * xcoord2mm;
+				a1 = atan2(arc.end.y - arc.center.y,
+					   arc.end.x - arc.center.x) *
+				    180.0 / M_PI;
+				a0 = a1 - arc.sweep * 180.0 / M_PI;
+				if (fabs(arc.sweep) >= 2.0 * M_PI - 1.e-6)
+					fprintf(md,
+						"CIRCLE\n  8\n0\n 62\n%d\n 39\n%g\n 10\n%g\n 20\n%g\n 30\n0.0\n 40\n%g\n  0\n",
+						mapped_pen_no,
+						mapped_pen_size,
+						(arc.center.x -
+						 po->xmin) * xcoord2mm,
+						(arc.center.y -
+						 po->ymin) * ycoord2mm, r);
+				else
+					fprintf(md,
+						"ARC\n  8\n0\n 62\n%d\n 39\n%g\n 10\n%g\n 20\n%g\n 30\n0.0\n 40\n%g\n 50\n%g\n 51\n%g\n  0\n",
+						mapped_pen_no,
+						mapped_pen_size,
+						(arc.center.x -
+						 po->xmin) * xcoord2mm,
+						(arc.center.y -
+						 po->ymin) * ycoord2mm, r,
+						arc.sweep > 0 ? a0 : a1,
+						arc.sweep > 0 ? a1 : a0);
+			} else if (mode == 8 && pensize != 0.) {
+				if (!chars_out)
+					chars_out = fprintf(md, poly_start,
+							    (pt1.x -
+							     po->xmin) *
+							    xcoord2mm,
+							    (pt1.y -
+							     po->ymin) *
+							    ycoord2mm);
+				chars_out +=
+				    svg_arc(md, &arc, po, xcoord2mm,
+					    ycoord2mm);
+			}
+			pt1 = arc.end;
+			if (mode == 8)
+				pt1.y = po->ymax - pt1.y;
+			break;
+		case CUBIC:	/* Only written for DXF and SVG */
+			Cubic_from_tmpfile(cp);
+			if (mode == 7) {	/* No curves in DXF R12 */
+				dxf_map_pen(po->specials, pen_no, pensize,
+					    &mapped_pen_no,
+					    &mapped_pen_size);
+				/* One polyline, as fine as arcs of this mode */
+				n = cubic_steps(&pt1, cp,
+						pg->chord_tol / xcoord2mm);
+				fprintf(md,
+					"POLYLINE\n  8\n0\n 62\n%d\n 39\n%g\n 66\n1\n 10\n0.0\n 20\n0.0\n 30\n0.0\n  0\n",
+					mapped_pen_no, mapped_pen_size);
+				for (i = 0; i <= n; i++) {
+					t = (double) i / n;
+					q.x = (1 - t) * (1 - t) * (1 - t) * pt1.x
+					    + 3 * t * (1 - t) * (1 - t) * cp[0].x
+					    + 3 * t * t * (1 - t) * cp[1].x
+					    + t * t * t * cp[2].x;
+					q.y = (1 - t) * (1 - t) * (1 - t) * pt1.y
+					    + 3 * t * (1 - t) * (1 - t) * cp[0].y
+					    + 3 * t * t * (1 - t) * cp[1].y
+					    + t * t * t * cp[2].y;
+					fprintf(md,
+						"VERTEX\n  8\n0\n 10\n%g\n 20\n%g\n 30\n0.0\n  0\n",
+						(q.x - po->xmin) * xcoord2mm,
+						(q.y - po->ymin) * ycoord2mm);
+				}
+				fprintf(md, "SEQEND\n  8\n0\n  0\n");
+			} else if (mode == 8 && pensize != 0.) {
+				if (!chars_out)
+					chars_out = fprintf(md, poly_start,
+							    (pt1.x -
+							     po->xmin) *
+							    xcoord2mm,
+							    (pt1.y -
+							     po->ymin) *
+							    ycoord2mm);
+				for (i = 0; i < 3; i++)
+					chars_out += fprintf(md,
+							     "%s%4.3f, %4.3f ",
+							     i ? "" : "	C ",
+							     (cp[i].x -
+							      po->xmin) *
+							     xcoord2mm,
+							     (po->ymax -
+							      cp[i].y -
+							      po->ymin) *
+							     ycoord2mm);
+				chars_out += fprintf(md, "\n");
+			}
+			pt1 = cp[2];
+			if (mode == 8)
+				pt1.y = po->ymax - pt1.y;
+			break;
+		case TEXT:	/* Only written for SVG */
+			label = Text_from_tmpfile(&text);
+			pt1 = text.org;
+			if (mode == 8)
+				pt1.y = po->ymax - pt1.y;
+			if (mode != 8 || pensize == 0.)
+				break;
+			if (chars_out) {	/* Finish up old polygon */
+				fprintf(md, poly_end);
+				chars_out = 0;
+			}
+			pencolor = (int) pt.color[pen_no];
+			svg_text(md, &text, label, pt.clut[pencolor], po,
+				 xcoord2mm, ycoord2mm);
+			break;
 		default:
 			Eprintf("Illegal cmd in temp. file!");
 			err = ERROR;